@@ -111,18 +111,22 @@ void count_ballot(vote_count_t vc, ballot_t ballot)
 
 ballot_t read_ballot(FILE* inf)
 {
+    char* line = fread_line(inf);
+    if (line == NULL) {
+        return NULL;
+    }
+
     ballot_t ballot = ballot_create();
-    char* line;
-    while((line = fread_line(inf)) != NULL){
-        if(*line == '%'){
-            free(line);
-        } else {
-            clean_name(line);
-            ballot_insert(ballot, line);
+    while (line != NULL) {
+        if (strcmp(line, "%") == 0) {
             free(line);
+            break;
         }
+        // ballot_insert takes ownership of `line` and cleans it.
+        ballot_insert(ballot, line);
+        line = fread_line(inf);
     }
-    return NULL;
+    return ballot;
 }
 
 void clean_name(char* name)
@@ -142,6 +146,16 @@ void clean_name(char* name)
     name[y] = 0;
 }
 
+size_t ballot_length(ballot_t ballot)
+{
+    return ballot->length;
+}
+
+const char* ballot_name(ballot_t ballot, size_t i)
+{
+    return ballot->entries[i].name;
+}
+
 void print_ballot(FILE* outf, ballot_t ballot)
 {
     for (size_t i = 0; i < ballot->length; ++i) {
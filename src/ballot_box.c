@@ -1,5 +1,6 @@
 #include "ballot_box.h"
 #include "helpers.h"
+#include "prof.h"
 
 #include <ipd.h>
 
@@ -49,42 +50,65 @@ ballot_box_t read_ballot_box(FILE* inf)
 
 vote_count_t bb_count(ballot_box_t bb)
 {
+    prof_enter(PROF_COUNT);
     vote_count_t result = vc_create();
-    if(bb->next == NULL)
-        count_ballot(result, bb->ballot);
+    if (result == NULL) {
+        perror("bb_count");
+        exit(1);
+    }
     while(bb){
         count_ballot(result, bb->ballot);
         bb = bb->next;
     }
+    prof_leave(PROF_COUNT);
     return result;
 }
 
 void bb_eliminate(ballot_box_t bb, const char* candidate)
 {
-    if(bb->next == NULL)
-        ballot_eliminate(bb->ballot, candidate);
+    prof_enter(PROF_ELIMINATE);
     while(bb){
         ballot_eliminate(bb->ballot, candidate);
         bb = bb->next;
     }
+    prof_leave(PROF_ELIMINATE);
+}
+
+ballot_t bb_ballot(ballot_box_t bb)
+{
+    return bb->ballot;
+}
+
+ballot_box_t bb_next(ballot_box_t bb)
+{
+    return bb->next;
 }
 
 char* get_irv_winner(ballot_box_t bb)
 {
     vote_count_t result= bb_count(bb);
-    if (result == NULL){
-        return NULL;
+    prof_enter(PROF_SELECT);
+    if (vc_total(result) == 0){
+        prof_leave(PROF_SELECT);
         vc_destroy(result);
+        return NULL;
     }
 
-    while(vc_lookup(result,vc_max(result)) <= (vc_total(result)/2.0))
+    // Each of these is a scan of `result`, so look up the leader once
+    // per round.
+    const char* leader = vc_max(result);
+    while(vc_lookup(result,leader) <= (vc_total(result)/2.0))
     {
-        bb_eliminate(bb, vc_min(result));
+        const char* loser = vc_min(result);
+        prof_leave(PROF_SELECT);
+        bb_eliminate(bb, loser);
         vc_destroy(result);
         result = bb_count(bb);
+        prof_enter(PROF_SELECT);
+        leader = vc_max(result);
     }
-    const char* str= vc_max(result);
-    char* winner = strdupb(str,"get_irv_winner");
+    prof_leave(PROF_SELECT);
+    char* winner = strdupb(leader,"get_irv_winner");
     vc_destroy(result);
     return winner;
 }
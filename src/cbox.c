@@ -0,0 +1,644 @@
+#include "cbox.h"
+#include "helpers.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A raw spelling of a name in the spelling cache (see below).
+struct spelling
+{
+    uint64_t hash;
+    size_t   offset;
+    size_t   len;
+    cand_t   cand;
+};
+
+// A `cbox_t` (defined in `cbox.h`) is a pointer to a heap-allocated
+// `struct cbox`, with the following invariant:
+//
+//  - `names[0 .. ncand)` are distinct, OWNED, 0-terminated strings,
+//    `name_len[i]` is the length of `names[i]`, and `name_hash[i]` is
+//    its `hash_bytes`.
+//
+//  - `index` is an open-addressing hash table with `index_cap` slots (a
+//    power of two, more than twice `ncand`); each slot holds either
+//    `CAND_NONE` or the id of a candidate, and every candidate is
+//    reachable by linear probing from `name_hash[id] & (index_cap-1)`.
+//
+//  - Ballot `i` (for `i < nballots`) is `ranks[starts[i] ..
+//    starts[i+1])`, which contains no repeated ids, and `starts[0] ==
+//    0`, so `starts` has `nballots + 1` initialized elements.
+//
+// A box made by `cbox_view` borrows some of its storage instead:
+// `names[0 .. borrowed_names)` are not owned, and if `borrowed_ballots`
+// then neither are `ranks` and `starts` (and the capacities are 0).
+// Changing the ballots of such a box first copies them into owned
+// storage.
+//
+// The spelling cache maps names exactly as read (before cleaning) to
+// their candidates, for `cbox_read_ballot_into`:
+//
+//  - `spellings[0 .. nspellings)` are distinct raw spellings, each the
+//    `len` bytes at `offset` in `spell_text`, with their `hash_bytes`
+//    and the candidate they clean to.
+//
+//  - `spell_index` is an open-addressing hash table with
+//    `spell_index_cap` slots (a power of two, more than twice
+//    `nspellings`, or 0 before the first spelling); each slot holds 0
+//    or one more than the number of a spelling, and every spelling is
+//    reachable by linear probing from its hash.
+//
+// `reader` is the scratch space of `cbox_read_ballot`.
+struct cbox
+{
+    char**    names;
+    size_t*   name_len;
+    uint64_t* name_hash;
+    size_t    ncand;
+    size_t    cand_cap;
+
+    cand_t*   index;
+    size_t    index_cap;
+
+    cand_t*   ranks;
+    size_t    rank_cap;
+
+    size_t*   starts;
+    size_t    nballots;
+    size_t    ballot_cap;
+
+    size_t    borrowed_names;
+    bool      borrowed_ballots;
+
+    struct spelling* spellings;
+    size_t    nspellings;
+    size_t    spellings_cap;
+    char*     spell_text;
+    size_t    spell_text_len;
+    size_t    spell_text_cap;
+    uint32_t* spell_index;
+    size_t    spell_index_cap;
+
+    struct cbox_reader reader;
+};
+
+#define INITIAL_INDEX_CAP 64
+
+// Limits on the spelling cache, so that input with endless distinct
+// spellings (such as write-ins) cannot make it grow without bound.
+// Spellings past the limit are cleaned every time they are read.
+#define MAX_SPELLINGS     65536
+#define MAX_SPELL_TEXT    (4 << 20)
+
+// Sets up an empty spelling cache.
+static void init_spellings(cbox_t cb)
+{
+    cb->spellings       = NULL;
+    cb->nspellings      = 0;
+    cb->spellings_cap   = 0;
+    cb->spell_text      = NULL;
+    cb->spell_text_len  = 0;
+    cb->spell_text_cap  = 0;
+    cb->spell_index     = NULL;
+    cb->spell_index_cap = 0;
+}
+
+cbox_t cbox_create(void)
+{
+    cbox_t cb = mallocb(sizeof *cb, "cbox_create");
+
+    cb->names     = NULL;
+    cb->name_len  = NULL;
+    cb->name_hash = NULL;
+    cb->ncand     = 0;
+    cb->cand_cap  = 0;
+
+    cb->index_cap = INITIAL_INDEX_CAP;
+    cb->index     = mallocb(cb->index_cap * sizeof *cb->index,
+                            "cbox_create");
+    for (size_t i = 0; i < cb->index_cap; ++i) {
+        cb->index[i] = CAND_NONE;
+    }
+
+    cb->rank_cap   = 64;
+    cb->ranks      = mallocb(cb->rank_cap * sizeof *cb->ranks,
+                             "cbox_create");
+    cb->ballot_cap = 16;
+    cb->starts     = mallocb(cb->ballot_cap * sizeof *cb->starts,
+                             "cbox_create");
+    cb->starts[0]  = 0;
+    cb->nballots   = 0;
+
+    cb->borrowed_names   = 0;
+    cb->borrowed_ballots = false;
+    cb->reader           = (struct cbox_reader) CBOX_READER_INIT;
+    init_spellings(cb);
+
+    return cb;
+}
+
+// Creates the index for the first `cb->ncand` names.
+static void build_index(cbox_t cb);
+
+cbox_t cbox_view(size_t ncand, const char* const* names,
+                 size_t nballots, const size_t* starts, const cand_t* ranks)
+{
+    cbox_t cb = mallocb(sizeof *cb, "cbox_view");
+
+    cb->ncand     = ncand;
+    cb->cand_cap  = ncand ? ncand : 1;
+    cb->names     = mallocb(cb->cand_cap * sizeof *cb->names, "cbox_view");
+    cb->name_len  = mallocb(cb->cand_cap * sizeof *cb->name_len,
+                            "cbox_view");
+    cb->name_hash = mallocb(cb->cand_cap * sizeof *cb->name_hash,
+                            "cbox_view");
+    for (size_t i = 0; i < ncand; ++i) {
+        cb->names[i]     = (char*) names[i];
+        cb->name_len[i]  = strlen(names[i]);
+        cb->name_hash[i] = hash_bytes(names[i], cb->name_len[i]);
+    }
+
+    cb->index_cap = INITIAL_INDEX_CAP;
+    while (cb->index_cap <= 2 * ncand) {
+        cb->index_cap *= 2;
+    }
+    cb->index = mallocb(cb->index_cap * sizeof *cb->index, "cbox_view");
+    build_index(cb);
+
+    cb->ranks      = (cand_t*) ranks;
+    cb->rank_cap   = 0;
+    cb->starts     = (size_t*) starts;
+    cb->nballots   = nballots;
+    cb->ballot_cap = 0;
+
+    cb->borrowed_names   = ncand;
+    cb->borrowed_ballots = true;
+    cb->reader           = (struct cbox_reader) CBOX_READER_INIT;
+    init_spellings(cb);
+
+    return cb;
+}
+
+// Copies borrowed ballots into owned storage, so they can change.
+static void own_ballots(cbox_t cb)
+{
+    if (!cb->borrowed_ballots) {
+        return;
+    }
+
+    size_t nranks = cb->starts[cb->nballots];
+    size_t rank_cap = 64, ballot_cap = 16;
+    while (rank_cap < nranks) {
+        rank_cap *= 2;
+    }
+    while (ballot_cap <= cb->nballots + 1) {
+        ballot_cap *= 2;
+    }
+
+    cand_t* ranks  = mallocb(rank_cap * sizeof *ranks, "cbox_push");
+    size_t* starts = mallocb(ballot_cap * sizeof *starts, "cbox_push");
+    memcpy(ranks, cb->ranks, nranks * sizeof *ranks);
+    memcpy(starts, cb->starts, (cb->nballots + 1) * sizeof *starts);
+
+    cb->ranks            = ranks;
+    cb->rank_cap         = rank_cap;
+    cb->starts           = starts;
+    cb->ballot_cap       = ballot_cap;
+    cb->borrowed_ballots = false;
+}
+
+void cbox_destroy(cbox_t cb)
+{
+    if (cb == NULL) {
+        return;
+    }
+
+    for (size_t i = cb->borrowed_names; i < cb->ncand; ++i) {
+        free(cb->names[i]);
+    }
+    free(cb->names);
+    free(cb->name_len);
+    free(cb->name_hash);
+    free(cb->index);
+    if (!cb->borrowed_ballots) {
+        free(cb->ranks);
+        free(cb->starts);
+    }
+    free(cb->spellings);
+    free(cb->spell_text);
+    free(cb->spell_index);
+    cbox_reader_free(&cb->reader);
+    free(cb);
+}
+
+void cbox_clear(cbox_t cb)
+{
+    if (cb->borrowed_ballots) {
+        cb->nballots = 0;
+        own_ballots(cb);
+    }
+    cb->nballots  = 0;
+    cb->starts[0] = 0;
+}
+
+cbox_t cbox_from_bb(ballot_box_t bb)
+{
+    cbox_t cb = cbox_create();
+
+    // The list is newest-first, so collect it and push it backwards.
+    size_t count = 0;
+    for (ballot_box_t p = bb; p != NULL; p = bb_next(p)) {
+        ++count;
+    }
+
+    ballot_t* ballots = mallocb((count ? count : 1) * sizeof *ballots,
+                                "cbox_from_bb");
+    size_t i = count;
+    for (ballot_box_t p = bb; p != NULL; p = bb_next(p)) {
+        ballots[--i] = bb_ballot(p);
+    }
+
+    cand_t ranks[MAX_CANDIDATES];
+    for (i = 0; i < count; ++i) {
+        size_t len = ballot_length(ballots[i]);
+        for (size_t j = 0; j < len; ++j) {
+            ranks[j] = cbox_intern(cb, ballot_name(ballots[i], j));
+        }
+        cbox_push(cb, ranks, len);
+    }
+
+    free(ballots);
+    return cb;
+}
+
+static void build_index(cbox_t cb)
+{
+    size_t mask = cb->index_cap - 1;
+    for (size_t i = 0; i < cb->index_cap; ++i) {
+        cb->index[i] = CAND_NONE;
+    }
+
+    for (size_t id = 0; id < cb->ncand; ++id) {
+        size_t slot = cb->name_hash[id] & mask;
+        while (cb->index[slot] != CAND_NONE) {
+            slot = (slot + 1) & mask;
+        }
+        cb->index[slot] = (cand_t) id;
+    }
+}
+
+// Doubles the hash index and reinserts every candidate.
+static void grow_index(cbox_t cb)
+{
+    free(cb->index);
+    cb->index_cap *= 2;
+    cb->index = mallocb(cb->index_cap * sizeof *cb->index, "cbox_intern");
+    build_index(cb);
+}
+
+// Returns the slot where `name` is or would be stored in the index.
+static size_t probe(cbox_t cb, const char* name, size_t len, uint64_t h)
+{
+    size_t mask = cb->index_cap - 1;
+    size_t slot = h & mask;
+    for (;;) {
+        cand_t id = cb->index[slot];
+        if (id == CAND_NONE ||
+                (cb->name_hash[id] == h && cb->name_len[id] == len &&
+                 memcmp(cb->names[id], name, len) == 0)) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+cand_t cbox_intern_n(cbox_t cb, const char* name, size_t len)
+{
+    uint64_t h = hash_bytes(name, len);
+    size_t slot = probe(cb, name, len, h);
+    if (cb->index[slot] != CAND_NONE) {
+        return cb->index[slot];
+    }
+
+    if (cb->ncand == CBOX_MAX_CANDIDATES) {
+        exit(4);
+    }
+
+    if (cb->ncand == cb->cand_cap) {
+        cb->cand_cap  = cb->cand_cap ? 2 * cb->cand_cap : 16;
+        cb->names     = reallocb(cb->names,
+                                 cb->cand_cap * sizeof *cb->names,
+                                 "cbox_intern");
+        cb->name_len  = reallocb(cb->name_len,
+                                 cb->cand_cap * sizeof *cb->name_len,
+                                 "cbox_intern");
+        cb->name_hash = reallocb(cb->name_hash,
+                                 cb->cand_cap * sizeof *cb->name_hash,
+                                 "cbox_intern");
+    }
+
+    cand_t id = (cand_t) cb->ncand++;
+    char* copy = mallocb(len + 1, "cbox_intern");
+    memcpy(copy, name, len);
+    copy[len] = 0;
+    cb->names[id]     = copy;
+    cb->name_len[id]  = len;
+    cb->name_hash[id] = h;
+    cb->index[slot]   = id;
+
+    if (2 * cb->ncand >= cb->index_cap) {
+        grow_index(cb);
+    }
+
+    return id;
+}
+
+cand_t cbox_intern(cbox_t cb, const char* name)
+{
+    return cbox_intern_n(cb, name, strlen(name));
+}
+
+cand_t cbox_find(cbox_t cb, const char* name)
+{
+    size_t len = strlen(name);
+    return cb->index[probe(cb, name, len, hash_bytes(name, len))];
+}
+
+size_t cbox_candidates(cbox_t cb)
+{
+    return cb->ncand;
+}
+
+const char* cbox_name(cbox_t cb, cand_t id)
+{
+    return cb->names[id];
+}
+
+void cbox_push(cbox_t cb, const cand_t* ranks, size_t len)
+{
+    if (len > MAX_CANDIDATES) {
+        exit(3);
+    }
+
+    own_ballots(cb);
+    if (cb->nballots + 1 == cb->ballot_cap) {
+        cb->ballot_cap *= 2;
+        cb->starts = reallocb(cb->starts,
+                              cb->ballot_cap * sizeof *cb->starts,
+                              "cbox_push");
+    }
+
+    size_t start = cb->starts[cb->nballots];
+    if (start + len > cb->rank_cap) {
+        size_t cap = 2 * cb->rank_cap;
+        while (cap < start + len) {
+            cap *= 2;
+        }
+        cb->ranks    = reallocb(cb->ranks, cap * sizeof *cb->ranks,
+                                "cbox_push");
+        cb->rank_cap = cap;
+    }
+
+    size_t end = start;
+    for (size_t i = 0; i < len; ++i) {
+        bool repeated = false;
+        for (size_t j = start; j < end; ++j) {
+            if (cb->ranks[j] == ranks[i]) {
+                repeated = true;
+                break;
+            }
+        }
+        if (!repeated) {
+            cb->ranks[end++] = ranks[i];
+        }
+    }
+
+    cb->starts[++cb->nballots] = end;
+}
+
+// Reads a line from `inf`, which the caller has locked, into `r->line`
+// (without its newline), storing its length in `*len` and its
+// `hash_bytes` in `*hash`. Returns false at EOF.
+static bool read_raw_line(FILE* inf, struct cbox_reader* r,
+                          size_t* len, uint64_t* hash)
+{
+    int ch = getc_unlocked(inf);
+    if (ch == EOF) {
+        return false;
+    }
+    if (r->cap == 0) {
+        r->cap  = 128;
+        r->line = mallocb(r->cap, "cbox_read_ballot");
+    }
+
+    // `hash_bytes`, computed as the bytes go by.
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t   n = 0;
+    for (; ch != EOF && ch != '\n'; ch = getc_unlocked(inf)) {
+        if (n + 1 == r->cap) {
+            r->cap *= 2;
+            r->line = reallocb(r->line, r->cap, "cbox_read_ballot");
+        }
+        r->line[n++] = (char) ch;
+        h ^= (unsigned char) ch;
+        h *= 0x100000001b3ULL;
+    }
+
+    r->line[n] = 0;
+    *len       = n;
+    *hash      = mix64(h ^ n);
+    return true;
+}
+
+// Returns the slot where the spelling `raw` is or would be stored in
+// the spelling index, which must have slots.
+static size_t probe_spelling(cbox_t cb, const char* raw, size_t len,
+                             uint64_t h)
+{
+    size_t mask = cb->spell_index_cap - 1;
+    size_t slot = h & mask;
+    for (;;) {
+        uint32_t k = cb->spell_index[slot];
+        if (k == 0) {
+            return slot;
+        }
+        const struct spelling* sp = &cb->spellings[k - 1];
+        if (sp->hash == h && sp->len == len &&
+                memcmp(cb->spell_text + sp->offset, raw, len) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+// Doubles the spelling index (or creates it) and reinserts every
+// spelling.
+static void grow_spell_index(cbox_t cb)
+{
+    free(cb->spell_index);
+    cb->spell_index_cap = cb->spell_index_cap ? 2 * cb->spell_index_cap
+                                              : INITIAL_INDEX_CAP;
+    cb->spell_index = callocb(cb->spell_index_cap, sizeof *cb->spell_index,
+                              "cbox_read_ballot");
+
+    size_t mask = cb->spell_index_cap - 1;
+    for (size_t k = 0; k < cb->nspellings; ++k) {
+        size_t slot = cb->spellings[k].hash & mask;
+        while (cb->spell_index[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        cb->spell_index[slot] = (uint32_t) (k + 1);
+    }
+}
+
+// Adds the spelling `raw`, which is not in the cache, and returns its
+// entry for the caller to fill in the candidate; or returns NULL if the
+// cache is full.
+static struct spelling* add_spelling(cbox_t cb, const char* raw,
+                                     size_t len, uint64_t h)
+{
+    if (cb->nspellings == MAX_SPELLINGS ||
+            cb->spell_text_len + len > MAX_SPELL_TEXT) {
+        return NULL;
+    }
+
+    if (cb->nspellings == cb->spellings_cap) {
+        cb->spellings_cap = cb->spellings_cap ? 2 * cb->spellings_cap : 16;
+        cb->spellings     = reallocb(cb->spellings,
+                                     cb->spellings_cap * sizeof *cb->spellings,
+                                     "cbox_read_ballot");
+    }
+    if (cb->spell_text_len + len > cb->spell_text_cap) {
+        size_t cap = cb->spell_text_cap ? 2 * cb->spell_text_cap : 1024;
+        while (cap < cb->spell_text_len + len) {
+            cap *= 2;
+        }
+        cb->spell_text     = reallocb(cb->spell_text, cap, "cbox_read_ballot");
+        cb->spell_text_cap = cap;
+    }
+
+    if (2 * (cb->nspellings + 1) >= cb->spell_index_cap) {
+        grow_spell_index(cb);
+    }
+    cb->spell_index[probe_spelling(cb, raw, len, h)] =
+        (uint32_t) (cb->nspellings + 1);
+
+    memcpy(cb->spell_text + cb->spell_text_len, raw, len);
+    struct spelling* sp = &cb->spellings[cb->nspellings++];
+    *sp = (struct spelling) { h, cb->spell_text_len, len, CAND_NONE };
+    cb->spell_text_len += len;
+    return sp;
+}
+
+// Returns the candidate named by the raw line `raw` of `len` bytes with
+// hash `h`, adding it if it is new. A spelling read before costs one
+// probe of the spelling cache; a new one is cached, then cleaned as
+// `clean_name` would (in place, clobbering `raw`) and interned.
+static cand_t spelled(cbox_t cb, char* raw, size_t len, uint64_t h)
+{
+    if (cb->spell_index_cap > 0) {
+        uint32_t k = cb->spell_index[probe_spelling(cb, raw, len, h)];
+        if (k != 0) {
+            return cb->spellings[k - 1].cand;
+        }
+    }
+
+    struct spelling* sp = add_spelling(cb, raw, len, h);
+
+    size_t n = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (isalpha((unsigned char) raw[i])) {
+            raw[n++] = (char) toupper((unsigned char) raw[i]);
+        }
+    }
+
+    cand_t c = cbox_intern_n(cb, raw, n);
+    if (sp) {
+        sp->cand = c;
+    }
+    return c;
+}
+
+// Copies the `len` bytes after the first of `r->line` to `r->key`.
+static void set_key(struct cbox_reader* r, size_t len)
+{
+    if (len + 1 > r->key_cap) {
+        r->key_cap = 2 * (len + 1);
+        r->key     = reallocb(r->key, r->key_cap, "cbox_read_ballot");
+    }
+    memcpy(r->key, r->line + 1, len);
+    r->key[len] = 0;
+    r->key_len  = len;
+    r->new_key  = true;
+}
+
+bool cbox_read_ballot_into(cbox_t cb, FILE* inf, struct cbox_reader* r)
+{
+    // Lock the stream once per ballot rather than once per character.
+    flockfile(inf);
+
+    cand_t   ranks[MAX_CANDIDATES];
+    size_t   len = 0;
+    size_t   line_len;
+    uint64_t hash;
+    bool     found = false;
+    while (read_raw_line(inf, r, &line_len, &hash)) {
+        // A metadata line alone does not make a ballot.
+        if (r->meta != 0 && line_len > 0 && r->line[0] == r->meta) {
+            set_key(r, line_len - 1);
+            continue;
+        }
+        found = true;
+        if (line_len == 1 && r->line[0] == '%') {
+            break;
+        }
+        if (len == MAX_CANDIDATES) {
+            exit(3);
+        }
+        ranks[len++] = spelled(cb, r->line, line_len, hash);
+    }
+
+    funlockfile(inf);
+    if (found) {
+        cbox_push(cb, ranks, len);
+    }
+    return found;
+}
+
+bool cbox_read_ballot(cbox_t cb, FILE* inf)
+{
+    return cbox_read_ballot_into(cb, inf, &cb->reader);
+}
+
+void cbox_reader_free(struct cbox_reader* r)
+{
+    free(r->line);
+    free(r->key);
+    *r = (struct cbox_reader) CBOX_READER_INIT;
+}
+
+size_t cbox_read(cbox_t cb, FILE* inf)
+{
+    size_t count = 0;
+    while (cbox_read_ballot(cb, inf)) {
+        ++count;
+    }
+    return count;
+}
+
+size_t cbox_size(cbox_t cb)
+{
+    return cb->nballots;
+}
+
+const cand_t* cbox_ballot(cbox_t cb, size_t i, size_t* len)
+{
+    *len = cb->starts[i + 1] - cb->starts[i];
+    return cb->ranks + cb->starts[i];
+}
+
+size_t cbox_rank_count(cbox_t cb)
+{
+    return cb->starts[cb->nballots];
+}
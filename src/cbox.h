@@ -0,0 +1,211 @@
+#pragma once
+
+// A compact ballot box (`cbox_t`) stores an election in flat arrays
+// instead of one heap object per ballot and per name:
+//
+//  - a candidate table that interns each (cleaned) candidate name once
+//    and gives it a small integer id, and
+//
+//  - the ballots themselves, in input order, as runs of candidate ids
+//    packed end to end in one array.
+//
+// Each ballot keeps only the first occurrence of each candidate, since
+// later occurrences can never become its leader (`ballot_eliminate`
+// deactivates every occurrence of a name at once).
+//
+// The compact engines (tabulate.h, margin.h, ...) work on this
+// representation and must produce the same results as
+// `get_irv_winner` on the equivalent `ballot_box_t`.
+
+#include "ballot_box.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A candidate id: an index into the candidate table.
+typedef uint16_t cand_t;
+
+// No candidate (an exhausted ballot, no winner, not found, ...).
+#define CAND_NONE ((cand_t) UINT16_MAX)
+
+// The largest number of distinct candidates a `cbox_t` can hold.
+#define CBOX_MAX_CANDIDATES ((size_t) CAND_NONE)
+
+typedef struct cbox* cbox_t;
+
+// Scratch space for reading ballots: a name buffer that grows to fit
+// the longest name read so far and is then reused. Initialize it with
+// `CBOX_READER_INIT` and free it with `cbox_reader_free`.
+//
+// If `meta` is set to a character other than 0, lines that begin with
+// it are metadata rather than names: reading one copies the rest of
+// the line to `key[0 .. key_len)` (0-terminated) and sets `new_key`,
+// which the caller clears once it has used the key.
+struct cbox_reader
+{
+    char*  line;
+    size_t cap;
+
+    char   meta;
+    char*  key;
+    size_t key_len;
+    size_t key_cap;
+    bool   new_key;
+};
+
+#define CBOX_READER_INIT { NULL, 0, 0, NULL, 0, 0, false }
+
+// Creates a new, empty compact ballot box.
+//
+// OWNERSHIP:
+//  - The caller owns the result and must free it with `cbox_destroy`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+cbox_t cbox_create(void);
+
+// Frees `cb` and everything it owns. `cb` may be NULL.
+//
+// OWNERSHIP:
+//  - Takes ownership of `cb`.
+void cbox_destroy(cbox_t cb);
+
+// Removes all ballots from `cb` but keeps its candidate table and its
+// buffers, so that refilling it to the same size allocates nothing.
+//
+// OWNERSHIP:
+//  - Borrows `cb` transiently.
+void cbox_clear(cbox_t cb);
+
+// Creates a compact ballot box over existing storage without copying
+// it: `ncand` candidate names, and `nballots` ballots laid out as
+// `cbox_ballot` describes, where ballot `i` is `ranks[starts[i] ..
+// starts[i+1])` and `starts[0] == 0`. (This is how checkpoints are
+// mapped back into memory; see ckpt.h.) Each ballot must already be
+// free of repeated candidates. Adding ballots to the box later copies
+// them into storage of its own first.
+//
+// OWNERSHIP:
+//  - Copies the array `names` but borrows the strings it points to,
+//    and borrows `starts` and `ranks`; all of them must outlive the
+//    result.
+//  - The caller owns the result and must free it with `cbox_destroy`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+cbox_t cbox_view(size_t ncand, const char* const* names,
+                 size_t nballots, const size_t* starts, const cand_t* ranks);
+
+// Builds a compact ballot box holding the same ballots as `bb`. The
+// ballots are stored in input order, i.e., the reverse of the order in
+// which `bb` lists them, since `bb_insert` prepends.
+//
+// OWNERSHIP:
+//  - Borrows `bb` transiently.
+//  - The caller owns the result and must free it with `cbox_destroy`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+cbox_t cbox_from_bb(ballot_box_t bb);
+
+// Returns the id of the candidate named `name`, adding it to the
+// candidate table if it is not already there. `name` must already be
+// cleaned (see `clean_name`).
+//
+// OWNERSHIP:
+//  - Borrows both arguments transiently; the table keeps its own copy
+//    of `name`.
+//
+// ERRORS:
+//  - Exits with code 4 if the table already holds
+//    `CBOX_MAX_CANDIDATES` candidates.
+//  - Exits with code 1 if memory cannot be allocated.
+cand_t cbox_intern(cbox_t cb, const char* name);
+
+// Like `cbox_intern`, but for a name given as `len` bytes that need not
+// be 0-terminated.
+cand_t cbox_intern_n(cbox_t cb, const char* name, size_t len);
+
+// Returns the id of the candidate named `name`, or `CAND_NONE` if there
+// is no such candidate.
+//
+// OWNERSHIP:
+//  - Borrows both arguments transiently.
+cand_t cbox_find(cbox_t cb, const char* name);
+
+// Returns the number of candidates in the table. Ids are `0` up to
+// (but not including) this number.
+size_t cbox_candidates(cbox_t cb);
+
+// Returns the name of candidate `id`.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `cb`.
+const char* cbox_name(cbox_t cb, cand_t id);
+
+// Appends a ballot ranking the `len` candidates in `ranks` (in order
+// of preference). Repeated candidates are kept only at their first
+// position.
+//
+// OWNERSHIP:
+//  - Borrows both arguments transiently.
+//
+// ERRORS:
+//  - Exits with code 3 if `len > MAX_CANDIDATES`, as `ballot_insert`
+//    does for an overfull ballot.
+//  - Exits with code 1 if memory cannot be allocated.
+void cbox_push(cbox_t cb, const cand_t* ranks, size_t len);
+
+// Reads one ballot in the format of `read_ballot` (one name per line,
+// ending with a line containing only '%' or with EOF), cleans its names
+// with `clean_name`, and appends it to `cb`. Returns false, appending
+// nothing, if there is no ballot left to read.
+//
+// Each line is read into `r`'s buffer and looked up, exactly as
+// spelled, in a cache that `cb` keeps of the spellings it has read
+// (up to a limit), so a repeated spelling costs one hash probe and is
+// never cleaned or copied; only new spellings are cleaned and looked up
+// among the candidates. Once the buffer fits the longest line and
+// `cb`'s arrays have grown to fit the ballots, reading a ballot
+// allocates nothing unless it spells a name in a new way. The stream
+// is locked once per ballot and read a character at a time without
+// further locking.
+//
+// Metadata lines (see `struct cbox_reader`) are not names, and lines
+// that are all metadata do not make a ballot.
+//
+// PRECONDITION:
+//  - `inf` must be open for reading.
+//
+// OWNERSHIP:
+//  - Borrows all arguments transiently.
+//
+// ERRORS:
+//  - Exits as `cbox_intern` and `cbox_push` do.
+bool cbox_read_ballot_into(cbox_t cb, FILE* inf, struct cbox_reader* r);
+
+// Like `cbox_read_ballot_into`, using a reader that belongs to `cb`.
+bool cbox_read_ballot(cbox_t cb, FILE* inf);
+
+// Frees the buffer of `r` and resets it to `CBOX_READER_INIT`.
+void cbox_reader_free(struct cbox_reader* r);
+
+// Reads ballots with `cbox_read_ballot` until EOF and returns how many
+// were read.
+size_t cbox_read(cbox_t cb, FILE* inf);
+
+// Returns the number of ballots.
+size_t cbox_size(cbox_t cb);
+
+// Returns the ranking of ballot number `i` (counting from 0 in input
+// order) and stores its length in `*len`.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `cb` and is valid until `cb` is next
+//    modified.
+const cand_t* cbox_ballot(cbox_t cb, size_t i, size_t* len);
+
+// Returns the total number of rankings stored over all ballots.
+size_t cbox_rank_count(cbox_t cb);
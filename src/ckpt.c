@@ -0,0 +1,704 @@
+#include "ckpt.h"
+#include "helpers.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The ballot starts are mapped as the `size_t` array `cbox_view`
+// expects.
+_Static_assert(sizeof(size_t) == sizeof(uint64_t),
+               "checkpoints need a 64-bit size_t");
+
+#define CKPT_MAGIC      "IRVCKPT"
+#define CKPT_VERSION    2
+#define CKPT_BYTE_ORDER 0x01020304u
+
+// `tally_round` when no tallies are saved.
+#define NO_TALLY UINT64_MAX
+
+struct ckpt_header
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+
+    int64_t  input_offset;
+    uint64_t ingest_done;
+
+    uint64_t ncand;
+    uint64_t nballots;
+    uint64_t nranks;
+    uint64_t name_bytes;
+
+    uint64_t off_name_offsets;
+    uint64_t off_names;
+    uint64_t off_starts;
+    uint64_t off_ranks;
+    uint64_t off_order;
+    uint64_t off_tallies;
+
+    // The room in each section, which `layout` sizes them by: at least
+    // the counts above, and more in a checkpoint taken mid-ingest, so
+    // that `ckpt_append` can add to it in place.
+    uint64_t cand_room;
+    uint64_t name_room;
+    uint64_t ballot_room;
+    uint64_t rank_room;
+
+    // The count state, which `ckpt_record_round` overwrites in place:
+    // the number of entries of the elimination order in use, and the
+    // number of eliminations the tallies were taken after (or
+    // NO_TALLY). These two are adjacent so they are written together.
+    uint64_t eliminated;
+    uint64_t tally_round;
+};
+
+// A `ckpt_t` (defined in `ckpt.h`) is a pointer to a heap-allocated
+// `struct ckpt`, which owns the mapping of the whole file at `base`
+// and a view of its ballots, `cb`, made with `cbox_view`.
+struct ckpt
+{
+    void*                     base;
+    size_t                    size;
+    const struct ckpt_header* header;
+    cbox_t                    cb;
+};
+
+static uint64_t align8(uint64_t n)
+{
+    return (n + 7) & ~(uint64_t) 7;
+}
+
+// Fills in the section offsets and file size from the rooms.
+static void layout(struct ckpt_header* h)
+{
+    uint64_t pos = align8(sizeof *h);
+    h->off_name_offsets = pos;
+    pos = align8(pos + (h->cand_room + 1) * sizeof(uint64_t));
+    h->off_names = pos;
+    pos = align8(pos + h->name_room);
+    h->off_starts = pos;
+    pos = align8(pos + (h->ballot_room + 1) * sizeof(uint64_t));
+    h->off_ranks = pos;
+    pos = align8(pos + h->rank_room * sizeof(cand_t));
+    h->off_order = pos;
+    pos = align8(pos + h->cand_room * sizeof(cand_t));
+    h->off_tallies = pos;
+    h->file_size = pos + h->cand_room * sizeof(uint64_t);
+}
+
+// The room to leave for `n` of something in a checkpoint taken
+// mid-ingest: doubling it, so the file is rewritten only
+// logarithmically often as the ingest goes on.
+static uint64_t room_for(uint64_t n, uint64_t max)
+{
+    return n < (max - 64) / 2 ? 2 * n + 64 : max;
+}
+
+///
+/// WRITING
+///
+
+// Writes zero bytes to `f` up to offset `to`.
+static void pad_to(FILE* f, uint64_t* pos, uint64_t to)
+{
+    static const char zeros[4096] = { 0 };
+    while (*pos < to) {
+        size_t n = to - *pos < sizeof zeros ? to - *pos : sizeof zeros;
+        fwrite(zeros, 1, n, f);
+        *pos += n;
+    }
+}
+
+static void put(FILE* f, uint64_t* pos, const void* data, size_t size)
+{
+    fwrite(data, 1, size, f);
+    *pos += size;
+}
+
+// Writes the elimination order and tallies of `tab` (or empty ones),
+// each padded out to room for `ncand` candidates.
+static void put_count(FILE* f, uint64_t* pos, const struct ckpt_header* h,
+                      tabulator_t tab)
+{
+    size_t neliminated = tab ? tab_eliminations(tab) : 0;
+
+    pad_to(f, pos, h->off_order);
+    for (size_t c = 0; c < h->ncand; ++c) {
+        cand_t id = c < neliminated ? tab_eliminated(tab, c) : CAND_NONE;
+        put(f, pos, &id, sizeof id);
+    }
+
+    pad_to(f, pos, h->off_tallies);
+    for (size_t c = 0; c < h->ncand; ++c) {
+        uint64_t n = tab ? tab_count(tab, (cand_t) c) : 0;
+        put(f, pos, &n, sizeof n);
+    }
+    pad_to(f, pos, h->file_size);
+}
+
+// Writes the name offsets of candidates `from` through `to` of `cb`
+// (the last being the end of the names), where candidate `from`'s name
+// starts at `offset`.
+static void put_name_offsets(FILE* f, uint64_t* pos, cbox_t cb,
+                             size_t from, size_t to, uint64_t offset)
+{
+    for (size_t c = from; c <= to; ++c) {
+        put(f, pos, &offset, sizeof offset);
+        if (c < to) {
+            offset += strlen(cbox_name(cb, (cand_t) c)) + 1;
+        }
+    }
+}
+
+// Writes the names of candidates `from` up to `to` of `cb`.
+static void put_names(FILE* f, uint64_t* pos, cbox_t cb, size_t from,
+                      size_t to)
+{
+    for (size_t c = from; c < to; ++c) {
+        const char* name = cbox_name(cb, (cand_t) c);
+        put(f, pos, name, strlen(name) + 1);
+    }
+}
+
+// Writes the starts of ballots `from` through `to` of `cb` (the last
+// being the end of the ranks), where ballot `from` starts at `start`.
+static void put_starts(FILE* f, uint64_t* pos, cbox_t cb, size_t from,
+                       size_t to, uint64_t start)
+{
+    for (size_t i = from; i <= to; ++i) {
+        put(f, pos, &start, sizeof start);
+        if (i < to) {
+            size_t len;
+            cbox_ballot(cb, i, &len);
+            start += len;
+        }
+    }
+}
+
+// Writes the ranks of ballots `from` up to `to` of `cb`.
+static void put_ranks(FILE* f, uint64_t* pos, cbox_t cb, size_t from,
+                      size_t to)
+{
+    for (size_t i = from; i < to; ++i) {
+        size_t len;
+        const cand_t* ranks = cbox_ballot(cb, i, &len);
+        put(f, pos, ranks, len * sizeof *ranks);
+    }
+}
+
+// Fills in the header of a checkpoint of `cb` and `tab` (see
+// `ckpt_save`).
+static void make_header(struct ckpt_header* h, cbox_t cb,
+                        int64_t input_offset, bool ingest_done,
+                        tabulator_t tab)
+{
+    memset(h, 0, sizeof *h);
+    memcpy(h->magic, CKPT_MAGIC, sizeof CKPT_MAGIC);
+    h->version      = CKPT_VERSION;
+    h->byte_order   = CKPT_BYTE_ORDER;
+    h->input_offset = input_offset;
+    h->ingest_done  = ingest_done;
+    h->ncand        = cbox_candidates(cb);
+    h->nballots     = cbox_size(cb);
+    h->nranks       = cbox_rank_count(cb);
+    for (size_t c = 0; c < h->ncand; ++c) {
+        h->name_bytes += strlen(cbox_name(cb, (cand_t) c)) + 1;
+    }
+    h->eliminated  = tab ? tab_eliminations(tab) : 0;
+    h->tally_round = tab ? h->eliminated : NO_TALLY;
+
+    bool room      = !ingest_done;
+    h->cand_room   = room ? room_for(h->ncand, CBOX_MAX_CANDIDATES)
+                          : h->ncand;
+    h->name_room   = room ? room_for(h->name_bytes, UINT64_MAX / 4)
+                          : h->name_bytes;
+    h->ballot_room = room ? room_for(h->nballots, UINT64_MAX / 16)
+                          : h->nballots;
+    h->rank_room   = room ? room_for(h->nranks, UINT64_MAX / 4)
+                          : h->nranks;
+    layout(h);
+}
+
+// Writes the header `h` and then every section of the checkpoint of
+// `cb` and `tab` to `f`.
+static void put_all(FILE* f, const struct ckpt_header* h, cbox_t cb,
+                    tabulator_t tab)
+{
+    uint64_t pos = 0;
+    put(f, &pos, h, sizeof *h);
+
+    pad_to(f, &pos, h->off_name_offsets);
+    put_name_offsets(f, &pos, cb, 0, h->ncand, 0);
+
+    pad_to(f, &pos, h->off_names);
+    put_names(f, &pos, cb, 0, h->ncand);
+
+    pad_to(f, &pos, h->off_starts);
+    put_starts(f, &pos, cb, 0, h->nballots, 0);
+
+    pad_to(f, &pos, h->off_ranks);
+    put_ranks(f, &pos, cb, 0, h->nballots);
+
+    put_count(f, &pos, h, tab);
+}
+
+bool ckpt_save(const char* path, cbox_t cb, int64_t input_offset,
+               bool ingest_done, tabulator_t tab)
+{
+    struct ckpt_header h;
+    make_header(&h, cb, input_offset, ingest_done, tab);
+
+    size_t tmp_len = strlen(path) + 5;
+    char* tmp = mallocb(tmp_len, "ckpt_save");
+    snprintf(tmp, tmp_len, "%s.tmp", path);
+
+    FILE* f = fopen(tmp, "wb");
+    if (f == NULL) {
+        perror(tmp);
+        free(tmp);
+        return false;
+    }
+
+    put_all(f, &h, cb, tab);
+
+    bool ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (ok && rename(tmp, path) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        perror(path);
+        unlink(tmp);
+    }
+
+    free(tmp);
+    return ok;
+}
+
+bool ckpt_append(const char* path, cbox_t cb, int64_t input_offset,
+                 bool ingest_done)
+{
+    FILE* f = fopen(path, "r+b");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    struct ckpt_header old;
+    if (fread(&old, sizeof old, 1, f) != 1 ||
+            memcmp(old.magic, CKPT_MAGIC, sizeof CKPT_MAGIC) != 0 ||
+            old.version != CKPT_VERSION ||
+            old.byte_order != CKPT_BYTE_ORDER ||
+            old.ncand > cbox_candidates(cb) ||
+            old.nballots > cbox_size(cb) ||
+            old.tally_round != NO_TALLY) {
+        fprintf(stderr, "%s: not a checkpoint of this ingest\n", path);
+        fclose(f);
+        return false;
+    }
+
+    struct ckpt_header h = old;
+    h.input_offset = input_offset;
+    h.ingest_done  = ingest_done;
+    h.ncand        = cbox_candidates(cb);
+    h.nballots     = cbox_size(cb);
+    h.nranks       = cbox_rank_count(cb);
+    for (size_t c = old.ncand; c < h.ncand; ++c) {
+        h.name_bytes += strlen(cbox_name(cb, (cand_t) c)) + 1;
+    }
+
+    if (h.ncand > h.cand_room || h.name_bytes > h.name_room ||
+            h.nballots > h.ballot_room || h.nranks > h.rank_room) {
+        fclose(f);
+        return ckpt_save(path, cb, input_offset, ingest_done, NULL);
+    }
+
+    // The new names and ballots go in the room past the old ones, where
+    // the old header does not look; once they are synced, the new
+    // header, which fits in one sector, takes them in.
+    uint64_t pos = 0;
+    fseeko(f, (off_t) (old.off_name_offsets + old.ncand * sizeof pos),
+           SEEK_SET);
+    put_name_offsets(f, &pos, cb, old.ncand, h.ncand, old.name_bytes);
+    fseeko(f, (off_t) (old.off_names + old.name_bytes), SEEK_SET);
+    put_names(f, &pos, cb, old.ncand, h.ncand);
+    fseeko(f, (off_t) (old.off_starts + old.nballots * sizeof pos),
+           SEEK_SET);
+    put_starts(f, &pos, cb, old.nballots, h.nballots, old.nranks);
+    fseeko(f, (off_t) (old.off_ranks + old.nranks * sizeof(cand_t)),
+           SEEK_SET);
+    put_ranks(f, &pos, cb, old.nballots, h.nballots);
+
+    bool ok = fflush(f) == 0 && fdatasync(fileno(f)) == 0;
+    ok = ok && fseeko(f, 0, SEEK_SET) == 0 &&
+         fwrite(&h, sizeof h, 1, f) == 1 &&
+         fflush(f) == 0 && fdatasync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        perror(path);
+    }
+    return ok;
+}
+
+bool ckpt_record_round(const char* path, tabulator_t tab)
+{
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+
+    struct ckpt_header h;
+    bool ok = pread(fd, &h, sizeof h, 0) == (ssize_t) sizeof h &&
+              memcmp(h.magic, CKPT_MAGIC, sizeof CKPT_MAGIC) == 0;
+
+    size_t neliminated = tab_eliminations(tab);
+    ok = ok && neliminated <= h.ncand;
+
+    // Three steps, each synced before the next, so that a crash leaves
+    // either the old count or the new one: first mark the tallies
+    // invalid, since they are about to be overwritten; then write the
+    // new order entries (past the `eliminated` in use) and tallies;
+    // then the header fields that say they are valid.
+    uint64_t no_tally = NO_TALLY;
+    ok = ok &&
+         pwrite(fd, &no_tally, sizeof no_tally,
+                offsetof(struct ckpt_header, tally_round)) ==
+         (ssize_t) sizeof no_tally &&
+         fdatasync(fd) == 0;
+    for (size_t k = h.eliminated; ok && k < neliminated; ++k) {
+        cand_t id = tab_eliminated(tab, k);
+        ok = pwrite(fd, &id, sizeof id, h.off_order + k * sizeof id) ==
+             (ssize_t) sizeof id;
+    }
+    for (size_t c = 0; ok && c < h.ncand; ++c) {
+        uint64_t n = tab_count(tab, (cand_t) c);
+        ok = pwrite(fd, &n, sizeof n, h.off_tallies + c * sizeof n) ==
+             (ssize_t) sizeof n;
+    }
+    ok = ok && fdatasync(fd) == 0;
+    if (ok) {
+        uint64_t state[2] = { neliminated, neliminated };
+        ok = pwrite(fd, state, sizeof state,
+                    offsetof(struct ckpt_header, eliminated)) ==
+             (ssize_t) sizeof state;
+    }
+    ok = ok && fdatasync(fd) == 0;
+
+    if (!ok) {
+        fprintf(stderr, "%s: could not record round: %s\n", path,
+                errno ? strerror(errno) : "not a checkpoint");
+    }
+    close(fd);
+    return ok;
+}
+
+///
+/// READING
+///
+
+// Checks that the section of `count` elements of `size` bytes at
+// `offset` lies within the file.
+static bool section_fits(const struct ckpt* ck, uint64_t offset,
+                         uint64_t count, uint64_t size)
+{
+    return offset % 8 == 0 && offset <= ck->size &&
+           count <= (ck->size - offset) / size;
+}
+
+// Checks that the ballots of the checkpoint `h` mapped at `base` are
+// in order, no longer than `cbox_push` allows, and rank only real
+// candidates; the tabulator trusts all of this. Takes time in
+// proportion to the ballots, so is left out of attaching.
+static bool ballots_valid(const struct ckpt_header* h, const char* base)
+{
+    const uint64_t* starts = (const uint64_t*) (base + h->off_starts);
+    const cand_t*   ranks  = (const cand_t*) (base + h->off_ranks);
+    for (size_t i = 0; i < h->nballots; ++i) {
+        if (starts[i] > starts[i + 1] ||
+                starts[i + 1] - starts[i] > MAX_CANDIDATES) {
+            return false;
+        }
+    }
+    for (size_t k = 0; k < h->nranks; ++k) {
+        if (ranks[k] >= h->ncand) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Checks the header, that every section lies within the mapping, and
+// the names and elimination order, all in time proportional to the
+// number of candidates; and if `deep`, the ballots too (see
+// `ballots_valid`).
+static bool valid(const struct ckpt* ck, bool deep)
+{
+    const struct ckpt_header* h = ck->header;
+    if (ck->size < sizeof *h ||
+            memcmp(h->magic, CKPT_MAGIC, sizeof CKPT_MAGIC) != 0 ||
+            h->version != CKPT_VERSION ||
+            h->byte_order != CKPT_BYTE_ORDER ||
+            h->file_size != ck->size ||
+            h->ncand > CBOX_MAX_CANDIDATES ||
+            h->eliminated > h->ncand ||
+            h->cand_room > CBOX_MAX_CANDIDATES ||
+            h->ballot_room >= h->file_size ||
+            h->ncand > h->cand_room || h->name_bytes > h->name_room ||
+            h->nballots > h->ballot_room || h->nranks > h->rank_room) {
+        return false;
+    }
+
+    if (!section_fits(ck, h->off_name_offsets, h->cand_room + 1, 8) ||
+            !section_fits(ck, h->off_names, h->name_room, 1) ||
+            !section_fits(ck, h->off_starts, h->ballot_room + 1, 8) ||
+            !section_fits(ck, h->off_ranks, h->rank_room, sizeof(cand_t)) ||
+            !section_fits(ck, h->off_order, h->cand_room, sizeof(cand_t)) ||
+            !section_fits(ck, h->off_tallies, h->cand_room, 8)) {
+        return false;
+    }
+
+    const char* base = ck->base;
+    const uint64_t* name_offsets =
+        (const uint64_t*) (base + h->off_name_offsets);
+    const char* names = base + h->off_names;
+    if (name_offsets[0] != 0 || name_offsets[h->ncand] != h->name_bytes) {
+        return false;
+    }
+    for (size_t c = 0; c < h->ncand; ++c) {
+        if (name_offsets[c] >= name_offsets[c + 1] ||
+                names[name_offsets[c + 1] - 1] != 0) {
+            return false;
+        }
+    }
+
+    const uint64_t* starts = (const uint64_t*) (base + h->off_starts);
+    if (starts[0] != 0 || starts[h->nballots] != h->nranks ||
+            (deep && !ballots_valid(h, base))) {
+        return false;
+    }
+
+    // The elimination order must name each candidate at most once.
+    const cand_t* order = (const cand_t*) (base + h->off_order);
+    bool* seen = callocb(h->ncand + 1, sizeof *seen, "ckpt_open");
+    bool  ok   = true;
+    for (size_t k = 0; ok && k < h->eliminated; ++k) {
+        ok = order[k] < h->ncand && !seen[order[k]];
+        if (ok) {
+            seen[order[k]] = true;
+        }
+    }
+    free(seen);
+    return ok;
+}
+
+// Maps the checkpoint open on `fd`, named `path` in messages, and
+// closes `fd`. Checks its ballots only if `deep` (see `valid`).
+static ckpt_t map_fd(int fd, const char* path, bool deep)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror(path);
+        close(fd);
+        return NULL;
+    }
+
+    struct ckpt* ck = mallocb(sizeof *ck, "ckpt_open");
+    ck->size = (size_t) st.st_size;
+    ck->base = ck->size == 0 ? MAP_FAILED
+        : mmap(NULL, ck->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (ck->base == MAP_FAILED) {
+        fprintf(stderr, "%s: cannot map checkpoint\n", path);
+        free(ck);
+        return NULL;
+    }
+
+    ck->header = ck->base;
+    if (!valid(ck, deep)) {
+        fprintf(stderr, "%s: not a valid checkpoint\n", path);
+        munmap(ck->base, ck->size);
+        free(ck);
+        return NULL;
+    }
+
+    const struct ckpt_header* h = ck->header;
+    const char* base = ck->base;
+    const uint64_t* name_offsets =
+        (const uint64_t*) (base + h->off_name_offsets);
+    const char** names = mallocb((h->ncand + 1) * sizeof *names,
+                                 "ckpt_open");
+    for (size_t c = 0; c < h->ncand; ++c) {
+        names[c] = base + h->off_names + name_offsets[c];
+    }
+
+    ck->cb = cbox_view(h->ncand, names, h->nballots,
+                       (const size_t*) (base + h->off_starts),
+                       (const cand_t*) (base + h->off_ranks));
+    free(names);
+    return ck;
+}
+
+ckpt_t ckpt_open(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    return map_fd(fd, path, true);
+}
+
+void ckpt_close(ckpt_t ck)
+{
+    if (ck == NULL) {
+        return;
+    }
+
+    cbox_destroy(ck->cb);
+    munmap(ck->base, ck->size);
+    free(ck);
+}
+
+cbox_t ckpt_cbox(ckpt_t ck)
+{
+    return ck->cb;
+}
+
+int64_t ckpt_input_offset(ckpt_t ck)
+{
+    return ck->header->input_offset;
+}
+
+bool ckpt_ingest_done(ckpt_t ck)
+{
+    return ck->header->ingest_done != 0;
+}
+
+size_t ckpt_eliminations(ckpt_t ck)
+{
+    return ck->header->eliminated;
+}
+
+bool ckpt_resume_count(ckpt_t ck, tabulator_t tab)
+{
+    const struct ckpt_header* h = ck->header;
+    if (cbox_size(ck->cb) != h->nballots) {
+        tab_start(tab, ck->cb, NULL);
+        return true;
+    }
+
+    const char* base     = ck->base;
+    const cand_t* order  = (const cand_t*) (base + h->off_order);
+    const uint64_t* tally = (const uint64_t*) (base + h->off_tallies);
+    for (size_t k = 0; k < h->eliminated; ++k) {
+        if (order[k] >= h->ncand) {
+            fprintf(stderr, "checkpoint: bad elimination order\n");
+            return false;
+        }
+    }
+
+    tab_resume(tab, ck->cb, NULL, order, h->eliminated);
+
+    if (h->tally_round == h->eliminated) {
+        for (size_t c = 0; c < h->ncand; ++c) {
+            if (tab_count(tab, (cand_t) c) != tally[c]) {
+                fprintf(stderr, "checkpoint: saved tallies do not match\n");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+///
+/// SHARED MEMORY
+///
+
+bool ckpt_publish(const char* name, cbox_t cb)
+{
+    struct ckpt_header h;
+    make_header(&h, cb, -1, true, NULL);
+
+    // A new object replaces the old, which those attached to it keep.
+    // Until the magic number is written last, attaching fails.
+    if (shm_unlink(name) != 0 && errno != ENOENT) {
+        perror(name);
+        return false;
+    }
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        perror(name);
+        return false;
+    }
+    FILE* f = fdopen(fd, "wb");
+    if (f == NULL) {
+        perror(name);
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    struct ckpt_header unsealed = h;
+    memset(unsealed.magic, 0, sizeof unsealed.magic);
+    put_all(f, &unsealed, cb, NULL);
+    bool ok = fflush(f) == 0;
+
+    // The ballots are checked here, once, as written, so that
+    // `ckpt_attach` need not check them each time.
+    void* base = ok ? mmap(NULL, h.file_size, PROT_READ, MAP_SHARED, fd, 0)
+                    : MAP_FAILED;
+    ok = base != MAP_FAILED;
+    if (ok && !ballots_valid(&h, base)) {
+        fprintf(stderr, "%s: ballot box is damaged\n", name);
+        munmap(base, h.file_size);
+        fclose(f);
+        shm_unlink(name);
+        return false;
+    }
+    if (ok) {
+        munmap(base, h.file_size);
+    }
+
+    ok = ok &&
+         pwrite(fd, h.magic, sizeof h.magic,
+                offsetof(struct ckpt_header, magic)) ==
+         (ssize_t) sizeof h.magic;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        perror(name);
+        shm_unlink(name);
+    }
+    return ok;
+}
+
+ckpt_t ckpt_attach(const char* name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        perror(name);
+        return NULL;
+    }
+
+    // `ckpt_publish` checked the ballots, and only the publisher can
+    // write the object, so each attach checks just the rest.
+    return map_fd(fd, name, false);
+}
+
+bool ckpt_unpublish(const char* name)
+{
+    if (shm_unlink(name) != 0) {
+        perror(name);
+        return false;
+    }
+    return true;
+}
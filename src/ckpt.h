@@ -0,0 +1,176 @@
+#pragma once
+
+// Checkpoints: snapshots of an ingest and count in progress, which can
+// be mapped straight back into memory to resume.
+//
+// A checkpoint file holds a compact ballot box (candidate table and
+// ballots), how far into the input the ingest had got, and the state of
+// the count: the candidates eliminated so far, in order, and the
+// tallies after the last of those eliminations. Every section is a flat
+// array of fixed-width integers at an 8-byte-aligned offset recorded in
+// the header, so `ckpt_open` only maps the file and points a `cbox_t`
+// view at it; nothing is parsed or copied.
+//
+// Files are written in the byte order of the machine that writes them
+// and are rejected on a machine with the other order.
+//
+// Layout (all offsets from the start of the file):
+//
+//   header             struct ckpt_header (see ckpt.c)
+//   name offsets       uint64 x (candidates + 1), into the name bytes
+//   name bytes         the names, each 0-terminated
+//   ballot starts      uint64 x (ballots + 1), as in cbox_view
+//   ranks              uint16 x (total rankings)
+//   elimination order  uint16 x candidates (first `eliminated` used)
+//   tallies            uint64 x candidates
+//
+// The last two sections have room for every candidate, so recording a
+// round only overwrites them in place (see `ckpt_record_round`) rather
+// than rewriting the ballots. A checkpoint taken mid-ingest likewise
+// leaves room in every section, twice what is used, so that the next
+// one only adds the new ballots (see `ckpt_append`).
+//
+// The same layout, with the ingest finished and no count, serves to
+// share one loaded box among processes: `ckpt_publish` writes it to a
+// named POSIX shared memory object, and `ckpt_attach` maps that
+// read-only. Every process attached shares the one copy of the ballots
+// and keeps only its own count's state, so attaching takes no time to
+// speak of and memory does not grow with the number of counts.
+
+#include "cbox.h"
+#include "tabulate.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ckpt* ckpt_t;
+
+// Writes a checkpoint of `cb` to `path`, replacing it atomically (the
+// file is written beside it and renamed into place). `input_offset` is
+// how many bytes of input produced `cb`, or -1 if unknown;
+// `ingest_done` says whether that was all of it. If `tab` is non-NULL,
+// it must be counting `cb`, and its eliminations and tallies so far are
+// saved too.
+//
+// OWNERSHIP:
+//  - Borrows all arguments transiently.
+//
+// ERRORS:
+//  - Returns false (after printing a message to stderr) if the file
+//    cannot be written.
+bool ckpt_save(const char* path, cbox_t cb, int64_t input_offset,
+               bool ingest_done, tabulator_t tab);
+
+// Brings the checkpoint at `path`, saved (with no count) from an
+// earlier state of the same ingest into `cb`, up to date with `cb`, as
+// `ckpt_save` would. The new ballots and candidates are written into
+// the room the file has for them, and then the header is rewritten in
+// place to take them in, so the cost is that of the new ballots only;
+// only when they do not fit is the whole file rewritten, with more
+// room, by `ckpt_save`.
+//
+// PRECONDITION:
+//  - The ballots and candidates in the file are the first ones of `cb`.
+//
+// OWNERSHIP:
+//  - Borrows all arguments transiently.
+//
+// ERRORS:
+//  - Returns false (after printing a message to stderr) if the file
+//    cannot be read or written, or is not a checkpoint of an ingest.
+bool ckpt_append(const char* path, cbox_t cb, int64_t input_offset,
+                 bool ingest_done);
+
+// Overwrites the count state of the checkpoint at `path`, which must
+// have been saved from the same ballot box that `tab` is counting, with
+// `tab`'s eliminations and tallies so far.
+//
+// ERRORS:
+//  - Returns false (after printing a message to stderr) if the file
+//    cannot be updated.
+bool ckpt_record_round(const char* path, tabulator_t tab);
+
+// Maps the checkpoint at `path` into memory.
+//
+// OWNERSHIP:
+//  - The caller owns the result and must free it with `ckpt_close`.
+//
+// ERRORS:
+//  - Returns NULL (after printing a message to stderr) if the file
+//    cannot be read or is not a valid checkpoint, which includes one
+//    whose ballots or elimination order name candidates it does not
+//    have.
+ckpt_t ckpt_open(const char* path);
+
+// Unmaps `ck` and frees its ballot box. `ck` may be NULL.
+//
+// OWNERSHIP:
+//  - Takes ownership of `ck`.
+void ckpt_close(ckpt_t ck);
+
+// Returns the checkpoint's ballot box, a view of the mapped file.
+// Adding ballots to it is allowed; it copies them out first.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `ck`.
+cbox_t ckpt_cbox(ckpt_t ck);
+
+// Returns the input offset saved with the checkpoint (-1 if unknown).
+int64_t ckpt_input_offset(ckpt_t ck);
+
+// Returns whether the checkpoint was taken after the whole input had
+// been read.
+bool ckpt_ingest_done(ckpt_t ck);
+
+// Returns the number of eliminations saved with the checkpoint.
+size_t ckpt_eliminations(ckpt_t ck);
+
+// Resumes the saved count of `ckpt_cbox(ck)` with `tab`, as
+// `tab_resume` does, and checks the resulting tallies against the saved
+// ones. If ballots have been added to the box since it was opened, the
+// saved count no longer applies and `tab` starts a fresh count instead.
+//
+// ERRORS:
+//  - Returns false (after printing a message to stderr) if the saved
+//    tallies do not match.
+bool ckpt_resume_count(ckpt_t ck, tabulator_t tab);
+
+// Publishes `cb` as the shared memory object `name` (a POSIX shared
+// memory name, such as "/irv-2024"), in the checkpoint layout with the
+// ingest finished and no count. An object already published under
+// `name` is replaced; processes attached to it keep the old one.
+// Attaching fails until the object is complete.
+//
+// OWNERSHIP:
+//  - Borrows all arguments transiently.
+//
+// ERRORS:
+//  - Returns false (after printing a message to stderr) if the object
+//    cannot be created or written, or if the ballots as written fail
+//    the checks `ckpt_open` makes.
+bool ckpt_publish(const char* name, cbox_t cb);
+
+// Maps the shared memory object `name` published by `ckpt_publish`,
+// read-only, as `ckpt_open` maps a file. Counting `ckpt_cbox` of the
+// result with a tabulator of one's own leaves the object untouched.
+// Since `ckpt_publish` checks the ballots once as it writes them, this
+// checks only the header, the section bounds, the names and the
+// elimination order, taking time in proportion to the candidates
+// rather than the ballots.
+//
+// OWNERSHIP:
+//  - The caller owns the result and must free it with `ckpt_close`.
+//
+// ERRORS:
+//  - Returns NULL (after printing a message to stderr) if the object
+//    does not exist or is not a complete checkpoint.
+ckpt_t ckpt_attach(const char* name);
+
+// Removes the shared memory object `name`. Processes attached to it
+// keep their mappings.
+//
+// ERRORS:
+//  - Returns false (after printing a message to stderr) if there is no
+//    such object or it cannot be removed.
+bool ckpt_unpublish(const char* name);
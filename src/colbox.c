@@ -0,0 +1,241 @@
+#include "colbox.h"
+#include "helpers.h"
+#include "tabulate.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The histogram is split into this many interleaved copies, so that
+// consecutive ballots for the same candidate do not wait on each
+// other's increments.
+#define LANES 4
+
+// Ballots per block of a round's pass.
+#define BLOCK 256
+
+// A `colbox_t` (defined in `colbox.h`) is a pointer to a heap-allocated
+// `struct colbox`:
+//
+//  - Column `r` is `columns[r * nballots .. (r + 1) * nballots)`.
+//
+//  - During a count, ballot `i` is counting at rank `cursor[i]` for
+//    candidate `current[i]`, where the id `ncand` (the "exhausted"
+//    slot) stands for no candidate. `out` has `ncand + 1` entries, the
+//    last always false, so the exhausted slot needs no special case.
+//
+//  - `hist` is `LANES` histograms of `ncand + 1` counters each;
+//    `counts` is their sum.
+struct colbox
+{
+    size_t    nballots;
+    size_t    ncand;
+    size_t    depth;
+    cand_t*   columns;
+
+    uint16_t* cursor;
+    cand_t*   current;
+    bool*     out;
+    uint32_t* hist;
+    size_t*   counts;
+    size_t*   last;
+};
+
+colbox_t colbox_from_cbox(cbox_t cb)
+{
+    size_t nballots = cbox_size(cb);
+    size_t ncand    = cbox_candidates(cb);
+    if (nballots >= UINT32_MAX) {
+        exit(4);
+    }
+
+    size_t depth = 0;
+    for (size_t i = 0; i < nballots; ++i) {
+        size_t len;
+        cbox_ballot(cb, i, &len);
+        if (len > depth) {
+            depth = len;
+        }
+    }
+
+    colbox_t col = mallocb(sizeof *col, "colbox_from_cbox");
+    col->nballots = nballots;
+    col->ncand    = ncand;
+    col->depth    = depth;
+    col->columns  = mallocb((depth * nballots + 1) * sizeof *col->columns,
+                            "colbox_from_cbox");
+
+    for (size_t i = 0; i < nballots; ++i) {
+        size_t len;
+        const cand_t* ranks = cbox_ballot(cb, i, &len);
+        for (size_t r = 0; r < depth; ++r) {
+            col->columns[r * nballots + i] = r < len ? ranks[r] : CAND_NONE;
+        }
+    }
+
+    size_t slots   = ncand + 1;
+    col->cursor    = mallocb((nballots + 1) * sizeof *col->cursor,
+                             "colbox_from_cbox");
+    col->current   = mallocb((nballots + 1) * sizeof *col->current,
+                             "colbox_from_cbox");
+    col->out       = mallocb(slots * sizeof *col->out, "colbox_from_cbox");
+    col->hist      = mallocb(LANES * slots * sizeof *col->hist,
+                             "colbox_from_cbox");
+    col->counts    = mallocb(slots * sizeof *col->counts,
+                             "colbox_from_cbox");
+    col->last      = mallocb(slots * sizeof *col->last, "colbox_from_cbox");
+    return col;
+}
+
+void colbox_destroy(colbox_t col)
+{
+    if (col == NULL) {
+        return;
+    }
+
+    free(col->columns);
+    free(col->cursor);
+    free(col->current);
+    free(col->out);
+    free(col->hist);
+    free(col->counts);
+    free(col->last);
+    free(col);
+}
+
+size_t colbox_size(colbox_t col)
+{
+    return col->nballots;
+}
+
+size_t colbox_candidates(colbox_t col)
+{
+    return col->ncand;
+}
+
+size_t colbox_depth(colbox_t col)
+{
+    return col->depth;
+}
+
+const cand_t* colbox_column(colbox_t col, size_t rank)
+{
+    return col->columns + rank * col->nballots;
+}
+
+// Moves ballot `i`, whose current candidate is out, down its column
+// to the next continuing candidate, or to the exhausted slot.
+static cand_t advance(colbox_t col, size_t i)
+{
+    size_t pos = col->cursor[i];
+    cand_t c;
+    do {
+        ++pos;
+        c = pos < col->depth ? col->columns[pos * col->nballots + i]
+                             : CAND_NONE;
+    } while (c != CAND_NONE && col->out[c]);
+
+    col->cursor[i]  = (uint16_t) pos;
+    col->current[i] = c == CAND_NONE ? (cand_t) col->ncand : c;
+    return col->current[i];
+}
+
+// One round's pass: advances the ballots whose candidate is out and
+// sets `counts` and `last` for the continuing candidates. Returns the
+// number of continuing ballots.
+//
+// The pass goes a block at a time. Its main loop has no branches: it
+// counts every ballot for its current candidate and, from the gathered
+// out flag, appends the ballot to the block's list of those to move
+// (always writing the slot, and keeping it only if the flag is set).
+// Then just the listed ballots are advanced and recounted. `last` is
+// not tracked per ballot: afterwards, a scan back from the end finds
+// each counted candidate's last ballot, which in a large box is near
+// the end.
+static size_t count_round(colbox_t col)
+{
+    size_t slots = col->ncand + 1;
+    memset(col->hist, 0, LANES * slots * sizeof *col->hist);
+
+    const cand_t* current = col->current;
+    const bool*   out     = col->out;
+    uint32_t*     hist    = col->hist;
+    size_t        n       = col->nballots;
+    for (size_t from = 0; from < n; from += BLOCK) {
+        size_t len = n - from < BLOCK ? n - from : BLOCK;
+        const cand_t* cur = current + from;
+
+        uint16_t moved[BLOCK];
+        size_t   nmoved = 0;
+        for (size_t k = 0; k < len; ++k) {
+            cand_t c = cur[k];
+            moved[nmoved] = (uint16_t) k;
+            nmoved       += out[c];
+            ++hist[(k % LANES) * slots + c];
+        }
+        for (size_t m = 0; m < nmoved; ++m) {
+            size_t k    = moved[m];
+            size_t lane = (k % LANES) * slots;
+            --hist[lane + cur[k]];
+            ++hist[lane + advance(col, from + k)];
+        }
+    }
+
+    size_t total = 0, unseen = 0;
+    for (size_t c = 0; c < col->ncand; ++c) {
+        size_t count = 0;
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            count += hist[lane * slots + c];
+        }
+        col->counts[c] = count;
+        col->last[c]   = 0;
+        total  += count;
+        unseen += count > 0;
+    }
+    for (size_t i = n; unseen > 0 && i-- > 0; ) {
+        cand_t c = current[i];
+        if (c < col->ncand && col->last[c] == 0) {
+            col->last[c] = i + 1;
+            --unseen;
+        }
+    }
+    return total;
+}
+
+cand_t colbox_run(colbox_t col, const bool* withdrawn,
+                  cand_t* order, size_t* neliminated)
+{
+    size_t ncand = col->ncand;
+    for (size_t c = 0; c < ncand; ++c) {
+        col->out[c] = withdrawn ? withdrawn[c] : false;
+    }
+    col->out[ncand] = false;
+
+    for (size_t i = 0; i < col->nballots; ++i) {
+        cand_t first    = col->depth > 0 ? col->columns[i] : CAND_NONE;
+        col->cursor[i]  = 0;
+        col->current[i] = first == CAND_NONE ? (cand_t) ncand : first;
+    }
+
+    size_t k = 0;
+    cand_t winner;
+    for (;;) {
+        size_t total = count_round(col);
+        winner = tab_pick_max(ncand, col->counts, col->last);
+        if (winner == CAND_NONE || 2 * col->counts[winner] > total) {
+            break;
+        }
+
+        cand_t loser = tab_pick_min(ncand, col->counts, col->last);
+        col->out[loser] = true;
+        if (order) {
+            order[k] = loser;
+        }
+        ++k;
+    }
+
+    if (neliminated) {
+        *neliminated = k;
+    }
+    return winner;
+}
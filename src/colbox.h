@@ -0,0 +1,80 @@
+#pragma once
+
+// A columnar ballot box and the IRV count over it.
+//
+// A `colbox_t` holds the ballots of a `cbox_t` by rank position rather
+// than by ballot: column `r` is one contiguous array with every
+// ballot's `r`th choice (or `CAND_NONE` past the end of a short
+// ballot). Alongside the columns it keeps, for each ballot, the rank
+// it is currently counting at and the candidate at that rank.
+//
+// Each round of a count is then a single pass over two small-integer
+// arrays: look up whether each ballot's current candidate is out (a
+// gather from a per-candidate table), advance just those ballots down
+// their columns, and add the result to a per-candidate histogram. The
+// pass is branch-light and sequential, which suits wide vector units
+// and streaming memory better than chasing per-ballot lists; the price
+// is touching every ballot every round, and padding every ballot to
+// the longest one. The pile tabulator (tabulate.h) does less work when
+// there are many rounds; this layout wins on long boxes with few
+// candidates.
+//
+// Results match `tab_run`, and so `get_irv_winner`.
+
+#include "cbox.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct colbox* colbox_t;
+
+// Builds a columnar copy of the ballots in `cb`.
+//
+// OWNERSHIP:
+//  - Borrows `cb` transiently; the result does not refer to it.
+//  - The caller owns the result and must free it with
+//    `colbox_destroy`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated, and with code 4
+//    if `cb` has UINT32_MAX or more ballots.
+colbox_t colbox_from_cbox(cbox_t cb);
+
+// Frees `col`. `col` may be NULL.
+//
+// OWNERSHIP:
+//  - Takes ownership of `col`.
+void colbox_destroy(colbox_t col);
+
+// Returns the number of ballots.
+size_t colbox_size(colbox_t col);
+
+// Returns the number of candidates (as in the source `cbox_t`).
+size_t colbox_candidates(colbox_t col);
+
+// Returns the number of columns: the length of the longest ballot.
+size_t colbox_depth(colbox_t col);
+
+// Returns column `rank` (less than `colbox_depth(col)`): an array of
+// `colbox_size(col)` candidate ids.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `col`.
+const cand_t* colbox_column(colbox_t col, size_t rank);
+
+// Counts `col` to the end and returns the winner, or `CAND_NONE` if no
+// ballot ranks anyone. `withdrawn` is as for `tab_start`. If `order` is
+// non-NULL, it has room for `colbox_candidates(col)` ids and receives
+// the eliminated candidates in order; their number is stored in
+// `*neliminated` if that is non-NULL.
+//
+// The count's scratch state lives in `col`, so only one count of a
+// given `colbox_t` may run at a time.
+//
+// OWNERSHIP:
+//  - Borrows `withdrawn` transiently.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+cand_t colbox_run(colbox_t col, const bool* withdrawn,
+                  cand_t* order, size_t* neliminated);
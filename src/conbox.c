@@ -0,0 +1,179 @@
+#include "conbox.h"
+#include "helpers.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// Ballot slots per chunk.
+#define CHUNK_BALLOTS 256
+
+// A chunk of ballots belonging to one writer. `ballots[0 .. count)`
+// are published; the writer stores each ballot before raising `count`
+// (with release order), so a collector that reads `count` (with
+// acquire order) sees every ballot below it. `taken` is how many the
+// collector has copied, and is touched only by the collector.
+struct chunk
+{
+    _Atomic size_t count;
+    size_t         taken;
+    struct chunk*  next;
+    ballot_t       ballots[CHUNK_BALLOTS];
+};
+
+// A `conbox_t` (defined in `conbox.h`) is a pointer to a heap-allocated
+// `struct conbox`:
+//
+//  - `head` is the most recently created chunk; each chunk's `next` is
+//    the one created before it.
+//
+//  - The rest is the collector's: `seen` is the value of `head` at the
+//    last collect, and `open[0 .. nopen)` are the chunks that collect
+//    had not finished taking, oldest first.
+struct conbox
+{
+    _Atomic(struct chunk*) head;
+
+    struct chunk*  seen;
+    struct chunk** open;
+    size_t         nopen;
+    size_t         open_cap;
+};
+
+struct conbox_writer
+{
+    conbox_t      box;
+    struct chunk* chunk;
+};
+
+conbox_t conbox_create(void)
+{
+    conbox_t box = callocb(1, sizeof *box, "conbox_create");
+    atomic_init(&box->head, NULL);
+    return box;
+}
+
+void conbox_destroy(conbox_t box)
+{
+    if (box == NULL) {
+        return;
+    }
+
+    struct chunk* ch = atomic_load(&box->head);
+    while (ch) {
+        struct chunk* next = ch->next;
+        size_t count = atomic_load(&ch->count);
+        for (size_t j = 0; j < count; ++j) {
+            ballot_destroy(ch->ballots[j]);
+        }
+        free(ch);
+        ch = next;
+    }
+    free(box->open);
+    free(box);
+}
+
+conbox_writer_t conbox_writer_create(conbox_t box)
+{
+    conbox_writer_t w = mallocb(sizeof *w, "conbox_writer_create");
+    w->box   = box;
+    w->chunk = NULL;
+    return w;
+}
+
+void conbox_writer_destroy(conbox_writer_t w)
+{
+    free(w);
+}
+
+// Gives `w` a new, empty chunk and pushes it onto its box's list.
+static void new_chunk(conbox_writer_t w)
+{
+    struct chunk* ch = mallocb(sizeof *ch, "conbox_insert");
+    atomic_init(&ch->count, 0);
+    ch->taken = 0;
+    ch->next  = atomic_load_explicit(&w->box->head, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(
+                &w->box->head, &ch->next, ch,
+                memory_order_release, memory_order_relaxed)) {
+        continue;
+    }
+    w->chunk = ch;
+}
+
+void conbox_insert(conbox_writer_t w, ballot_t ballot)
+{
+    // Only this writer stores to its chunk's `count`, so it can read it
+    // without ordering.
+    if (w->chunk == NULL ||
+            atomic_load_explicit(&w->chunk->count, memory_order_relaxed)
+                == CHUNK_BALLOTS) {
+        new_chunk(w);
+    }
+
+    struct chunk* ch = w->chunk;
+    size_t n = atomic_load_explicit(&ch->count, memory_order_relaxed);
+    ch->ballots[n] = ballot;
+    atomic_store_explicit(&ch->count, n + 1, memory_order_release);
+}
+
+// Adds the chunks pushed since the last collect to `open`.
+static void open_new_chunks(conbox_t box)
+{
+    struct chunk* head = atomic_load_explicit(&box->head,
+                                              memory_order_acquire);
+    size_t fresh = 0;
+    for (struct chunk* ch = head; ch != box->seen; ch = ch->next) {
+        ++fresh;
+    }
+
+    if (box->nopen + fresh > box->open_cap) {
+        box->open_cap = 2 * (box->nopen + fresh);
+        box->open     = reallocb(box->open,
+                                 box->open_cap * sizeof *box->open,
+                                 "conbox_collect");
+    }
+
+    // The list runs newest first; `open` runs oldest first.
+    size_t j = box->nopen + fresh;
+    for (struct chunk* ch = head; ch != box->seen; ch = ch->next) {
+        box->open[--j] = ch;
+    }
+    box->nopen += fresh;
+    box->seen   = head;
+}
+
+// Copies `ballot` into `cb`.
+static void push_ballot(cbox_t cb, ballot_t ballot)
+{
+    size_t len = ballot_length(ballot);
+    cand_t ranks[MAX_CANDIDATES];
+    for (size_t j = 0; j < len; ++j) {
+        ranks[j] = cbox_intern(cb, ballot_name(ballot, j));
+    }
+    cbox_push(cb, ranks, len);
+}
+
+size_t conbox_collect(conbox_t box, cbox_t cb)
+{
+    open_new_chunks(box);
+
+    size_t collected = 0;
+    size_t kept      = 0;
+    for (size_t k = 0; k < box->nopen; ++k) {
+        struct chunk* ch = box->open[k];
+        size_t count = atomic_load_explicit(&ch->count,
+                                            memory_order_acquire);
+        for (size_t j = ch->taken; j < count; ++j) {
+            push_ballot(cb, ch->ballots[j]);
+        }
+        collected += count - ch->taken;
+        ch->taken  = count;
+
+        // A full chunk will get no more ballots.
+        if (count < CHUNK_BALLOTS) {
+            box->open[kept++] = ch;
+        }
+    }
+    box->nopen = kept;
+    return collected;
+}
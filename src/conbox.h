@@ -0,0 +1,84 @@
+#pragma once
+
+// A concurrent ballot box: many threads insert ballots while another
+// tabulates live results.
+//
+// Each inserting thread has its own `conbox_writer_t`, which fills a
+// chunk of ballot slots that only it writes. Storing a ballot in a
+// slot and then publishing the chunk's new length with a release store
+// is the whole insert, so inserts take no locks and never wait for one
+// another; a writer whose chunk is full pushes a fresh chunk onto the
+// box's list of chunks with a compare-and-swap.
+//
+// A single collector thread calls `conbox_collect` to copy the ballots
+// published since its last call into a `cbox_t`, where the compact
+// engines can count them (e.g., with `tab_append` for a running
+// count). Each collect is a consistent snapshot: it takes, from every
+// writer, a prefix of that writer's ballots in the order they were
+// inserted, and includes every ballot whose insert finished before the
+// collect began. The order in which different writers' ballots are
+// interleaved is up to the collector.
+
+#include "ballot.h"
+#include "cbox.h"
+
+#include <stddef.h>
+
+typedef struct conbox* conbox_t;
+typedef struct conbox_writer* conbox_writer_t;
+
+// Creates an empty concurrent ballot box.
+//
+// OWNERSHIP:
+//  - The caller owns the result and must free it with `conbox_destroy`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+conbox_t conbox_create(void);
+
+// Frees `box` and every ballot inserted in it. `box` may be NULL. No
+// writer may be inserting, and no collect running, at the time.
+//
+// OWNERSHIP:
+//  - Takes ownership of `box`.
+void conbox_destroy(conbox_t box);
+
+// Creates a writer, with which one thread at a time may insert ballots
+// into `box`.
+//
+// OWNERSHIP:
+//  - Borrows `box`, which must outlive the result.
+//  - The caller owns the result and must free it with
+//    `conbox_writer_destroy`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+conbox_writer_t conbox_writer_create(conbox_t box);
+
+// Frees `w`. The ballots it inserted stay in the box. `w` may be NULL.
+//
+// OWNERSHIP:
+//  - Takes ownership of `w`.
+void conbox_writer_destroy(conbox_writer_t w);
+
+// Inserts `ballot` into `w`'s box.
+//
+// OWNERSHIP:
+//  - Takes ownership of `ballot`, which must not be modified
+//    afterwards.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+void conbox_insert(conbox_writer_t w, ballot_t ballot);
+
+// Appends to `cb` (whose previous contents, if any, are kept) the
+// ballots published in `box` since the last collect, and returns their
+// number. Only one thread may collect from a box, always into the same
+// `cb`.
+//
+// OWNERSHIP:
+//  - Borrows both arguments transiently.
+//
+// ERRORS:
+//  - Exits as `cbox_intern` and `cbox_push` do.
+size_t conbox_collect(conbox_t box, cbox_t cb);
@@ -0,0 +1,119 @@
+#include "digest.h"
+#include "helpers.h"
+#include "pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Ballots per task.
+#define TASK_BALLOTS 65536
+
+// Starting values of each lane's per-ballot hash.
+#define LANE0_SEED 0x243f6a8885a308d3u
+#define LANE1_SEED 0x13198a2e03707344u
+
+// The size of a cache line, for keeping workers' sums apart.
+#define CACHE_LINE 64
+
+// One worker's partial sums, aligned to (and so padded out to) a whole
+// cache line, so that no two workers write to the same one. The array
+// of them is allocated with the same alignment.
+struct partial
+{
+    _Alignas(CACHE_LINE) uint64_t lane[2];
+};
+
+struct job
+{
+    cbox_t          cb;
+    size_t          from;
+    size_t          to;
+    const uint64_t* name_hash[2];
+    struct partial* partials;
+};
+
+void digest_init(struct digest* d)
+{
+    d->lane[0] = 0;
+    d->lane[1] = 0;
+    d->ballots = 0;
+}
+
+static void hash_task(void* ctx, size_t task, size_t worker)
+{
+    struct job* job = ctx;
+    size_t from = job->from + task * TASK_BALLOTS;
+    size_t to   = from + TASK_BALLOTS < job->to ? from + TASK_BALLOTS
+                                                : job->to;
+    uint64_t sum0 = 0, sum1 = 0;
+
+    for (size_t i = from; i < to; ++i) {
+        size_t len;
+        const cand_t* ranks = cbox_ballot(job->cb, i, &len);
+        uint64_t h0 = LANE0_SEED, h1 = LANE1_SEED;
+        for (size_t j = 0; j < len; ++j) {
+            h0 = mix64(h0 ^ job->name_hash[0][ranks[j]]);
+            h1 = mix64(h1 + job->name_hash[1][ranks[j]]);
+        }
+        sum0 += mix64(h0 ^ len);
+        sum1 += mix64(h1 + len);
+    }
+
+    job->partials[worker].lane[0] += sum0;
+    job->partials[worker].lane[1] += sum1;
+}
+
+void digest_add(struct digest* d, cbox_t cb, size_t from, size_t nworkers)
+{
+    size_t to = cbox_size(cb);
+    if (from >= to) {
+        return;
+    }
+    if (nworkers == 0) {
+        nworkers = pool_default_workers();
+    }
+
+    // Two hashes of each name: without and with its terminating 0.
+    size_t ncand = cbox_candidates(cb);
+    uint64_t* name_hash = mallocb(2 * (ncand + 1) * sizeof *name_hash,
+                                  "digest_add");
+    for (size_t c = 0; c < ncand; ++c) {
+        const char* name = cbox_name(cb, (cand_t) c);
+        size_t len = strlen(name);
+        name_hash[c]             = hash_bytes(name, len);
+        name_hash[ncand + 1 + c] = hash_bytes(name, len + 1);
+    }
+
+    struct job job = {
+        .cb        = cb,
+        .from      = from,
+        .to        = to,
+        .name_hash = { name_hash, name_hash + ncand + 1 },
+        .partials  = aligned_alloc(CACHE_LINE,
+                                   nworkers * sizeof *job.partials),
+    };
+    if (job.partials == NULL) {
+        perror("digest_add");
+        exit(1);
+    }
+    memset(job.partials, 0, nworkers * sizeof *job.partials);
+    size_t ntasks = (to - from + TASK_BALLOTS - 1) / TASK_BALLOTS;
+    pool_run(nworkers, ntasks, hash_task, &job);
+
+    for (size_t w = 0; w < nworkers; ++w) {
+        d->lane[0] += job.partials[w].lane[0];
+        d->lane[1] += job.partials[w].lane[1];
+    }
+    d->ballots += to - from;
+
+    free(job.partials);
+    free(name_hash);
+}
+
+void digest_format(const struct digest* d, char out[DIGEST_HEX_LEN + 1])
+{
+    snprintf(out, DIGEST_HEX_LEN + 1, "%016llx%016llx",
+             (unsigned long long) d->lane[0],
+             (unsigned long long) d->lane[1]);
+}
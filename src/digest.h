@@ -0,0 +1,46 @@
+#pragma once
+
+// An order-independent digest of a ballot box, so that two runs can
+// show they counted the same ballots.
+//
+// Each ballot is hashed from the cleaned names it ranks, in rank order
+// (after `cbox_t`'s removal of repeated names), and the digest is the
+// sum of those hashes in two independent 64-bit lanes, together with
+// the number of ballots. Since addition is commutative, the digest
+// does not depend on the order of the ballots, on how their names were
+// spelled before cleaning, or on the ids a particular box gave the
+// candidates; and a box can be digested a batch at a time, in
+// parallel. Two boxes with the same digest hold the same multiset of
+// rankings with overwhelming probability, but the digest is a check
+// against accident, not a cryptographic commitment.
+
+#include "cbox.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The length of `digest_format`'s output, not counting the 0.
+#define DIGEST_HEX_LEN 32
+
+struct digest
+{
+    uint64_t lane[2];
+    size_t   ballots;
+};
+
+// Sets `d` to the digest of no ballots.
+void digest_init(struct digest* d);
+
+// Adds ballots `from .. cbox_size(cb)` of `cb` to `d`, hashing them on
+// up to `nworkers` threads (0 means `pool_default_workers()`).
+//
+// OWNERSHIP:
+//  - Borrows `cb` for the duration of the call.
+//
+// ERRORS:
+//  - Exits with code 1 if threads or memory cannot be allocated.
+void digest_add(struct digest* d, cbox_t cb, size_t from, size_t nworkers);
+
+// Writes the two lanes of `d` as DIGEST_HEX_LEN lowercase hex digits
+// and a terminating 0 to `out`.
+void digest_format(const struct digest* d, char out[DIGEST_HEX_LEN + 1]);
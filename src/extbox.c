@@ -0,0 +1,339 @@
+#include "extbox.h"
+#include "helpers.h"
+#include "tabulate.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Each chunk file is a sequence of BLOCK_BYTES blocks. A block starts
+// with a `struct block_header` and is followed by `nballots` records,
+// each a uint16 length and then that many uint16 candidate ids; no
+// record crosses a block boundary, and the rest of the block is
+// zero. A chunk file holds up to CHUNK_BLOCKS blocks. Counting reads
+// READ_BLOCKS blocks at a time.
+#define BLOCK_BYTES  ((size_t) 1 << 20)
+#define CHUNK_BLOCKS 256
+#define READ_BLOCKS  8
+
+// Buffers are aligned for direct transfers to and from the page cache.
+#define BUFFER_ALIGN 4096
+
+struct block_header
+{
+    uint32_t nballots;
+    uint32_t used;
+};
+
+struct chunk
+{
+    int    fd;
+    size_t nblocks;
+};
+
+// An `extbox_t` (defined in `extbox.h`) is a pointer to a
+// heap-allocated `struct extbox`. `chunks[0 .. nchunks)` are the open
+// (and unlinked) chunk files, the last of them the one being written.
+// `block` is the block being filled: `used` bytes so far, holding
+// `block_ballots` ballots. `nballots` counts every ballot, including
+// those in `block`.
+struct extbox
+{
+    char*         dir;
+    struct chunk* chunks;
+    size_t        nchunks;
+    size_t        chunk_cap;
+
+    unsigned char* block;
+    size_t        used;
+    size_t        block_ballots;
+    size_t        nballots;
+};
+
+static void* aligned_buffer(size_t size, const char* blame)
+{
+    void* result = aligned_alloc(BUFFER_ALIGN, size);
+    if (!result) {
+        perror(blame);
+        exit(1);
+    }
+    return result;
+}
+
+// Creates, opens and unlinks a new chunk file. Returns false (after
+// printing a message) on failure.
+static bool add_chunk(extbox_t eb)
+{
+    size_t len = strlen(eb->dir) + sizeof "/irv-extbox-XXXXXX";
+    char* path = mallocb(len, "extbox");
+    snprintf(path, len, "%s/irv-extbox-XXXXXX", eb->dir);
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror(path);
+        free(path);
+        return false;
+    }
+    unlink(path);
+    free(path);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    if (eb->nchunks == eb->chunk_cap) {
+        eb->chunk_cap = eb->chunk_cap ? 2 * eb->chunk_cap : 4;
+        eb->chunks    = reallocb(eb->chunks,
+                                 eb->chunk_cap * sizeof *eb->chunks,
+                                 "extbox");
+    }
+    eb->chunks[eb->nchunks++] = (struct chunk) { fd, 0 };
+    return true;
+}
+
+extbox_t extbox_create(const char* dir)
+{
+    if (dir == NULL) {
+        dir = getenv("TMPDIR");
+    }
+    if (dir == NULL || *dir == 0) {
+        dir = "/tmp";
+    }
+
+    extbox_t eb = callocb(1, sizeof *eb, "extbox_create");
+    eb->dir   = strdupb(dir, "extbox_create");
+    eb->block = aligned_buffer(BLOCK_BYTES, "extbox_create");
+    eb->used  = sizeof(struct block_header);
+
+    if (!add_chunk(eb)) {
+        extbox_destroy(eb);
+        return NULL;
+    }
+    return eb;
+}
+
+void extbox_destroy(extbox_t eb)
+{
+    if (eb == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < eb->nchunks; ++i) {
+        close(eb->chunks[i].fd);
+    }
+    free(eb->chunks);
+    free(eb->block);
+    free(eb->dir);
+    free(eb);
+}
+
+// Writes `size` bytes at `offset` of `fd`, retrying short writes.
+static bool write_all(int fd, const void* buf, size_t size, off_t offset)
+{
+    const unsigned char* p = buf;
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p      += n;
+        size   -= (size_t) n;
+        offset += n;
+    }
+    return true;
+}
+
+// Writes out the block being filled, if it holds any ballots, and
+// starts a new one.
+static bool flush_block(extbox_t eb)
+{
+    if (eb->block_ballots == 0) {
+        return true;
+    }
+
+    struct chunk* ch = &eb->chunks[eb->nchunks - 1];
+    if (ch->nblocks == CHUNK_BLOCKS) {
+        if (!add_chunk(eb)) {
+            return false;
+        }
+        ch = &eb->chunks[eb->nchunks - 1];
+    }
+
+    struct block_header h = { (uint32_t) eb->block_ballots,
+                              (uint32_t) eb->used };
+    memcpy(eb->block, &h, sizeof h);
+    memset(eb->block + eb->used, 0, BLOCK_BYTES - eb->used);
+
+    if (!write_all(ch->fd, eb->block, BLOCK_BYTES,
+                   (off_t) (ch->nblocks * BLOCK_BYTES))) {
+        perror("extbox: write");
+        return false;
+    }
+
+    ++ch->nblocks;
+    eb->used          = sizeof h;
+    eb->block_ballots = 0;
+    return true;
+}
+
+bool extbox_append(extbox_t eb, cbox_t cb)
+{
+    size_t n = cbox_size(cb);
+    for (size_t i = 0; i < n; ++i) {
+        size_t len;
+        const cand_t* ranks = cbox_ballot(cb, i, &len);
+        size_t size = (1 + len) * sizeof(uint16_t);
+
+        if (eb->used + size > BLOCK_BYTES && !flush_block(eb)) {
+            return false;
+        }
+
+        uint16_t len16 = (uint16_t) len;
+        memcpy(eb->block + eb->used, &len16, sizeof len16);
+        memcpy(eb->block + eb->used + sizeof len16, ranks,
+               len * sizeof *ranks);
+        eb->used += size;
+        ++eb->block_ballots;
+        ++eb->nballots;
+    }
+    return true;
+}
+
+size_t extbox_size(extbox_t eb)
+{
+    return eb->nballots;
+}
+
+///
+/// COUNTING
+///
+
+// Per-round state of a count: the tallies, as for `tab_pick_max`, and
+// the number of ballots passed so far this round.
+struct pass
+{
+    const bool* out;
+    size_t*     counts;
+    size_t*     last;
+    size_t      total;
+    size_t      index;
+};
+
+// Counts the ballots in one block.
+static void count_block(struct pass* p, const unsigned char* block)
+{
+    struct block_header h;
+    memcpy(&h, block, sizeof h);
+
+    const uint16_t* rec = (const uint16_t*) (block + sizeof h);
+    for (uint32_t k = 0; k < h.nballots; ++k) {
+        size_t len = rec[0];
+        const uint16_t* ranks = rec + 1;
+        ++p->index;
+        for (size_t j = 0; j < len; ++j) {
+            cand_t c = ranks[j];
+            if (!p->out[c]) {
+                ++p->counts[c];
+                p->last[c] = p->index;
+                ++p->total;
+                break;
+            }
+        }
+        rec = ranks + len;
+    }
+}
+
+// Reads `size` bytes at `offset` of `fd`, or exits.
+static void read_all(int fd, void* buf, size_t size, off_t offset)
+{
+    unsigned char* p = buf;
+    while (size > 0) {
+        ssize_t n = pread(fd, p, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            fprintf(stderr, "extbox: cannot read chunk: %s\n",
+                    n < 0 ? strerror(errno) : "unexpected end of file");
+            exit(1);
+        }
+        p      += n;
+        size   -= (size_t) n;
+        offset += n;
+    }
+}
+
+// Runs one round's pass over every chunk.
+static void count_round(extbox_t eb, struct pass* p, unsigned char* buf,
+                        size_t ncand)
+{
+    memset(p->counts, 0, ncand * sizeof *p->counts);
+    memset(p->last, 0, ncand * sizeof *p->last);
+    p->total = 0;
+    p->index = 0;
+
+    for (size_t i = 0; i < eb->nchunks; ++i) {
+        const struct chunk* ch = &eb->chunks[i];
+        for (size_t b = 0; b < ch->nblocks; b += READ_BLOCKS) {
+            size_t nblocks = ch->nblocks - b < READ_BLOCKS
+                ? ch->nblocks - b : READ_BLOCKS;
+            read_all(ch->fd, buf, nblocks * BLOCK_BYTES,
+                     (off_t) (b * BLOCK_BYTES));
+            for (size_t k = 0; k < nblocks; ++k) {
+                count_block(p, buf + k * BLOCK_BYTES);
+            }
+        }
+    }
+}
+
+cand_t extbox_run(extbox_t eb, size_t ncand, const bool* withdrawn,
+                  cand_t* order, size_t* neliminated)
+{
+    if (!flush_block(eb)) {
+        exit(1);
+    }
+
+    bool* out = mallocb((ncand + 1) * sizeof *out, "extbox_run");
+    for (size_t c = 0; c < ncand; ++c) {
+        out[c] = withdrawn ? withdrawn[c] : false;
+    }
+
+    struct pass p = {
+        .out    = out,
+        .counts = mallocb((ncand + 1) * sizeof *p.counts, "extbox_run"),
+        .last   = mallocb((ncand + 1) * sizeof *p.last, "extbox_run"),
+    };
+    unsigned char* buf = aligned_buffer(READ_BLOCKS * BLOCK_BYTES,
+                                        "extbox_run");
+
+    size_t k = 0;
+    cand_t winner;
+    for (;;) {
+        count_round(eb, &p, buf, ncand);
+        winner = tab_pick_max(ncand, p.counts, p.last);
+        if (winner == CAND_NONE || 2 * p.counts[winner] > p.total) {
+            break;
+        }
+
+        cand_t loser = tab_pick_min(ncand, p.counts, p.last);
+        out[loser] = true;
+        if (order) {
+            order[k] = loser;
+        }
+        ++k;
+    }
+
+    if (neliminated) {
+        *neliminated = k;
+    }
+
+    free(buf);
+    free(p.counts);
+    free(p.last);
+    free(out);
+    return winner;
+}
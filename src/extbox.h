@@ -0,0 +1,76 @@
+#pragma once
+
+// An external-memory ballot box, for elections too large to hold in
+// RAM.
+//
+// An `extbox_t` keeps its ballots on disk in a series of unlinked
+// temporary "chunk" files, each made of fixed-size blocks of compact
+// ballots (candidate ids, as in cbox.h). Ballots are added a batch at
+// a time from a `cbox_t` that the caller clears and refills, so memory
+// holds only the candidate table and one batch during ingest.
+//
+// A count keeps nothing but per-candidate tallies in memory: each
+// round is one sequential pass over every chunk, reading many blocks at
+// a time into an aligned buffer, in which each ballot is counted for
+// its first continuing choice. A count of R rounds therefore reads the
+// ballots R times; the kernel's readahead (requested with
+// `posix_fadvise`) keeps those reads streaming.
+//
+// Results match `tab_run`, and so `get_irv_winner`.
+
+#include "cbox.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct extbox* extbox_t;
+
+// Creates an empty external ballot box whose chunk files go in
+// directory `dir`, or in `$TMPDIR` (or /tmp) if `dir` is NULL.
+//
+// OWNERSHIP:
+//  - Borrows `dir` transiently.
+//  - The caller owns the result and must free it with
+//    `extbox_destroy`, which also releases the files.
+//
+// ERRORS:
+//  - Returns NULL (after printing a message to stderr) if the first
+//    chunk file cannot be created.
+//  - Exits with code 1 if memory cannot be allocated.
+extbox_t extbox_create(const char* dir);
+
+// Closes and frees `eb`; its chunk files are already unlinked, so this
+// gives their space back. `eb` may be NULL.
+//
+// OWNERSHIP:
+//  - Takes ownership of `eb`.
+void extbox_destroy(extbox_t eb);
+
+// Appends the ballots in `cb` to `eb`. Every batch appended to one
+// `extbox_t` must use the same candidate table (that is, come from the
+// same `cbox_t`, cleared with `cbox_clear` between batches).
+//
+// OWNERSHIP:
+//  - Borrows `cb` transiently.
+//
+// ERRORS:
+//  - Returns false (after printing a message to stderr) if writing
+//    fails, e.g. because the disk is full; ballots of the batch may
+//    then be missing.
+bool extbox_append(extbox_t eb, cbox_t cb);
+
+// Returns the number of ballots in `eb`.
+size_t extbox_size(extbox_t eb);
+
+// Counts `eb`, whose candidate ids are less than `ncand`, and returns
+// the winner, or `CAND_NONE` if no ballot ranks anyone. `withdrawn`,
+// `order` and `neliminated` are as for `colbox_run`.
+//
+// OWNERSHIP:
+//  - Borrows `withdrawn` transiently.
+//
+// ERRORS:
+//  - Exits with code 1 (after printing a message to stderr) if a
+//    chunk file cannot be read back, or if memory cannot be allocated.
+cand_t extbox_run(extbox_t eb, size_t ncand, const bool* withdrawn,
+                  cand_t* order, size_t* neliminated);
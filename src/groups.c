@@ -0,0 +1,201 @@
+#include "groups.h"
+#include "helpers.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A `groups_t` (defined in `groups.h`) is a pointer to a heap-allocated
+// `struct groups`:
+//
+//  - `names[0 .. ngroups)` are the distinct, owned keys, with their
+//    `hash_bytes` in `hashes` and ballot counts in `sizes`.
+//
+//  - `index` is an open-addressing hash table with `index_cap` slots (a
+//    power of two, more than twice `ngroups`); each slot holds 0 or one
+//    more than a group number, and every group is reachable by linear
+//    probing from its hash.
+//
+//  - `of[0 .. nballots)` are the ballots' group numbers, and `current`
+//    is the group of the next ballot read (`NO_GROUP` until the first
+//    ballot or key).
+//
+//  - `reader` reads with '@' as the metadata character.
+struct groups
+{
+    char**    names;
+    uint64_t* hashes;
+    size_t*   sizes;
+    size_t    ngroups;
+    size_t    group_cap;
+
+    uint32_t* index;
+    size_t    index_cap;
+
+    uint32_t* of;
+    size_t    nballots;
+    size_t    ballot_cap;
+    uint32_t  current;
+
+    struct cbox_reader reader;
+};
+
+#define NO_GROUP UINT32_MAX
+
+groups_t groups_create(void)
+{
+    groups_t gs = callocb(1, sizeof *gs, "groups_create");
+    gs->index_cap   = 64;
+    gs->index       = callocb(gs->index_cap, sizeof *gs->index,
+                              "groups_create");
+    gs->current     = NO_GROUP;
+    gs->reader      = (struct cbox_reader) CBOX_READER_INIT;
+    gs->reader.meta = '@';
+    return gs;
+}
+
+void groups_destroy(groups_t gs)
+{
+    if (gs == NULL) {
+        return;
+    }
+
+    for (size_t g = 0; g < gs->ngroups; ++g) {
+        free(gs->names[g]);
+    }
+    free(gs->names);
+    free(gs->hashes);
+    free(gs->sizes);
+    free(gs->index);
+    free(gs->of);
+    cbox_reader_free(&gs->reader);
+    free(gs);
+}
+
+// Returns the slot where `key` is or would be stored in the index.
+static size_t probe(groups_t gs, const char* key, size_t len, uint64_t h)
+{
+    size_t mask = gs->index_cap - 1;
+    size_t slot = h & mask;
+    for (;;) {
+        uint32_t k = gs->index[slot];
+        if (k == 0 || (gs->hashes[k - 1] == h &&
+                       strlen(gs->names[k - 1]) == len &&
+                       memcmp(gs->names[k - 1], key, len) == 0)) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+// Doubles the index and reinserts every group.
+static void grow_index(groups_t gs)
+{
+    free(gs->index);
+    gs->index_cap *= 2;
+    gs->index = callocb(gs->index_cap, sizeof *gs->index, "groups_read");
+
+    size_t mask = gs->index_cap - 1;
+    for (size_t g = 0; g < gs->ngroups; ++g) {
+        size_t slot = gs->hashes[g] & mask;
+        while (gs->index[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        gs->index[slot] = (uint32_t) (g + 1);
+    }
+}
+
+// Returns the number of the group with the `len`-byte key `key`,
+// adding the group if it is new.
+static uint32_t intern(groups_t gs, const char* key, size_t len)
+{
+    uint64_t h = hash_bytes(key, len);
+    size_t slot = probe(gs, key, len, h);
+    if (gs->index[slot] != 0) {
+        return gs->index[slot] - 1;
+    }
+
+    if (gs->ngroups == NO_GROUP) {
+        exit(4);
+    }
+    if (gs->ngroups == gs->group_cap) {
+        gs->group_cap = gs->group_cap ? 2 * gs->group_cap : 16;
+        gs->names  = reallocb(gs->names, gs->group_cap * sizeof *gs->names,
+                              "groups_read");
+        gs->hashes = reallocb(gs->hashes,
+                              gs->group_cap * sizeof *gs->hashes,
+                              "groups_read");
+        gs->sizes  = reallocb(gs->sizes, gs->group_cap * sizeof *gs->sizes,
+                              "groups_read");
+    }
+
+    size_t g = gs->ngroups++;
+    gs->names[g] = mallocb(len + 1, "groups_read");
+    memcpy(gs->names[g], key, len);
+    gs->names[g][len] = 0;
+    gs->hashes[g] = h;
+    gs->sizes[g]  = 0;
+    gs->index[slot] = (uint32_t) (g + 1);
+
+    if (2 * gs->ngroups >= gs->index_cap) {
+        grow_index(gs);
+    }
+    return (uint32_t) g;
+}
+
+size_t groups_read(groups_t gs, cbox_t cb, FILE* inf)
+{
+    return groups_read_n(gs, cb, inf, SIZE_MAX);
+}
+
+size_t groups_read_n(groups_t gs, cbox_t cb, FILE* inf, size_t max)
+{
+    size_t count = 0;
+    while (count < max && cbox_read_ballot_into(cb, inf, &gs->reader)) {
+        if (gs->reader.new_key) {
+            gs->current = intern(gs, gs->reader.key, gs->reader.key_len);
+            gs->reader.new_key = false;
+        } else if (gs->current == NO_GROUP) {
+            gs->current = intern(gs, "", 0);
+        }
+
+        if (gs->nballots == gs->ballot_cap) {
+            if (gs->nballots == UINT32_MAX) {
+                exit(4);
+            }
+            gs->ballot_cap = gs->ballot_cap ? 2 * gs->ballot_cap : 1024;
+            gs->of = reallocb(gs->of, gs->ballot_cap * sizeof *gs->of,
+                              "groups_read");
+        }
+        gs->of[gs->nballots++] = gs->current;
+        ++gs->sizes[gs->current];
+        ++count;
+    }
+
+    // A key after the last ballot applies to the next call's ballots.
+    if (gs->reader.new_key) {
+        gs->current = intern(gs, gs->reader.key, gs->reader.key_len);
+        gs->reader.new_key = false;
+    }
+    return count;
+}
+
+size_t groups_count(groups_t gs)
+{
+    return gs->ngroups;
+}
+
+const char* groups_name(groups_t gs, size_t g)
+{
+    return gs->names[g];
+}
+
+size_t groups_size(groups_t gs, size_t g)
+{
+    return gs->sizes[g];
+}
+
+const uint32_t* groups_of(groups_t gs)
+{
+    return gs->of;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Ballots grouped by precinct, batch, or any other key from the input.
+//
+// In the input read by `groups_read`, a line beginning with '@' is not
+// a name: the rest of the line is the group key of the ballot it
+// appears in and of every ballot after it, until the next such line.
+// (CVR exports list ballots precinct by precinct, so one key line per
+// precinct suffices.) Ballots before the first key line are in the
+// group "".
+//
+// Each group gets a number, in the order the keys first appear, and
+// each ballot's group number is kept in an array parallel to the box,
+// for the tabulator to break its tallies down by group (see
+// `tab_set_groups`).
+
+#include "cbox.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct groups* groups_t;
+
+// Creates an empty grouping.
+//
+// OWNERSHIP:
+//  - The caller owns the result and must free it with
+//    `groups_destroy`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+groups_t groups_create(void);
+
+// Frees `gs`. `gs` may be NULL.
+//
+// OWNERSHIP:
+//  - Takes ownership of `gs`.
+void groups_destroy(groups_t gs);
+
+// Reads ballots from `inf` until EOF, appending them to `cb` as
+// `cbox_read` does and noting each one's group, and returns how many
+// were read. The key in effect carries over from one call to the next.
+// `cb` must hold exactly the ballots read by earlier calls.
+//
+// OWNERSHIP:
+//  - Borrows all arguments transiently.
+//
+// ERRORS:
+//  - Exits as `cbox_read` does.
+//  - Exits with code 4 if there would be more than `UINT32_MAX`
+//    groups or ballots.
+size_t groups_read(groups_t gs, cbox_t cb, FILE* inf);
+
+// Like `groups_read`, but stops after `max` ballots.
+size_t groups_read_n(groups_t gs, cbox_t cb, FILE* inf, size_t max);
+
+// Returns the number of groups.
+size_t groups_count(groups_t gs);
+
+// Returns the key of group `g`.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `gs`.
+const char* groups_name(groups_t gs, size_t g);
+
+// Returns the number of ballots in group `g`.
+size_t groups_size(groups_t gs, size_t g);
+
+// Returns the group numbers of the ballots read so far, in order.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `gs` and is valid until the next
+//    `groups_read`.
+const uint32_t* groups_of(groups_t gs);
@@ -24,3 +24,104 @@ void* mallocb(size_t size, const char* blame)
 
     return result;
 }
+
+
+void* reallocb(void* ptr, size_t size, const char* blame)
+{
+    void* result = realloc(ptr, size);
+    if (!result && size) {
+        perror(blame);
+        exit(1);
+    }
+
+    return result;
+}
+
+
+void* callocb(size_t count, size_t size, const char* blame)
+{
+    void* result = calloc(count ? count : 1, size ? size : 1);
+    if (!result) {
+        perror(blame);
+        exit(1);
+    }
+
+    return result;
+}
+
+
+uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+
+uint64_t hash_bytes(const void* data, size_t len)
+{
+    const unsigned char* p = data;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return mix64(h ^ len);
+}
+
+
+static uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+void rng_seed(struct rng* rng, uint64_t seed, uint64_t stream)
+{
+    // Expand the seed with splitmix64, as the xoshiro authors suggest.
+    uint64_t x = seed ^ mix64(stream + 0x9e3779b97f4a7c15ULL);
+    for (size_t i = 0; i < 4; ++i) {
+        x += 0x9e3779b97f4a7c15ULL;
+        rng->s[i] = mix64(x);
+    }
+}
+
+uint64_t rng_next(struct rng* rng)
+{
+    uint64_t* s = rng->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+uint64_t rng_below(struct rng* rng, uint64_t bound)
+{
+    // Lemire's multiply-shift with rejection to stay unbiased.
+    uint64_t x = rng_next(rng);
+    __uint128_t m = (__uint128_t) x * bound;
+    uint64_t low = (uint64_t) m;
+    if (low < bound) {
+        uint64_t threshold = -bound % bound;
+        while (low < threshold) {
+            x = rng_next(rng);
+            m = (__uint128_t) x * bound;
+            low = (uint64_t) m;
+        }
+    }
+    return (uint64_t) (m >> 64);
+}
+
+double rng_unit(struct rng* rng)
+{
+    return (rng_next(rng) >> 11) * 0x1.0p-53;
+}
@@ -18,6 +18,10 @@
 
 // For size_t (used in the first declaration below):
 #include <stddef.h>
+// For uint64_t (hashing and random numbers, at the end):
+#include <stdint.h>
+// For ballot_t and ballot_box_t (the accessors at the end):
+#include "ballot_box.h"
 
 
 // strdupb - Obtains an owned clone of a borrowed string or exits
@@ -60,3 +64,107 @@ char* strdupb(const char* s, const char* blame);
 // message and exits with error code 1.
 void* mallocb(size_t size, const char* blame);
 
+
+
+// reallocb - Resizes heap memory or exits with an error.
+//
+// ARGUMENTS
+//
+// `ptr` - the object to resize (may be NULL); ownership is transferred
+// to the function
+// `size` - the new size in bytes
+// `blame` - blamed in the error message; borrowed ephemerally
+//
+// RESULT
+//
+// A pointer to the resized object, which the caller owns, as with
+// realloc(3).
+//
+// ERRORS
+//
+// If memory cannot be allocated then the function prints an error
+// message and exits with error code 1.
+void* reallocb(void* ptr, size_t size, const char* blame);
+
+
+// callocb - Allocates zeroed heap memory for an array or exits with an
+// error.
+//
+// ARGUMENTS
+//
+// `count` - the number of elements
+// `size` - the size of each element in bytes
+// `blame` - blamed in the error message; borrowed ephemerally
+//
+// RESULT
+//
+// A pointer to a new, heap-allocated, zero-filled array, as with
+// calloc(3). The caller owns the array.
+//
+// ERRORS
+//
+// If memory cannot be allocated then the function prints an error
+// message and exits with error code 1.
+void* callocb(size_t count, size_t size, const char* blame);
+
+
+// hash_bytes - Hashes `len` bytes starting at `data` (64-bit FNV-1a
+// followed by a final avalanche step).
+uint64_t hash_bytes(const void* data, size_t len);
+
+
+// mix64 - Scrambles a 64-bit word (the splitmix64 finalizer). Useful
+// for hashing integers and for combining hashes.
+uint64_t mix64(uint64_t x);
+
+
+// A small, fast pseudo-random number generator (xoshiro256**). Each
+// thread should use its own `struct rng`; they are not shared safely.
+struct rng
+{
+    uint64_t s[4];
+};
+
+// Seeds `rng` from `seed`. Different `stream` values give independent
+// sequences for the same seed (e.g., one per worker thread).
+void rng_seed(struct rng* rng, uint64_t seed, uint64_t stream);
+
+// Returns the next 64 random bits.
+uint64_t rng_next(struct rng* rng);
+
+// Returns a uniformly distributed value in [0, bound). `bound` must
+// be positive.
+uint64_t rng_below(struct rng* rng, uint64_t bound);
+
+// Returns a uniformly distributed double in [0, 1).
+double rng_unit(struct rng* rng);
+
+
+// The remaining helpers expose the (otherwise private) contents of
+// ballots and ballot boxes to the compact tabulation engines, which
+// need to copy them out. They are defined in ballot.c and ballot_box.c
+// rather than helpers.c, since only those files see the structs.
+
+// Returns the number of names on `ballot`, active or not.
+size_t ballot_length(ballot_t ballot);
+
+// Returns the `i`th name on `ballot`, which must be less than
+// `ballot_length(ballot)`.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `ballot`.
+const char* ballot_name(ballot_t ballot, size_t i);
+
+// Returns the ballot at the front of the non-empty ballot box `bb`,
+// i.e., the most recently inserted one.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `bb`.
+ballot_t bb_ballot(ballot_box_t bb);
+
+// Returns the rest of the non-empty ballot box `bb`, i.e., the ballots
+// inserted before `bb_ballot(bb)`.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `bb`.
+ballot_box_t bb_next(ballot_box_t bb);
@@ -0,0 +1,213 @@
+#include "ibox.h"
+#include "helpers.h"
+#include "pool.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+
+// Draws per `ibox_sample` task.
+#define TASK_DRAWS 4096
+
+// An `ibox_t` (defined in `ibox.h`) is a pointer to a heap-allocated
+// `struct ibox`:
+//
+//  - Ballot `i` of `cb` came from source `source[i]` at byte
+//    `offset[i]`; both arrays have room for `loc_cap` ballots.
+//
+//  - `slots` is an open-addressing hash table of `nslots` (a power of
+//    two, at least twice the number of ballots) entries, each 0 for
+//    empty or 1 + a ballot number, keyed by that ballot's location.
+//    Ballots with unknown offsets are not entered.
+struct ibox
+{
+    cbox_t    cb;
+
+    char**    names;
+    size_t    nsources;
+    size_t    source_cap;
+
+    uint32_t* source;
+    int64_t*  offset;
+    size_t    loc_cap;
+
+    size_t*   slots;
+    size_t    nslots;
+};
+
+ibox_t ibox_create(void)
+{
+    ibox_t ib = callocb(1, sizeof *ib, "ibox_create");
+    ib->cb     = cbox_create();
+    ib->nslots = 16;
+    ib->slots  = callocb(ib->nslots, sizeof *ib->slots, "ibox_create");
+    return ib;
+}
+
+void ibox_destroy(ibox_t ib)
+{
+    if (ib == NULL) {
+        return;
+    }
+
+    for (size_t s = 0; s < ib->nsources; ++s) {
+        free(ib->names[s]);
+    }
+    free(ib->names);
+    free(ib->source);
+    free(ib->offset);
+    free(ib->slots);
+    cbox_destroy(ib->cb);
+    free(ib);
+}
+
+static size_t slot_of(size_t source, int64_t offset)
+{
+    return (size_t) mix64((uint64_t) offset ^ mix64(source));
+}
+
+// Enters ballot `i` in the hash table, which has room for it.
+static void enter(ibox_t ib, size_t i)
+{
+    size_t mask = ib->nslots - 1;
+    size_t h    = slot_of(ib->source[i], ib->offset[i]) & mask;
+    while (ib->slots[h] != 0) {
+        h = (h + 1) & mask;
+    }
+    ib->slots[h] = i + 1;
+}
+
+// Grows the hash table to hold ballots `0 .. n` and enters them.
+static void grow_slots(ibox_t ib, size_t n)
+{
+    size_t nslots = ib->nslots;
+    while (2 * n > nslots) {
+        nslots *= 2;
+    }
+
+    free(ib->slots);
+    ib->nslots = nslots;
+    ib->slots  = callocb(nslots, sizeof *ib->slots, "ibox");
+    for (size_t i = 0; i < n; ++i) {
+        if (ib->offset[i] >= 0) {
+            enter(ib, i);
+        }
+    }
+}
+
+// Records that the ballot just read came from `source` at `offset`.
+static void add_location(ibox_t ib, size_t source, int64_t offset)
+{
+    size_t i = cbox_size(ib->cb) - 1;
+    if (i == ib->loc_cap) {
+        ib->loc_cap = ib->loc_cap ? 2 * ib->loc_cap : 64;
+        ib->source  = reallocb(ib->source,
+                               ib->loc_cap * sizeof *ib->source, "ibox");
+        ib->offset  = reallocb(ib->offset,
+                               ib->loc_cap * sizeof *ib->offset, "ibox");
+    }
+    ib->source[i] = (uint32_t) source;
+    ib->offset[i] = offset;
+
+    if (offset >= 0 && 2 * (i + 1) > ib->nslots) {
+        grow_slots(ib, i + 1);
+    } else if (offset >= 0) {
+        enter(ib, i);
+    }
+}
+
+size_t ibox_read(ibox_t ib, FILE* inf, const char* name)
+{
+    if (ib->nsources == ib->source_cap) {
+        ib->source_cap = ib->source_cap ? 2 * ib->source_cap : 4;
+        ib->names      = reallocb(ib->names,
+                                  ib->source_cap * sizeof *ib->names,
+                                  "ibox_read");
+    }
+    size_t source = ib->nsources;
+    ib->names[ib->nsources++] = strdupb(name, "ibox_read");
+
+    size_t count = 0;
+    for (;;) {
+        off_t at = ftello(inf);
+        if (!cbox_read_ballot(ib->cb, inf)) {
+            break;
+        }
+        add_location(ib, source, (int64_t) at);
+        ++count;
+    }
+    return count;
+}
+
+cbox_t ibox_cbox(ibox_t ib)
+{
+    return ib->cb;
+}
+
+size_t ibox_size(ibox_t ib)
+{
+    return cbox_size(ib->cb);
+}
+
+size_t ibox_sources(ibox_t ib)
+{
+    return ib->nsources;
+}
+
+const char* ibox_source_name(ibox_t ib, size_t source)
+{
+    return ib->names[source];
+}
+
+struct ibox_loc ibox_location(ibox_t ib, size_t i)
+{
+    return (struct ibox_loc) { ib->source[i], ib->offset[i] };
+}
+
+size_t ibox_find(ibox_t ib, size_t source, int64_t offset)
+{
+    size_t mask = ib->nslots - 1;
+    for (size_t h = slot_of(source, offset) & mask;
+         ib->slots[h] != 0;
+         h = (h + 1) & mask) {
+        size_t i = ib->slots[h] - 1;
+        if (ib->source[i] == source && ib->offset[i] == offset) {
+            return i;
+        }
+    }
+    return IBOX_NONE;
+}
+
+///
+/// SAMPLING
+///
+
+struct job
+{
+    size_t   nballots;
+    size_t   k;
+    uint64_t seed;
+    size_t*  out;
+};
+
+static void sample_task(void* ctx, size_t task, size_t worker)
+{
+    (void) worker;
+    struct job* job = ctx;
+    size_t from = task * TASK_DRAWS;
+    size_t to   = from + TASK_DRAWS < job->k ? from + TASK_DRAWS : job->k;
+
+    // Each draw gets its own stream, so it is the same whichever task
+    // (and however large a sample) it falls in.
+    for (size_t j = from; j < to; ++j) {
+        struct rng rng;
+        rng_seed(&rng, job->seed, j);
+        job->out[j] = (size_t) rng_below(&rng, job->nballots);
+    }
+}
+
+void ibox_sample(ibox_t ib, size_t k, uint64_t seed, size_t* out,
+                 size_t nworkers)
+{
+    struct job job = { ibox_size(ib), k, seed, out };
+    pool_run(nworkers, (k + TASK_DRAWS - 1) / TASK_DRAWS, sample_task, &job);
+}
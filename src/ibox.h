@@ -0,0 +1,102 @@
+#pragma once
+
+// An indexed ballot box, for audits that pull individual ballots.
+//
+// An `ibox_t` wraps a `cbox_t`, which already keeps its ballots in
+// input order with constant-time access by ballot number, and adds
+// where each ballot came from: the source it was read from and the
+// byte offset of its first line there. A hash table from (source,
+// offset) back to the ballot number makes the reverse lookup constant
+// time as well.
+//
+// `ibox_sample` draws a seeded sample of ballot numbers, as a
+// risk-limiting audit does. Draw `j` depends only on the seed and `j`,
+// so a sample can be drawn in parallel, extended later with more
+// draws, and reproduced by anyone with the seed and the ballot count.
+
+#include "cbox.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+
+typedef struct ibox* ibox_t;
+
+// Returned by `ibox_find` when no ballot starts at the given place.
+#define IBOX_NONE SIZE_MAX
+
+// Where a ballot came from: source number `source` (in the order the
+// sources were read) at byte `offset`, or -1 if the source could not
+// report offsets (e.g., a pipe).
+struct ibox_loc
+{
+    size_t  source;
+    int64_t offset;
+};
+
+// Creates an empty indexed ballot box.
+//
+// OWNERSHIP:
+//  - The caller owns the result and must free it with `ibox_destroy`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+ibox_t ibox_create(void);
+
+// Frees `ib` and its ballots. `ib` may be NULL.
+//
+// OWNERSHIP:
+//  - Takes ownership of `ib`.
+void ibox_destroy(ibox_t ib);
+
+// Reads ballots from `inf` to EOF, as `cbox_read` does, recording them
+// as coming from a new source named `name`. Returns the number of
+// ballots read. Offsets are taken with `ftello`, so they count from
+// wherever `inf` was positioned when opened.
+//
+// OWNERSHIP:
+//  - Borrows `inf` transiently and copies `name`.
+//
+// ERRORS:
+//  - Exits as `cbox_read` does.
+size_t ibox_read(ibox_t ib, FILE* inf, const char* name);
+
+// Returns the ballots, numbered in input order across all sources.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `ib`. The caller must not add ballots
+//    to it directly.
+cbox_t ibox_cbox(ibox_t ib);
+
+// Returns the number of ballots.
+size_t ibox_size(ibox_t ib);
+
+// Returns the number of sources read.
+size_t ibox_sources(ibox_t ib);
+
+// Returns the name of source number `source`.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `ib`.
+const char* ibox_source_name(ibox_t ib, size_t source);
+
+// Returns where ballot number `i` came from.
+struct ibox_loc ibox_location(ibox_t ib, size_t i);
+
+// Returns the number of the ballot that starts at byte `offset` of
+// source number `source`, or `IBOX_NONE` if there is none.
+size_t ibox_find(ibox_t ib, size_t source, int64_t offset);
+
+// Stores `k` ballot numbers, drawn uniformly and independently (that
+// is, with replacement) using `seed`, in `out[0 .. k)`, working on up
+// to `nworkers` threads (0 means `pool_default_workers()`). `ib` must
+// not be empty. The draws do not depend on `nworkers`, and the first
+// `k` draws of a larger sample with the same seed are the same.
+//
+// OWNERSHIP:
+//  - Borrows `ib` and `out` for the duration of the call.
+//
+// ERRORS:
+//  - Exits as `pool_run` does.
+void ibox_sample(ibox_t ib, size_t k, uint64_t seed, size_t* out,
+                 size_t nworkers);
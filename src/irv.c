@@ -1,19 +1,854 @@
 #include "ballot_box.h"
+#include "cbox.h"
+#include "ckpt.h"
+#include "colbox.h"
+#include "digest.h"
+#include "extbox.h"
+#include "groups.h"
+#include "helpers.h"
+#include "ibox.h"
+#include "margin.h"
+#include "packbox.h"
+#include "prof.h"
+#include "rounds.h"
+#include "server.h"
+#include "tabulate.h"
+
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-int main(int argc, char* argv[])
+// Which implementation counts the ballots (`--engine`).
+enum engine
+{
+    ENGINE_REFERENCE,   // read_ballot_box and get_irv_winner
+    ENGINE_PILE,        // cbox.h and tabulate.h
+    ENGINE_COLUMNAR,    // cbox.h and colbox.h
+    ENGINE_EXTERNAL,    // extbox.h, for boxes larger than memory
+    ENGINE_PACKED,      // packbox.h, for large boxes in little memory
+};
+
+// How many ballots the external and packed engines read into memory
+// before writing them out or packing them.
+#define EXTERNAL_BATCH 65536
+
+// Command-line options.
+struct options
+{
+    enum engine engine;
+    bool margin;
+    bool digest;
+    bool profile;
+    bool by_group;
+    bool rounds;
+    enum rounds_format rounds_format;
+    const char* serve;
+    const char* checkpoint;
+    const char* resume;
+    const char* append;
+    const char* publish;
+    const char* attach;
+    const char* unpublish;
+    size_t checkpoint_every;
+    size_t sample;
+    uint64_t seed;
+    char** files;
+    size_t nfiles;
+};
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+            "usage: %s [--engine reference|pile|columnar] [--margin]"
+            " [--digest] [--profile] [--rounds csv|json] < BALLOTS\n"
+            "       %s --engine external|packed [--digest] [--profile]"
+            " < BALLOTS\n"
+            "       %s --by-group [--engine pile] [--margin] [--digest]"
+            " [--profile] [--rounds csv|json] < BALLOTS\n"
+            "       %s --checkpoint FILE [--checkpoint-every N]"
+            " [--rounds csv|json] < BALLOTS\n"
+            "       %s --resume FILE [--rounds csv|json] [< BALLOTS]\n"
+            "       %s --append FILE [--rounds csv|json] < BALLOTS\n"
+            "       %s --publish NAME < BALLOTS\n"
+            "       %s --attach NAME [--margin] [--digest] [--profile]"
+            " [--rounds csv|json]\n"
+            "       %s --unpublish NAME\n"
+            "       %s --serve SOCKET\n"
+            "       %s --sample N [--seed S] [FILE ...] [< BALLOTS]\n",
+            prog, prog, prog, prog, prog, prog, prog, prog, prog, prog,
+            prog);
+    exit(2);
+}
+
+static void parse_options(int argc, char* argv[], struct options* opts)
+{
+    opts->engine = ENGINE_REFERENCE;
+    opts->margin = false;
+    opts->digest = false;
+    opts->profile = false;
+    opts->by_group = false;
+    opts->rounds  = false;
+    opts->rounds_format = ROUNDS_CSV;
+    opts->serve  = NULL;
+    opts->checkpoint = NULL;
+    opts->resume     = NULL;
+    opts->append     = NULL;
+    opts->publish    = NULL;
+    opts->attach     = NULL;
+    opts->unpublish  = NULL;
+    opts->checkpoint_every = 1000000;
+    opts->sample = 0;
+    opts->seed   = 0;
+    opts->files  = argv + argc;
+    opts->nfiles = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--margin") == 0) {
+            opts->margin = true;
+        } else if (strcmp(argv[i], "--digest") == 0) {
+            opts->digest = true;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            opts->profile = true;
+        } else if (strcmp(argv[i], "--by-group") == 0) {
+            opts->by_group = true;
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (strcmp(name, "reference") == 0) {
+                opts->engine = ENGINE_REFERENCE;
+            } else if (strcmp(name, "pile") == 0) {
+                opts->engine = ENGINE_PILE;
+            } else if (strcmp(name, "columnar") == 0) {
+                opts->engine = ENGINE_COLUMNAR;
+            } else if (strcmp(name, "external") == 0) {
+                opts->engine = ENGINE_EXTERNAL;
+            } else if (strcmp(name, "packed") == 0) {
+                opts->engine = ENGINE_PACKED;
+            } else {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            // The text format is the server's; the command line offers
+            // the two meant for other programs.
+            if (!rounds_parse_format(argv[++i], &opts->rounds_format) ||
+                    opts->rounds_format == ROUNDS_TEXT) {
+                usage(argv[0]);
+            }
+            opts->rounds = true;
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            opts->serve = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            opts->checkpoint = argv[++i];
+        } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            opts->resume = argv[++i];
+        } else if (strcmp(argv[i], "--append") == 0 && i + 1 < argc) {
+            opts->append = argv[++i];
+        } else if (strcmp(argv[i], "--publish") == 0 && i + 1 < argc) {
+            opts->publish = argv[++i];
+        } else if (strcmp(argv[i], "--attach") == 0 && i + 1 < argc) {
+            opts->attach = argv[++i];
+        } else if (strcmp(argv[i], "--unpublish") == 0 && i + 1 < argc) {
+            opts->unpublish = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 &&
+                   i + 1 < argc) {
+            char* end;
+            unsigned long long n = strtoull(argv[++i], &end, 10);
+            if (*end != 0 || n == 0) {
+                usage(argv[0]);
+            }
+            opts->checkpoint_every = (size_t) n;
+        } else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc) {
+            char* end;
+            unsigned long long n = strtoull(argv[++i], &end, 10);
+            if (*end != 0 || n == 0) {
+                usage(argv[0]);
+            }
+            opts->sample = (size_t) n;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            char* end;
+            opts->seed = strtoull(argv[++i], &end, 10);
+            if (*end != 0) {
+                usage(argv[0]);
+            }
+        } else if (argv[i][0] != '-' && opts->sample) {
+            // The remaining arguments are the files to sample from.
+            opts->files  = argv + i;
+            opts->nfiles = (size_t) (argc - i);
+            break;
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    // Attached counts use the pile tabulator, which keeps its state
+    // apart from the shared ballots.
+    bool shared = opts->publish || opts->attach || opts->unpublish;
+    if ((opts->publish != NULL) + (opts->attach != NULL) +
+            (opts->unpublish != NULL) > 1) {
+        usage(argv[0]);
+    }
+    if (shared && (opts->serve || opts->sample || opts->append ||
+                   opts->checkpoint || opts->resume || opts->by_group ||
+                   opts->engine == ENGINE_COLUMNAR ||
+                   opts->engine == ENGINE_EXTERNAL ||
+                   opts->engine == ENGINE_PACKED)) {
+        usage(argv[0]);
+    }
+    if ((opts->publish || opts->unpublish) &&
+            (opts->margin || opts->digest || opts->profile || opts->rounds)) {
+        usage(argv[0]);
+    }
+    if (opts->margin && (opts->engine == ENGINE_EXTERNAL ||
+                         opts->engine == ENGINE_PACKED)) {
+        usage(argv[0]);
+    }
+    // The server and checkpointed counts use their own tabulators and
+    // have no margins.
+    if ((opts->serve || opts->checkpoint || opts->resume ||
+         opts->append) &&
+            (opts->margin || opts->engine != ENGINE_REFERENCE)) {
+        usage(argv[0]);
+    }
+    if (opts->profile && (opts->serve || opts->sample || opts->append ||
+                          opts->checkpoint || opts->resume)) {
+        usage(argv[0]);
+    }
+    if (opts->by_group && (opts->serve || opts->sample || opts->append ||
+                           opts->checkpoint || opts->resume ||
+                           opts->engine == ENGINE_COLUMNAR ||
+                           opts->engine == ENGINE_EXTERNAL ||
+                           opts->engine == ENGINE_PACKED)) {
+        usage(argv[0]);
+    }
+    if (opts->rounds && (opts->serve || opts->sample ||
+                         opts->engine == ENGINE_COLUMNAR ||
+                         opts->engine == ENGINE_EXTERNAL ||
+                         opts->engine == ENGINE_PACKED)) {
+        usage(argv[0]);
+    }
+}
+
+// Prints the bounds on the margin of victory computed by margin.h.
+static void print_margin(const char* prog, cbox_t cb)
+{
+    struct margin m;
+
+    if (!margin_compute(cb, 0, &m)) {
+        fprintf(stderr, "%s: too many candidates for --margin (max %d)\n",
+                prog, MARGIN_MAX_CANDIDATES);
+        return;
+    }
+
+    if (m.upper == SIZE_MAX) {
+        if (m.lower == SIZE_MAX) {
+            printf("margin: none (no other candidate)\n");
+        } else {
+            printf("margin: at least %zu\n", m.lower);
+        }
+    } else if (m.lower == m.upper) {
+        printf("margin: %zu (challenger %s)\n",
+               m.upper, cbox_name(cb, m.challenger));
+    } else {
+        printf("margin: %zu to %zu (challenger %s)\n",
+               m.lower, m.upper, cbox_name(cb, m.challenger));
+    }
+}
+
+// Prints a ballot box digest (see digest.h).
+static void print_digest(const struct digest* d)
+{
+    char hex[DIGEST_HEX_LEN + 1];
+    digest_format(d, hex);
+    printf("digest: %s (%zu ballots)\n", hex, d->ballots);
+}
+
+// Reads the ballots on stdin into `cb`, noting their groups in `gs` if
+// it is non-NULL. For `--digest`, reads them `EXTERNAL_BATCH` at a time
+// and adds each batch to `d` while it is still in cache, as the
+// external and packed engines do, rather than making a second pass
+// over the whole box.
+static void read_ballots(const struct options* opts, cbox_t cb,
+                         groups_t gs, struct digest* d)
+{
+    digest_init(d);
+    if (!opts->digest) {
+        if (gs) {
+            groups_read(gs, cb, stdin);
+        } else {
+            cbox_read(cb, stdin);
+        }
+        return;
+    }
+
+    bool more = true;
+    while (more) {
+        size_t from = cbox_size(cb);
+        if (gs) {
+            more = groups_read_n(gs, cb, stdin, EXTERNAL_BATCH) ==
+                   EXTERNAL_BATCH;
+        } else {
+            while (cbox_size(cb) - from < EXTERNAL_BATCH &&
+                    (more = cbox_read_ballot(cb, stdin))) {
+                continue;
+            }
+        }
+        digest_add(d, cb, from, 0);
+    }
+}
+
+// Prints the digest of all of `cb`.
+static void print_cbox_digest(cbox_t cb)
+{
+    struct digest d;
+    digest_init(&d);
+    digest_add(&d, cb, 0, 0);
+    print_digest(&d);
+}
+
+// Prints the round table of the finished count in `tab` for
+// `--rounds`.
+static void print_rounds(const struct options* opts, cbox_t cb,
+                         tabulator_t tab)
+{
+    if (opts->rounds) {
+        rounds_write(stdout, cb, tab, opts->rounds_format);
+    }
+}
+
+// Counts the ballots on stdin with one of the compact engines. For
+// `--profile`, a compact engine's count is one phase.
+static int run_compact(const char* prog, const struct options* opts)
+{
+    cbox_t cb = cbox_create();
+    struct digest d;
+    prof_enter(PROF_INGEST);
+    read_ballots(opts, cb, NULL, &d);
+    prof_leave(PROF_INGEST);
+
+    cand_t winner;
+    tabulator_t tab = NULL;
+    prof_enter(PROF_COUNT);
+    if (opts->engine == ENGINE_COLUMNAR) {
+        colbox_t col = colbox_from_cbox(cb);
+        winner = colbox_run(col, NULL, NULL, NULL);
+        colbox_destroy(col);
+    } else {
+        tab    = tab_create();
+        winner = tab_run(tab, cb, NULL);
+    }
+    prof_leave(PROF_COUNT);
+
+    if (winner == CAND_NONE) {
+        fprintf(stderr, "%s: no votes, no winner\n", prog);
+        tab_destroy(tab);
+        cbox_destroy(cb);
+        return 1;
+    }
+
+    printf("%s\n", cbox_name(cb, winner));
+    if (opts->margin) {
+        print_margin(prog, cb);
+    }
+    if (opts->digest) {
+        print_digest(&d);
+    }
+    if (tab) {
+        print_rounds(opts, cb, tab);
+    }
+
+    tab_destroy(tab);
+    cbox_destroy(cb);
+    return 0;
+}
+
+// Counts the ballots on stdin with the pile engine, reading lines that
+// begin with '@' as group keys (see groups.h), and prints the round
+// table broken down by group after the winner and the other results.
+static int run_grouped(const char* prog, const struct options* opts)
+{
+    cbox_t cb   = cbox_create();
+    groups_t gs = groups_create();
+    struct digest d;
+    prof_enter(PROF_INGEST);
+    read_ballots(opts, cb, gs, &d);
+    prof_leave(PROF_INGEST);
+
+    tabulator_t tab = tab_create();
+    tab_set_groups(tab, groups_of(gs), groups_count(gs));
+    prof_enter(PROF_COUNT);
+    cand_t winner = tab_run(tab, cb, NULL);
+    prof_leave(PROF_COUNT);
+
+    int status = 0;
+    if (winner == CAND_NONE) {
+        fprintf(stderr, "%s: no votes, no winner\n", prog);
+        status = 1;
+    } else {
+        printf("%s\n", cbox_name(cb, winner));
+        if (opts->margin) {
+            print_margin(prog, cb);
+        }
+        if (opts->digest) {
+            print_digest(&d);
+        }
+        print_rounds(opts, cb, tab);
+        rounds_write_groups(stdout, cb, tab, gs);
+    }
+
+    tab_destroy(tab);
+    groups_destroy(gs);
+    cbox_destroy(cb);
+    return status;
+}
+
+// Checkpoints the ingest into `cb` so far to `path`: the first time
+// (if `*saved` is false), by writing the whole file, and after that by
+// adding only the new ballots to it.
+static bool checkpoint_ingest(const char* path, cbox_t cb, bool done,
+                              bool* saved)
+{
+    int64_t offset = (int64_t) ftello(stdin);
+    bool ok = *saved ? ckpt_append(path, cb, offset, done)
+                     : ckpt_save(path, cb, offset, done, NULL);
+    *saved = true;
+    return ok;
+}
+
+// Counts the ballots on stdin with the compact engine, checkpointing
+// to `opts->checkpoint` (or the file resumed from) every
+// `opts->checkpoint_every` ballots, after the whole input is read, and
+// after every round. With `opts->resume`, starts from that checkpoint:
+// if it was taken mid-ingest, stdin must be the same input, seekable,
+// and reading continues where it left off; otherwise stdin is not read
+// and the count continues from the saved round. Fails, without a
+// winner, if a checkpoint cannot be written.
+static int run_checkpointed(const char* prog, const struct options* opts)
+{
+    const char* path = opts->checkpoint ? opts->checkpoint : opts->resume;
+    ckpt_t ck        = NULL;
+    cbox_t cb;
+    bool ingest_done = false;
+    bool ok          = true;
+
+    if (opts->resume) {
+        ck = ckpt_open(opts->resume);
+        if (ck == NULL) {
+            return 1;
+        }
+        cb          = ckpt_cbox(ck);
+        ingest_done = ckpt_ingest_done(ck);
+
+        int64_t offset = ckpt_input_offset(ck);
+        if (!ingest_done &&
+                (offset < 0 || fseeko(stdin, (off_t) offset, SEEK_SET) != 0)) {
+            fprintf(stderr, "%s: cannot seek to byte %lld of the input "
+                    "to resume reading it\n", prog, (long long) offset);
+            ckpt_close(ck);
+            return 1;
+        }
+    } else {
+        cb = cbox_create();
+    }
+
+    if (!ingest_done) {
+        // A checkpoint resumed from holds the start of this ingest, so
+        // it can be added to.
+        bool   saved = ck != NULL && strcmp(path, opts->resume) == 0;
+        size_t since = 0;
+        while (ok && cbox_read_ballot(cb, stdin)) {
+            if (++since == opts->checkpoint_every) {
+                ok    = checkpoint_ingest(path, cb, false, &saved);
+                since = 0;
+            }
+        }
+        ok = ok && checkpoint_ingest(path, cb, true, &saved);
+    }
+
+    tabulator_t tab = tab_create();
+    if (ok && ck && ingest_done) {
+        ok = ckpt_resume_count(ck, tab);
+    } else if (ok) {
+        tab_start(tab, cb, NULL);
+    }
+
+    while (ok && tab_round(tab)) {
+        ok = ckpt_record_round(path, tab);
+    }
+
+    cand_t winner = ok ? tab_winner(tab) : CAND_NONE;
+    if (ok && winner == CAND_NONE) {
+        fprintf(stderr, "%s: no votes, no winner\n", prog);
+        ok = false;
+    } else if (ok) {
+        printf("%s\n", cbox_name(cb, winner));
+        if (opts->digest) {
+            print_cbox_digest(cb);
+        }
+        print_rounds(opts, cb, tab);
+    }
+
+    tab_destroy(tab);
+    if (ck) {
+        ckpt_close(ck);
+    } else {
+        cbox_destroy(cb);
+    }
+    return ok ? 0 : 1;
+}
+
+// Adds the ballots on stdin to the finished ingest saved in the
+// checkpoint at `opts->append`, counting only what they change (see
+// `tab_append`), and saves the result back there.
+static int run_append(const char* prog, const struct options* opts)
+{
+    const char* path = opts->append;
+    ckpt_t ck = ckpt_open(path);
+    if (ck == NULL) {
+        return 1;
+    }
+    if (!ckpt_ingest_done(ck)) {
+        fprintf(stderr, "%s: %s: ingest not finished; use --resume\n",
+                prog, path);
+        ckpt_close(ck);
+        return 1;
+    }
+
+    cbox_t cb       = ckpt_cbox(ck);
+    tabulator_t tab = tab_create();
+    bool ok         = ckpt_resume_count(ck, tab);
+    while (ok && tab_round(tab)) {
+        continue;
+    }
+
+    if (ok) {
+        cbox_read(cb, stdin);
+        tab_append(tab, cb);
+        while (tab_round(tab)) {
+            continue;
+        }
+        ok = ckpt_save(path, cb, -1, true, tab);
+    }
+
+    cand_t winner = tab_winner(tab);
+    if (ok && winner == CAND_NONE) {
+        fprintf(stderr, "%s: no votes, no winner\n", prog);
+        ok = false;
+    } else if (ok) {
+        printf("%s\n", cbox_name(cb, winner));
+        if (opts->digest) {
+            print_cbox_digest(cb);
+        }
+        print_rounds(opts, cb, tab);
+    }
+
+    tab_destroy(tab);
+    ckpt_close(ck);
+    return ok ? 0 : 1;
+}
+
+// Reads the ballots on stdin and publishes them as the shared memory
+// object `opts->publish` (see `ckpt_publish`).
+static int run_publish(const char* prog, const struct options* opts)
+{
+    cbox_t cb = cbox_create();
+    cbox_read(cb, stdin);
+    bool ok = ckpt_publish(opts->publish, cb);
+    if (ok) {
+        printf("%s: published %zu ballots as %s\n",
+               prog, cbox_size(cb), opts->publish);
+    }
+    cbox_destroy(cb);
+    return ok ? 0 : 1;
+}
+
+// Counts the ballots published as `opts->attach` with a tabulator of
+// its own. For `--profile`, attaching is the ingest phase.
+static int run_attach(const char* prog, const struct options* opts)
+{
+    prof_enter(PROF_INGEST);
+    ckpt_t ck = ckpt_attach(opts->attach);
+    prof_leave(PROF_INGEST);
+    if (ck == NULL) {
+        return 1;
+    }
+
+    cbox_t cb       = ckpt_cbox(ck);
+    tabulator_t tab = tab_create();
+    prof_enter(PROF_COUNT);
+    cand_t winner = tab_run(tab, cb, NULL);
+    prof_leave(PROF_COUNT);
+
+    int status = 0;
+    if (winner == CAND_NONE) {
+        fprintf(stderr, "%s: no votes, no winner\n", prog);
+        status = 1;
+    } else {
+        printf("%s\n", cbox_name(cb, winner));
+        if (opts->margin) {
+            print_margin(prog, cb);
+        }
+        if (opts->digest) {
+            // The publisher read the ballots, so there is no ingest
+            // here to hash them during.
+            print_cbox_digest(cb);
+        }
+        print_rounds(opts, cb, tab);
+    }
+
+    tab_destroy(tab);
+    ckpt_close(ck);
+    return status;
+}
+
+// Reads the ballots in `opts->files` (or on stdin, if none are given)
+// and prints `opts->sample` ballots drawn with `opts->seed`, one per
+// line: the draw number, the ballot number (both counting from 0), the
+// source and byte offset the ballot starts at, and its ranking. Offsets
+// are -1 for unseekable input.
+static int run_sample(const char* prog, const struct options* opts)
+{
+    ibox_t ib = ibox_create();
+    if (opts->nfiles == 0) {
+        ibox_read(ib, stdin, "-");
+    }
+    for (size_t f = 0; f < opts->nfiles; ++f) {
+        FILE* inf = fopen(opts->files[f], "r");
+        if (inf == NULL) {
+            perror(opts->files[f]);
+            ibox_destroy(ib);
+            return 1;
+        }
+        ibox_read(ib, inf, opts->files[f]);
+        fclose(inf);
+    }
+
+    if (ibox_size(ib) == 0) {
+        fprintf(stderr, "%s: no ballots to sample\n", prog);
+        ibox_destroy(ib);
+        return 1;
+    }
+
+    size_t* draws = mallocb(opts->sample * sizeof *draws, "run_sample");
+    ibox_sample(ib, opts->sample, opts->seed, draws, 0);
+
+    cbox_t cb = ibox_cbox(ib);
+    for (size_t j = 0; j < opts->sample; ++j) {
+        struct ibox_loc loc = ibox_location(ib, draws[j]);
+        printf("%zu\t%zu\t%s\t%lld\t", j, draws[j],
+               ibox_source_name(ib, loc.source), (long long) loc.offset);
+
+        size_t len;
+        const cand_t* ranks = cbox_ballot(cb, draws[j], &len);
+        for (size_t r = 0; r < len; ++r) {
+            printf("%s%s", r ? "," : "", cbox_name(cb, ranks[r]));
+        }
+        printf("\n");
+    }
+
+    free(draws);
+    ibox_destroy(ib);
+    return 0;
+}
+
+// Counts the ballots on stdin with the external engine, which holds
+// only `EXTERNAL_BATCH` ballots in memory at a time. Chunk files go in
+// `$TMPDIR`.
+static int run_external(const char* prog, const struct options* opts)
+{
+    extbox_t eb = extbox_create(NULL);
+    if (eb == NULL) {
+        return 1;
+    }
+
+    // Each batch is digested as it is written out.
+    struct digest d;
+    digest_init(&d);
+
+    cbox_t cb = cbox_create();
+    bool ok   = true;
+    bool more = true;
+    prof_enter(PROF_INGEST);
+    while (ok && more) {
+        cbox_clear(cb);
+        while (cbox_size(cb) < EXTERNAL_BATCH &&
+                (more = cbox_read_ballot(cb, stdin))) {
+            continue;
+        }
+        ok = extbox_append(eb, cb);
+        if (opts->digest) {
+            digest_add(&d, cb, 0, 0);
+        }
+    }
+    prof_leave(PROF_INGEST);
+
+    cand_t winner = CAND_NONE;
+    if (ok) {
+        prof_enter(PROF_COUNT);
+        winner = extbox_run(eb, cbox_candidates(cb), NULL, NULL, NULL);
+        prof_leave(PROF_COUNT);
+        if (winner == CAND_NONE) {
+            fprintf(stderr, "%s: no votes, no winner\n", prog);
+        } else {
+            printf("%s\n", cbox_name(cb, winner));
+            if (opts->digest) {
+                print_digest(&d);
+            }
+        }
+    }
+
+    cbox_destroy(cb);
+    extbox_destroy(eb);
+    return winner == CAND_NONE ? 1 : 0;
+}
+
+// Counts the ballots on stdin with the packed engine, which reads
+// `EXTERNAL_BATCH` ballots at a time into a `cbox_t` and packs them,
+// so that only the packed box grows with the input.
+static int run_packed(const char* prog, const struct options* opts)
 {
+    packbox_t pb = packbox_create();
+    struct digest d;
+    digest_init(&d);
+
+    cbox_t cb = cbox_create();
+    bool more = true;
+    prof_enter(PROF_INGEST);
+    while (more) {
+        cbox_clear(cb);
+        while (cbox_size(cb) < EXTERNAL_BATCH &&
+                (more = cbox_read_ballot(cb, stdin))) {
+            continue;
+        }
+        packbox_append(pb, cb);
+        if (opts->digest) {
+            digest_add(&d, cb, 0, 0);
+        }
+    }
+    prof_leave(PROF_INGEST);
+
+    prof_enter(PROF_COUNT);
+    cand_t winner = packbox_run(pb, NULL, NULL, NULL);
+    prof_leave(PROF_COUNT);
+    if (winner == CAND_NONE) {
+        fprintf(stderr, "%s: no votes, no winner\n", prog);
+    } else {
+        printf("%s\n", cbox_name(cb, winner));
+        if (opts->digest) {
+            print_digest(&d);
+        }
+    }
+
+    cbox_destroy(cb);
+    packbox_destroy(pb);
+    return winner == CAND_NONE ? 1 : 0;
+}
+
+// Counts the ballots on stdin with `read_ballot_box` and
+// `get_irv_winner`.
+static int run_reference(const char* prog, const struct options* opts)
+{
+    prof_enter(PROF_INGEST);
     ballot_box_t bb = read_ballot_box(stdin);
+    prof_leave(PROF_INGEST);
     char* winner    = get_irv_winner(bb);
 
     if (! winner) {
-        fprintf(stderr, "%s: no votes, no winner\n", argv[0]);
+        fprintf(stderr, "%s: no votes, no winner\n", prog);
         bb_destroy(bb);
-        exit(1);
+        return 1;
     }
 
     printf("%s\n", winner);
     free(winner);
+
+    // The reference count keeps no rounds, so `--rounds` tabulates a
+    // compact copy, which reaches the same result. `--digest` hashes
+    // the copy too, since the names are only interned in it.
+    if (opts->margin || opts->digest || opts->rounds) {
+        cbox_t cb = cbox_from_bb(bb);
+        if (opts->margin) {
+            print_margin(prog, cb);
+        }
+        if (opts->digest) {
+            print_cbox_digest(cb);
+        }
+        if (opts->rounds) {
+            tabulator_t tab = tab_create();
+            tab_run(tab, cb, NULL);
+            print_rounds(opts, cb, tab);
+            tab_destroy(tab);
+        }
+        cbox_destroy(cb);
+    }
+
     bb_destroy(bb);
+    return 0;
+}
+
+// Starts profiling for `--profile`, warning if only wall time can be
+// measured.
+static void start_profile(const char* prog)
+{
+    int why = 0;
+    if (prof_start(&why) == 0) {
+        fprintf(stderr, "%s: hardware counters unavailable (%s); "
+                "profiling wall time only\n", prog, strerror(why));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    struct options opts;
+    parse_options(argc, argv, &opts);
+
+    if (opts.serve) {
+        return server_run(opts.serve);
+    }
+
+    if (opts.sample) {
+        return run_sample(argv[0], &opts);
+    }
+
+    if (opts.append) {
+        return run_append(argv[0], &opts);
+    }
+
+    if (opts.publish) {
+        return run_publish(argv[0], &opts);
+    }
+
+    if (opts.unpublish) {
+        return ckpt_unpublish(opts.unpublish) ? 0 : 1;
+    }
+
+    if (opts.checkpoint || opts.resume) {
+        return run_checkpointed(argv[0], &opts);
+    }
+
+    if (opts.profile) {
+        start_profile(argv[0]);
+    }
+
+    int status;
+    if (opts.attach) {
+        status = run_attach(argv[0], &opts);
+    } else if (opts.by_group) {
+        status = run_grouped(argv[0], &opts);
+    } else if (opts.engine == ENGINE_EXTERNAL) {
+        status = run_external(argv[0], &opts);
+    } else if (opts.engine == ENGINE_PACKED) {
+        status = run_packed(argv[0], &opts);
+    } else if (opts.engine != ENGINE_REFERENCE) {
+        status = run_compact(argv[0], &opts);
+    } else {
+        status = run_reference(argv[0], &opts);
+    }
+
+    if (opts.profile) {
+        prof_stop();
+        fflush(stdout);
+        prof_report(stderr);
+    }
+    return status;
 }
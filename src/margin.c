@@ -0,0 +1,580 @@
+#include "margin.h"
+#include "helpers.h"
+#include "pool.h"
+#include "tabulate.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A set of candidates, one bit per candidate id.
+typedef uint64_t cmask_t;
+
+#define BIT(c) ((cmask_t) 1 << (c))
+
+// All the ballots with the same ranking are merged into one
+// "signature": `ranks[start .. start+len)` with a `weight` (how many
+// ballots) and `pos` (one more than the number of the last of them, for
+// tie-breaking as in tabulate.h). Real elections have far fewer
+// distinct rankings than ballots, and every tally below is a pass over
+// the signatures. The positions of all of a signature's ballots, in
+// the same form and in order, are `positions[first .. first+weight)`.
+struct sig
+{
+    size_t start;
+    size_t len;
+    size_t weight;
+    size_t pos;
+    size_t first;
+};
+
+// A memo entry for one set of remaining candidates. If `exact`, then
+// `value` is the cheapest cost from here; otherwise the cost is known
+// only to be at least `value`. Entries from earlier tasks (with another
+// `gen`) are empty.
+struct memo
+{
+    cmask_t  mask;
+    size_t   value;
+    uint32_t gen;
+    bool     exact;
+};
+
+// Per-worker scratch space, reused from task to task.
+struct worker
+{
+    struct memo* memo;
+    size_t       memo_cap;
+    size_t       memo_used;
+    uint32_t     gen;
+
+    size_t*      tally;    // one row of `ncand` per search depth
+    size_t*      cost;     // ditto
+    cand_t*      order;    // ditto
+
+    size_t*      weight;   // for checking manipulations
+    size_t*      pos;      // ditto
+    size_t*      counts;
+    size_t*      last;
+
+    size_t       nodes;
+};
+
+struct search
+{
+    cand_t*       ranks;
+    struct sig*   sigs;
+    size_t        nsigs;
+    size_t*       positions;
+    size_t        ncand;
+    cand_t        winner;
+
+    // The lowest lower bound any task has found so far (or, before any
+    // has, one more than the best upper bound).
+    _Atomic size_t best;
+
+    // Per candidate: the size of the verified manipulation (SIZE_MAX if
+    // none) with it as the challenger.
+    size_t*       upper;
+
+    struct worker* workers;
+};
+
+///
+/// SIGNATURES
+///
+
+// Merges the ballots of `cb` into signatures. Exhausted (empty) ballots
+// never count for anyone and are dropped.
+static void build_sigs(struct search* s, cbox_t cb)
+{
+    size_t n = cbox_size(cb);
+    s->ranks = mallocb((cbox_rank_count(cb) + 1) * sizeof *s->ranks,
+                       "margin_compute");
+    s->sigs  = mallocb((n + 1) * sizeof *s->sigs, "margin_compute");
+    s->nsigs = 0;
+
+    // The signature of each ballot, for listing their positions.
+    size_t* sig_of = mallocb((n + 1) * sizeof *sig_of, "margin_compute");
+
+    size_t cap = 64;
+    while (cap < 2 * n) {
+        cap *= 2;
+    }
+    size_t* table = mallocb(cap * sizeof *table, "margin_compute");
+    for (size_t i = 0; i < cap; ++i) {
+        table[i] = SIZE_MAX;
+    }
+
+    size_t used = 0;
+    for (size_t i = 0; i < n; ++i) {
+        size_t len;
+        const cand_t* ranks = cbox_ballot(cb, i, &len);
+        sig_of[i] = SIZE_MAX;
+        if (len == 0) {
+            continue;
+        }
+
+        size_t slot = hash_bytes(ranks, len * sizeof *ranks) & (cap - 1);
+        for (;;) {
+            size_t k = table[slot];
+            if (k == SIZE_MAX) {
+                memcpy(s->ranks + used, ranks, len * sizeof *ranks);
+                s->sigs[s->nsigs] = (struct sig) {
+                    .start = used, .len = len, .weight = 1, .pos = i + 1,
+                };
+                sig_of[i]   = s->nsigs;
+                table[slot] = s->nsigs++;
+                used += len;
+                break;
+            }
+            struct sig* sig = &s->sigs[k];
+            if (sig->len == len &&
+                    memcmp(s->ranks + sig->start, ranks,
+                           len * sizeof *ranks) == 0) {
+                ++sig->weight;
+                sig->pos  = i + 1;
+                sig_of[i] = k;
+                break;
+            }
+            slot = (slot + 1) & (cap - 1);
+        }
+    }
+
+    free(table);
+
+    size_t first = 0;
+    for (size_t k = 0; k < s->nsigs; ++k) {
+        s->sigs[k].first = first;
+        first += s->sigs[k].weight;
+    }
+    s->positions = mallocb((first + 1) * sizeof *s->positions,
+                           "margin_compute");
+    for (size_t i = 0; i < n; ++i) {
+        if (sig_of[i] != SIZE_MAX) {
+            struct sig* sig = &s->sigs[sig_of[i]];
+            s->positions[sig->first++] = i + 1;
+        }
+    }
+    for (size_t k = 0; k < s->nsigs; ++k) {
+        s->sigs[k].first -= s->sigs[k].weight;
+    }
+    free(sig_of);
+}
+
+// Counts each signature for its first candidate in `remaining`, into
+// `tally` (which has `ncand` elements), and returns the total.
+static size_t tally_sigs(const struct search* s, cmask_t remaining,
+                         size_t* tally)
+{
+    memset(tally, 0, s->ncand * sizeof *tally);
+    size_t total = 0;
+    for (size_t i = 0; i < s->nsigs; ++i) {
+        const cand_t* ranks = s->ranks + s->sigs[i].start;
+        for (size_t j = 0; j < s->sigs[i].len; ++j) {
+            if (remaining & BIT(ranks[j])) {
+                tally[ranks[j]] += s->sigs[i].weight;
+                total += s->sigs[i].weight;
+                break;
+            }
+        }
+    }
+    return total;
+}
+
+///
+/// LOWER BOUND
+///
+
+static struct memo* memo_slot(struct worker* w, cmask_t mask)
+{
+    size_t m    = w->memo_cap - 1;
+    size_t slot = mix64(mask) & m;
+    while (w->memo[slot].gen == w->gen && w->memo[slot].mask != mask) {
+        slot = (slot + 1) & m;
+    }
+    return &w->memo[slot];
+}
+
+static void memo_store(struct worker* w, cmask_t mask, size_t value,
+                       bool exact)
+{
+    if (2 * (w->memo_used + 1) > w->memo_cap) {
+        struct memo* old = w->memo;
+        size_t old_cap   = w->memo_cap;
+        w->memo_cap *= 2;
+        w->memo = callocb(w->memo_cap, sizeof *w->memo, "margin_compute");
+        for (size_t i = 0; i < old_cap; ++i) {
+            if (old[i].gen == w->gen) {
+                *memo_slot(w, old[i].mask) = old[i];
+            }
+        }
+        free(old);
+    }
+
+    struct memo* e = memo_slot(w, mask);
+    if (e->gen != w->gen) {
+        ++w->memo_used;
+        *e = (struct memo) { .mask = mask, .gen = w->gen };
+    } else if (e->exact || e->value >= value) {
+        return;
+    }
+    e->value = value;
+    e->exact = exact;
+}
+
+// The fewest changed ballots that could let candidate `c` be eliminated
+// from `remaining` given tallies `t`: for every other candidate `d`
+// with votes, either `c` falls to `d`'s level (each change moves the
+// gap by at most 2) or `d` loses all its votes (and so is skipped).
+static size_t elimination_cost(const struct search* s, cmask_t remaining,
+                               const size_t* t, cand_t c)
+{
+    size_t cost = 0;
+    for (size_t d = 0; d < s->ncand; ++d) {
+        if (d == c || !(remaining & BIT(d)) || t[c] <= t[d]) {
+            continue;
+        }
+        size_t gap = (t[c] - t[d] + 1) / 2;
+        size_t need = gap < t[d] ? gap : t[d];
+        if (need > cost) {
+            cost = need;
+        }
+    }
+    return cost;
+}
+
+// Returns the cheapest bound over all ways for the count to go from
+// `remaining` to a win for `target`, if that is less than `cap`;
+// otherwise returns some value of at least `cap`.
+static size_t solve(const struct search* s, struct worker* w,
+                    cand_t target, cmask_t remaining, size_t cap,
+                    size_t depth)
+{
+    ++w->nodes;
+    if (cap == 0) {
+        return 0;
+    }
+
+    struct memo* e = memo_slot(w, remaining);
+    if (e->gen == w->gen && (e->exact || e->value >= cap)) {
+        return e->value;
+    }
+
+    size_t* t     = w->tally + depth * s->ncand;
+    size_t* cost  = w->cost + depth * s->ncand;
+    cand_t* order = w->order + depth * s->ncand;
+    size_t total  = tally_sigs(s, remaining, t);
+
+    // Ending the count here needs a majority for `target`: each change
+    // closes the gap by 2 (taking a vote from a rival) or 1 (reviving
+    // an exhausted ballot).
+    size_t limit = cap;
+    if (total < 2 * t[target]) {
+        limit = 0;
+    } else {
+        size_t majority = (total - 2 * t[target]) / 2 + 1;
+        if (majority < limit) {
+            limit = majority;
+        }
+    }
+
+    // Otherwise nobody may have a majority yet (each change lowers a
+    // candidate's share by at most one vote), and some other candidate
+    // goes next; try cheap ones first.
+    size_t blocking = 0;
+    for (size_t c = 0; c < s->ncand; ++c) {
+        if ((remaining & BIT(c)) && 2 * t[c] > total) {
+            size_t k = (2 * t[c] - total + 1) / 2;
+            if (k > blocking) {
+                blocking = k;
+            }
+        }
+    }
+
+    size_t n = 0;
+    for (size_t c = 0; c < s->ncand && blocking < limit; ++c) {
+        if (c == target || !(remaining & BIT(c))) {
+            continue;
+        }
+        size_t k = elimination_cost(s, remaining, t, (cand_t) c);
+        if (k < blocking) {
+            k = blocking;
+        }
+        if (k >= limit) {
+            continue;
+        }
+        size_t j = n++;
+        while (j > 0 && cost[j - 1] > k) {
+            cost[j]  = cost[j - 1];
+            order[j] = order[j - 1];
+            --j;
+        }
+        cost[j]  = k;
+        order[j] = (cand_t) c;
+    }
+
+    for (size_t i = 0; i < n && cost[i] < limit; ++i) {
+        size_t sub = solve(s, w, target, remaining & ~BIT(order[i]),
+                           limit, depth + 1);
+        size_t v = sub > cost[i] ? sub : cost[i];
+        if (v < limit) {
+            limit = v;
+        }
+    }
+
+    memo_store(w, remaining, limit, limit < cap);
+    return limit;
+}
+
+///
+/// UPPER BOUND
+///
+
+// Tabulates the signatures with the given weights and last positions
+// (`w->weight` and `w->pos`), plus `extra`
+// ballots ranking only `challenger`, the last of them at position
+// `extra_pos`.
+static cand_t weighted_winner(const struct search* s, struct worker* w,
+                              cand_t challenger, size_t extra,
+                              size_t extra_pos)
+{
+    cmask_t out = 0;
+    for (;;) {
+        memset(w->counts, 0, s->ncand * sizeof *w->counts);
+        memset(w->last, 0, s->ncand * sizeof *w->last);
+        size_t total = 0;
+
+        for (size_t i = 0; i < s->nsigs; ++i) {
+            if (w->weight[i] == 0) {
+                continue;
+            }
+            const cand_t* ranks = s->ranks + s->sigs[i].start;
+            for (size_t j = 0; j < s->sigs[i].len; ++j) {
+                cand_t c = ranks[j];
+                if (!(out & BIT(c))) {
+                    w->counts[c] += w->weight[i];
+                    total        += w->weight[i];
+                    if (w->last[c] < w->pos[i]) {
+                        w->last[c] = w->pos[i];
+                    }
+                    break;
+                }
+            }
+        }
+
+        if (extra > 0 && !(out & BIT(challenger))) {
+            w->counts[challenger] += extra;
+            total                 += extra;
+            if (w->last[challenger] < extra_pos) {
+                w->last[challenger] = extra_pos;
+            }
+        }
+
+        cand_t leader = tab_pick_max(s->ncand, w->counts, w->last);
+        if (leader == CAND_NONE || 2 * w->counts[leader] > total) {
+            return leader;
+        }
+        out |= BIT(tab_pick_min(s->ncand, w->counts, w->last));
+    }
+}
+
+// Checks whether rewriting `k` of the ballots that rank the winner
+// first to rank only `challenger`, in place, changes the winner. The
+// rewritten ballots keep their positions for breaking ties, so the
+// latest ballots of each signature are taken first, which puts the
+// challenger's last ballot as late as this search can.
+static bool flips(const struct search* s, struct worker* w,
+                  cand_t challenger, size_t k)
+{
+    size_t left      = k;
+    size_t extra_pos = 0;
+    for (size_t i = 0; i < s->nsigs; ++i) {
+        const struct sig* sig = &s->sigs[i];
+        size_t weight = sig->weight;
+        w->pos[i] = sig->pos;
+        if (left > 0 && s->ranks[sig->start] == s->winner) {
+            size_t take = left < weight ? left : weight;
+            if (sig->pos > extra_pos) {
+                extra_pos = sig->pos;
+            }
+            weight -= take;
+            left   -= take;
+            if (weight > 0) {
+                w->pos[i] = s->positions[sig->first + weight - 1];
+            }
+        }
+        w->weight[i] = weight;
+    }
+
+    return weighted_winner(s, w, challenger, k, extra_pos) != s->winner;
+}
+
+// Finds a small verified manipulation in favor of `challenger`, by
+// binary search between 1 and rewriting all of the winner's first
+// choices. (The outcome need not be monotone in the number of changes,
+// so this finds *a* verified size, not necessarily the least.)
+static size_t find_upper(const struct search* s, struct worker* w,
+                         cand_t challenger)
+{
+    size_t hi = 0;
+    for (size_t i = 0; i < s->nsigs; ++i) {
+        if (s->ranks[s->sigs[i].start] == s->winner) {
+            hi += s->sigs[i].weight;
+        }
+    }
+
+    if (!flips(s, w, challenger, hi)) {
+        return SIZE_MAX;
+    }
+
+    size_t lo = 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (flips(s, w, challenger, mid)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return hi;
+}
+
+///
+/// DRIVER
+///
+
+// Task `task` of the first pass looks for a manipulation in favor of
+// the candidate with that id (skipping the winner).
+static void upper_task(void* ctx, size_t task, size_t worker)
+{
+    struct search* s = ctx;
+    cand_t target    = (cand_t) task;
+
+    s->upper[target] = target == s->winner
+        ? SIZE_MAX
+        : find_upper(s, &s->workers[worker], target);
+}
+
+// Task `task` of the second pass bounds the changes needed for the
+// candidate with that id to win. It starts from the best bound found
+// so far by any task, since only the smallest bound matters.
+static void lower_task(void* ctx, size_t task, size_t worker)
+{
+    struct search* s = ctx;
+    struct worker* w = &s->workers[worker];
+    cand_t target    = (cand_t) task;
+
+    if (target == s->winner) {
+        return;
+    }
+
+    // Fresh memo for this target; old entries become empty.
+    ++w->gen;
+    w->memo_used = 0;
+
+    cmask_t all = s->ncand == 64 ? ~(cmask_t) 0 : BIT(s->ncand) - 1;
+    size_t lower = solve(s, w, target, all, atomic_load(&s->best), 0);
+
+    size_t best = atomic_load(&s->best);
+    while (lower < best &&
+            !atomic_compare_exchange_weak(&s->best, &best, lower)) {
+        continue;
+    }
+}
+
+bool margin_compute(cbox_t cb, size_t nworkers, struct margin* result)
+{
+    size_t ncand = cbox_candidates(cb);
+    if (ncand > MARGIN_MAX_CANDIDATES) {
+        return false;
+    }
+
+    tabulator_t tab = tab_create();
+    cand_t winner   = tab_run(tab, cb, NULL);
+    tab_destroy(tab);
+
+    result->winner     = winner;
+    result->challenger = CAND_NONE;
+    result->nodes      = 0;
+    if (winner == CAND_NONE) {
+        result->lower = result->upper = 0;
+        return true;
+    }
+    if (ncand == 1) {
+        result->lower = result->upper = SIZE_MAX;
+        return true;
+    }
+
+    struct search s = {
+        .ncand  = ncand,
+        .winner = winner,
+        .upper  = mallocb(ncand * sizeof *s.upper, "margin_compute"),
+    };
+    build_sigs(&s, cb);
+
+    if (nworkers == 0) {
+        nworkers = pool_default_workers();
+    }
+    s.workers = mallocb(nworkers * sizeof *s.workers, "margin_compute");
+    size_t levels = ncand + 1;
+    for (size_t i = 0; i < nworkers; ++i) {
+        struct worker* w = &s.workers[i];
+        w->memo_cap  = 1024;
+        w->memo      = callocb(w->memo_cap, sizeof *w->memo,
+                               "margin_compute");
+        w->memo_used = 0;
+        w->gen       = 0;
+        w->tally  = mallocb(levels * ncand * sizeof *w->tally,
+                            "margin_compute");
+        w->cost   = mallocb(levels * ncand * sizeof *w->cost,
+                            "margin_compute");
+        w->order  = mallocb(levels * ncand * sizeof *w->order,
+                            "margin_compute");
+        w->weight = mallocb((s.nsigs + 1) * sizeof *w->weight,
+                            "margin_compute");
+        w->pos    = mallocb((s.nsigs + 1) * sizeof *w->pos,
+                            "margin_compute");
+        w->counts = mallocb(ncand * sizeof *w->counts, "margin_compute");
+        w->last   = mallocb(ncand * sizeof *w->last, "margin_compute");
+        w->nodes  = 0;
+    }
+
+    // The verified manipulations come first: the true margin is at most
+    // the smallest of them, so the lower-bound search can prune
+    // anything above it from the start.
+    pool_run(nworkers, ncand, upper_task, &s);
+
+    result->upper = SIZE_MAX;
+    for (size_t c = 0; c < ncand; ++c) {
+        if (s.upper[c] < result->upper) {
+            result->upper      = s.upper[c];
+            result->challenger = (cand_t) c;
+        }
+    }
+
+    atomic_init(&s.best, result->upper == SIZE_MAX
+                         ? SIZE_MAX : result->upper + 1);
+    pool_run(nworkers, ncand, lower_task, &s);
+    result->lower = atomic_load(&s.best);
+
+    for (size_t i = 0; i < nworkers; ++i) {
+        struct worker* w = &s.workers[i];
+        result->nodes += w->nodes;
+        free(w->memo);
+        free(w->tally);
+        free(w->cost);
+        free(w->order);
+        free(w->weight);
+        free(w->pos);
+        free(w->counts);
+        free(w->last);
+    }
+    free(s.workers);
+    free(s.upper);
+    free(s.sigs);
+    free(s.positions);
+    free(s.ranks);
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Margin of victory for IRV: the fewest ballots that would have to be
+// changed to change the winner.
+//
+// Computing the margin exactly is NP-hard in general, so this engine
+// brackets it:
+//
+//  - The lower bound is the best "elimination order" bound: for every
+//    possible alternative winner and every order in which the other
+//    candidates could be eliminated (or the count could end early with
+//    a majority), it bounds the changes needed to make each round come
+//    out that way, since changing one ballot moves each round's tallies
+//    by at most one vote apiece. The search runs over sets of remaining
+//    candidates, memoized by bitmask, with branch-and-bound pruning
+//    against the best bound found so far by any thread.
+//
+//  - The upper bound comes from a concrete manipulation (rewriting
+//    ballots that rank the winner first to rank only a challenger),
+//    which is tabulated to confirm that it really changes the winner.
+//
+// When the two agree the margin is exact.
+
+#include "cbox.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// The most candidates the search supports (one bit each in a mask).
+#define MARGIN_MAX_CANDIDATES 64
+
+struct margin
+{
+    // The actual winner, or CAND_NONE if there were no votes.
+    cand_t winner;
+
+    // Changing fewer than `lower` ballots cannot change the winner.
+    size_t lower;
+
+    // Changing `upper` ballots to rank only `challenger` was checked
+    // to change the winner. If no such change was found, `upper` is
+    // SIZE_MAX and `challenger` is CAND_NONE.
+    size_t upper;
+    cand_t challenger;
+
+    // The number of subproblems the lower-bound search examined.
+    size_t nodes;
+};
+
+// Computes bounds on the margin of victory of `cb`, using up to
+// `nworkers` threads (0 for the default; see pool.h), and stores them
+// in `*result`. If there were no votes, both bounds are 0; if there is
+// only one candidate, nobody else could win and both are SIZE_MAX.
+//
+// OWNERSHIP:
+//  - Borrows `cb` and `result` transiently.
+//
+// ERRORS:
+//  - Returns false, leaving `*result` unchanged, if `cb` has more than
+//    `MARGIN_MAX_CANDIDATES` candidates.
+//  - Exits with code 1 if memory cannot be allocated.
+bool margin_compute(cbox_t cb, size_t nworkers, struct margin* result);
@@ -0,0 +1,282 @@
+#include "packbox.h"
+#include "helpers.h"
+#include "tabulate.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A `packbox_t` (defined in `packbox.h`) is a pointer to a
+// heap-allocated `struct packbox`:
+//
+//  - The stream is bits `[0, nbits)` of `words`, bit `k` being bit
+//    `k % 64` of `words[k / 64]`. `words` has `word_cap` words, all
+//    zero past the stream, and always at least one whole word past
+//    the word holding bit `nbits`, so that a field can be read as two
+//    words without checking for the end.
+//
+//  - Each ballot is its length (`len_bits` bits), its cursor
+//    (`len_bits` bits), and its `len` rankings (`cand_bits` bits each).
+//    `len_bits` fits `depth`, the longest ballot, and `cand_bits` fits
+//    `ncand - 1`; either may be 0.
+//
+//  - During a count, a ballot whose cursor is its length is exhausted
+//    and counts for the slot `ncand`.
+struct packbox
+{
+    uint64_t* words;
+    size_t    word_cap;
+    size_t    nbits;
+
+    size_t    nballots;
+    size_t    nranks;
+    size_t    ncand;
+    size_t    depth;
+    unsigned  cand_bits;
+    unsigned  len_bits;
+};
+
+// Returns the number of bits needed to write `n`.
+static unsigned width(size_t n)
+{
+    unsigned w = 0;
+    while (w < 64 && (n >> w) != 0) {
+        ++w;
+    }
+    return w;
+}
+
+// Returns the `w`-bit field (`w` < 64) at bit `at` of `words`.
+static inline uint64_t get_field(const uint64_t* words, size_t at,
+                                 unsigned w)
+{
+    size_t   i = at / 64;
+    unsigned s = at % 64;
+    // The high part's shift, by 64 - s, is split so that it is never
+    // by 64.
+    uint64_t v = (words[i] >> s) | ((words[i + 1] << 1) << (63 - s));
+    return v & (((uint64_t) 1 << w) - 1);
+}
+
+// Sets the `w`-bit field (`w` < 64) at bit `at` of `words` to `v`.
+static inline void put_field(uint64_t* words, size_t at, unsigned w,
+                             uint64_t v)
+{
+    size_t   i    = at / 64;
+    unsigned s    = at % 64;
+    uint64_t mask = ((uint64_t) 1 << w) - 1;
+    // As in `get_field`, the high part's shift is split.
+    words[i]     = (words[i] & ~(mask << s)) | (v << s);
+    words[i + 1] = (words[i + 1] & ~((mask >> 1) >> (63 - s))) |
+                   ((v >> 1) >> (63 - s));
+}
+
+packbox_t packbox_create(void)
+{
+    packbox_t pb = callocb(1, sizeof *pb, "packbox_create");
+    pb->word_cap = 2;
+    pb->words    = callocb(pb->word_cap, sizeof *pb->words,
+                           "packbox_create");
+    return pb;
+}
+
+void packbox_destroy(packbox_t pb)
+{
+    if (pb == NULL) {
+        return;
+    }
+
+    free(pb->words);
+    free(pb);
+}
+
+size_t packbox_size(packbox_t pb)
+{
+    return pb->nballots;
+}
+
+size_t packbox_candidates(packbox_t pb)
+{
+    return pb->ncand;
+}
+
+size_t packbox_bits(packbox_t pb)
+{
+    return pb->nbits;
+}
+
+// Makes room in `pb->words` for a stream of `nbits` bits.
+static void reserve(packbox_t pb, size_t nbits)
+{
+    size_t need = nbits / 64 + 2;
+    if (need <= pb->word_cap) {
+        return;
+    }
+
+    size_t cap = 2 * pb->word_cap;
+    if (cap < need) {
+        cap = need;
+    }
+    pb->words = reallocb(pb->words, cap * sizeof *pb->words,
+                         "packbox_append");
+    memset(pb->words + pb->word_cap, 0,
+           (cap - pb->word_cap) * sizeof *pb->words);
+    pb->word_cap = cap;
+}
+
+// Rewrites the stream with fields `cand_bits` and `len_bits` wide, no
+// narrower than the current ones. Cursors are not kept.
+static void repack(packbox_t pb, unsigned cand_bits, unsigned len_bits)
+{
+    size_t nbits = pb->nballots * 2 * len_bits + pb->nranks * cand_bits;
+    size_t cap   = nbits / 64 + 2;
+    uint64_t* words = callocb(cap, sizeof *words, "packbox_append");
+
+    size_t from = 0, to = 0;
+    for (size_t i = 0; i < pb->nballots; ++i) {
+        size_t len = get_field(pb->words, from, pb->len_bits);
+        put_field(words, to, len_bits, len);
+        from += 2 * pb->len_bits;
+        to   += 2 * len_bits;
+        for (size_t r = 0; r < len; ++r) {
+            put_field(words, to, cand_bits,
+                      get_field(pb->words, from, pb->cand_bits));
+            from += pb->cand_bits;
+            to   += cand_bits;
+        }
+    }
+
+    free(pb->words);
+    pb->words     = words;
+    pb->word_cap  = cap;
+    pb->nbits     = nbits;
+    pb->cand_bits = cand_bits;
+    pb->len_bits  = len_bits;
+}
+
+void packbox_append(packbox_t pb, cbox_t cb)
+{
+    size_t nballots = cbox_size(cb);
+    size_t ncand    = cbox_candidates(cb);
+    size_t depth    = pb->depth;
+    for (size_t i = 0; i < nballots; ++i) {
+        size_t len;
+        cbox_ballot(cb, i, &len);
+        if (len > depth) {
+            depth = len;
+        }
+    }
+
+    if (ncand > pb->ncand) {
+        pb->ncand = ncand;
+    }
+    pb->depth = depth;
+
+    unsigned cand_bits = width(pb->ncand > 0 ? pb->ncand - 1 : 0);
+    unsigned len_bits  = width(depth);
+    if (cand_bits > pb->cand_bits || len_bits > pb->len_bits) {
+        repack(pb, cand_bits, len_bits);
+    }
+
+    size_t nranks = cbox_rank_count(cb);
+    reserve(pb, pb->nbits + nballots * 2 * len_bits + nranks * cand_bits);
+
+    size_t at = pb->nbits;
+    for (size_t i = 0; i < nballots; ++i) {
+        size_t len;
+        const cand_t* ranks = cbox_ballot(cb, i, &len);
+        put_field(pb->words, at, len_bits, len);
+        at += 2 * len_bits;
+        for (size_t r = 0; r < len; ++r) {
+            put_field(pb->words, at, cand_bits, ranks[r]);
+            at += cand_bits;
+        }
+    }
+
+    pb->nbits     = at;
+    pb->nballots += nballots;
+    pb->nranks   += nranks;
+}
+
+// One round's pass: finds each ballot's leader, the first candidate
+// at or after its cursor who is not out, moving the cursor there, and
+// sets `counts` and `last` for the continuing candidates. On the first
+// pass (`fresh`), cursors are taken to be 0. Returns the number of
+// continuing ballots.
+static size_t count_round(packbox_t pb, const bool* out, bool fresh,
+                          size_t* counts, size_t* last)
+{
+    size_t ncand = pb->ncand;
+    memset(counts, 0, (ncand + 1) * sizeof *counts);
+    memset(last, 0, (ncand + 1) * sizeof *last);
+
+    uint64_t* words = pb->words;
+    unsigned  cw    = pb->cand_bits;
+    unsigned  lw    = pb->len_bits;
+    uint64_t  lmask = ((uint64_t) 1 << lw) - 1;
+    size_t    at    = 0;
+    for (size_t i = 0; i < pb->nballots; ++i) {
+        uint64_t head = get_field(words, at, 2 * lw);
+        size_t   len  = head & lmask;
+        size_t   was  = fresh ? SIZE_MAX : head >> lw;
+        size_t   pos  = fresh ? 0 : was;
+        size_t   base = at + 2 * lw;
+
+        size_t c = pos < len ? get_field(words, base + pos * cw, cw) : ncand;
+        while (out[c]) {
+            ++pos;
+            c = pos < len ? get_field(words, base + pos * cw, cw) : ncand;
+        }
+        if (pos != was) {
+            put_field(words, at + lw, lw, pos);
+        }
+
+        ++counts[c];
+        last[c] = i + 1;
+        at = base + len * cw;
+    }
+
+    size_t total = 0;
+    for (size_t c = 0; c < ncand; ++c) {
+        total += counts[c];
+    }
+    return total;
+}
+
+cand_t packbox_run(packbox_t pb, const bool* withdrawn,
+                   cand_t* order, size_t* neliminated)
+{
+    size_t ncand   = pb->ncand;
+    bool*   out    = mallocb((ncand + 1) * sizeof *out, "packbox_run");
+    size_t* counts = mallocb((ncand + 1) * sizeof *counts, "packbox_run");
+    size_t* last   = mallocb((ncand + 1) * sizeof *last, "packbox_run");
+    for (size_t c = 0; c < ncand; ++c) {
+        out[c] = withdrawn ? withdrawn[c] : false;
+    }
+    out[ncand] = false;
+
+    size_t k = 0;
+    cand_t winner;
+    for (;;) {
+        size_t total = count_round(pb, out, k == 0, counts, last);
+        winner = tab_pick_max(ncand, counts, last);
+        if (winner == CAND_NONE || 2 * counts[winner] > total) {
+            break;
+        }
+
+        cand_t loser = tab_pick_min(ncand, counts, last);
+        out[loser] = true;
+        if (order) {
+            order[k] = loser;
+        }
+        ++k;
+    }
+
+    if (neliminated) {
+        *neliminated = k;
+    }
+    free(out);
+    free(counts);
+    free(last);
+    return winner;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+// A bit-packed ballot box and the IRV count over it.
+//
+// A `packbox_t` holds ballots as one stream of bits. Each ballot is a
+// header of two fields, its length and the rank it is currently
+// counting at (its cursor), followed by its rankings. A ranking takes
+// just enough bits for the largest candidate id, and a header field
+// just enough for the longest ballot; with five candidates a full
+// ballot is 21 bits, where a `cbox_t` spends 18 bytes. The widths
+// grow, and the stream is repacked, when appended ballots need it.
+//
+// Ballots are not padded to a common length, so the box can only be
+// walked in order; that is all a round of the count needs. Each round
+// is one pass over the stream: read a ballot's header and the ranking
+// at its cursor with a couple of shifts and masks, and only if that
+// candidate is out, step the cursor down the ballot and write it back.
+// A round reads only the stream and a per-candidate table, so a box
+// of tens of millions of ballots fits in a few hundred megabytes and
+// is read at memory bandwidth.
+//
+// Results match `tab_run`, and so `get_irv_winner`.
+
+#include "cbox.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct packbox* packbox_t;
+
+// Creates an empty packed box.
+//
+// OWNERSHIP:
+//  - The caller owns the result and must free it with
+//    `packbox_destroy`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+packbox_t packbox_create(void);
+
+// Frees `pb`. `pb` may be NULL.
+//
+// OWNERSHIP:
+//  - Takes ownership of `pb`.
+void packbox_destroy(packbox_t pb);
+
+// Appends the ballots of `cb` to `pb`. Candidate ids are `cb`'s, so
+// successive batches must be read into the same `cbox_t` (cleared with
+// `cbox_clear` in between) or into boxes with the same candidates.
+//
+// OWNERSHIP:
+//  - Borrows `cb` transiently; `pb` does not refer to it.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+void packbox_append(packbox_t pb, cbox_t cb);
+
+// Returns the number of ballots.
+size_t packbox_size(packbox_t pb);
+
+// Returns the number of candidates: the most of any box appended.
+size_t packbox_candidates(packbox_t pb);
+
+// Returns the number of bits the ballots take up, headers included.
+size_t packbox_bits(packbox_t pb);
+
+// Counts `pb` to the end and returns the winner, or `CAND_NONE` if no
+// ballot ranks anyone. `withdrawn` is as for `tab_start`. If `order` is
+// non-NULL, it has room for `packbox_candidates(pb)` ids and receives
+// the eliminated candidates in order; their number is stored in
+// `*neliminated` if that is non-NULL.
+//
+// The cursors live in the stream, so only one count of a given
+// `packbox_t` may run at a time.
+//
+// OWNERSHIP:
+//  - Borrows `withdrawn` transiently.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+cand_t packbox_run(packbox_t pb, const bool* withdrawn,
+                   cand_t* order, size_t* neliminated);
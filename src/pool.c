@@ -0,0 +1,170 @@
+#include "pool.h"
+#include "helpers.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Each worker owns the range of task numbers `lo .. hi`, protected by
+// `lock`. The owner takes from `lo`; thieves take from `hi`.
+struct range
+{
+    pthread_mutex_t lock;
+    size_t lo;
+    size_t hi;
+};
+
+struct pool
+{
+    struct range*  ranges;
+    size_t         nworkers;
+    pool_task_fn*  fn;
+    void*          ctx;
+};
+
+struct worker
+{
+    struct pool* pool;
+    size_t       id;
+};
+
+// Takes the next task from the worker's own range, if any.
+static bool take_own(struct range* r, size_t* task)
+{
+    bool found = false;
+    pthread_mutex_lock(&r->lock);
+    if (r->lo < r->hi) {
+        *task = r->lo++;
+        found = true;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return found;
+}
+
+// Moves the back half of the fullest other range into worker `self`'s
+// (empty) range. Returns false if every range is empty.
+static bool steal(struct pool* pool, size_t self)
+{
+    for (;;) {
+        size_t victim = self;
+        size_t most   = 0;
+        for (size_t w = 0; w < pool->nworkers; ++w) {
+            if (w == self) {
+                continue;
+            }
+            struct range* r = &pool->ranges[w];
+            pthread_mutex_lock(&r->lock);
+            size_t size = r->hi - r->lo;
+            pthread_mutex_unlock(&r->lock);
+            if (size > most) {
+                victim = w;
+                most   = size;
+            }
+        }
+        if (victim == self) {
+            return false;
+        }
+
+        struct range* v = &pool->ranges[victim];
+        size_t lo = 0, hi = 0;
+        pthread_mutex_lock(&v->lock);
+        if (v->lo < v->hi) {
+            hi = v->hi;
+            lo = v->lo + (v->hi - v->lo) / 2;
+            v->hi = lo;
+        }
+        pthread_mutex_unlock(&v->lock);
+
+        if (lo < hi) {
+            struct range* r = &pool->ranges[self];
+            pthread_mutex_lock(&r->lock);
+            r->lo = lo;
+            r->hi = hi;
+            pthread_mutex_unlock(&r->lock);
+            return true;
+        }
+    }
+}
+
+static void* work(void* arg)
+{
+    struct worker* me  = arg;
+    struct pool*  pool = me->pool;
+    size_t task;
+
+    do {
+        while (take_own(&pool->ranges[me->id], &task)) {
+            pool->fn(pool->ctx, task, me->id);
+        }
+    } while (steal(pool, me->id));
+
+    return NULL;
+}
+
+void pool_run(size_t nworkers, size_t ntasks, pool_task_fn* fn, void* ctx)
+{
+    if (nworkers == 0) {
+        nworkers = pool_default_workers();
+    }
+    if (nworkers > ntasks) {
+        nworkers = ntasks;
+    }
+    if (nworkers <= 1) {
+        for (size_t task = 0; task < ntasks; ++task) {
+            fn(ctx, task, 0);
+        }
+        return;
+    }
+
+    struct pool pool = {
+        .ranges   = mallocb(nworkers * sizeof *pool.ranges, "pool_run"),
+        .nworkers = nworkers,
+        .fn       = fn,
+        .ctx      = ctx,
+    };
+    struct worker* workers = mallocb(nworkers * sizeof *workers,
+                                     "pool_run");
+    pthread_t* threads = mallocb(nworkers * sizeof *threads, "pool_run");
+
+    for (size_t w = 0; w < nworkers; ++w) {
+        pthread_mutex_init(&pool.ranges[w].lock, NULL);
+        pool.ranges[w].lo = ntasks * w / nworkers;
+        pool.ranges[w].hi = ntasks * (w + 1) / nworkers;
+        workers[w].pool = &pool;
+        workers[w].id   = w;
+    }
+
+    for (size_t w = 1; w < nworkers; ++w) {
+        if (pthread_create(&threads[w], NULL, work, &workers[w]) != 0) {
+            perror("pool_run");
+            exit(1);
+        }
+    }
+    work(&workers[0]);
+    for (size_t w = 1; w < nworkers; ++w) {
+        pthread_join(threads[w], NULL);
+    }
+
+    for (size_t w = 0; w < nworkers; ++w) {
+        pthread_mutex_destroy(&pool.ranges[w].lock);
+    }
+    free(threads);
+    free(workers);
+    free(pool.ranges);
+}
+
+size_t pool_default_workers(void)
+{
+    const char* env = getenv("IRV_THREADS");
+    if (env != NULL) {
+        long n = strtol(env, NULL, 10);
+        if (n > 0) {
+            return (size_t) n;
+        }
+    }
+
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t) n : 1;
+}
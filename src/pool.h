@@ -0,0 +1,34 @@
+#pragma once
+
+// A minimal fork-join scheduler for running independent tasks on
+// several threads.
+//
+// `pool_run` splits the task numbers `0 .. ntasks` evenly among the
+// workers. Each worker takes tasks from the front of its own range;
+// a worker whose range is empty steals the back half of the largest
+// remaining range, so uneven tasks still keep every core busy.
+
+#include <stddef.h>
+
+// A task function. `task` is the task number and `worker` is the
+// number (less than the `nworkers` passed to `pool_run`) of the worker
+// running it, which the task can use to index per-worker scratch
+// space. `ctx` is passed through unchanged.
+typedef void pool_task_fn(void* ctx, size_t task, size_t worker);
+
+// Runs `fn(ctx, task, worker)` once for every `task < ntasks`, using up
+// to `nworkers` threads (including the calling thread), and returns
+// when all tasks have finished. If `nworkers` is 0, uses
+// `pool_default_workers()`.
+//
+// OWNERSHIP:
+//  - `ctx` is borrowed for the duration of the call.
+//
+// ERRORS:
+//  - Exits with code 1 if threads or memory cannot be allocated.
+void pool_run(size_t nworkers, size_t ntasks, pool_task_fn* fn, void* ctx);
+
+// Returns the number of workers to use by default: the value of the
+// `IRV_THREADS` environment variable if it is set to a positive number,
+// otherwise the number of online processors.
+size_t pool_default_workers(void);
@@ -0,0 +1,258 @@
+#include "prof.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+// What reading a counter returns (with PERF_FORMAT_TOTAL_TIME_ENABLED
+// and PERF_FORMAT_TOTAL_TIME_RUNNING): its value, and how long it has
+// been enabled and actually counting, in nanoseconds. Differences of
+// readings are added up the same way.
+struct reading
+{
+    uint64_t value;
+    uint64_t enabled;
+    uint64_t running;
+};
+
+struct totals
+{
+    uint64_t       calls;
+    uint64_t       nanos;
+    struct reading counters[PROF_NCOUNTERS];
+};
+
+// The profiler's state. `fds[k]` is counter `k`'s file descriptor, or
+// -1 if it is not open; `available[k]` says whether it was opened by
+// the last `prof_start`. `at` and `at_nanos` are the readings taken by
+// the last `prof_enter`, and `open` is the phase it entered, until
+// `prof_leave` (and otherwise PROF_NPHASES).
+static struct
+{
+    bool           enabled;
+    int            fds[PROF_NCOUNTERS];
+    bool           available[PROF_NCOUNTERS];
+    struct totals  phases[PROF_NPHASES];
+    struct reading at[PROF_NCOUNTERS];
+    uint64_t       at_nanos;
+    enum prof_phase open;
+} prof = {
+    .fds  = { -1, -1, -1, -1 },
+    .open = PROF_NPHASES,
+};
+
+static const char* const phase_names[PROF_NPHASES] = {
+    [PROF_INGEST]    = "ingest",
+    [PROF_COUNT]     = "count",
+    [PROF_ELIMINATE] = "eliminate",
+    [PROF_SELECT]    = "select",
+};
+
+// Opens the counter for `counter`, or returns -1 and sets `errno`.
+static int open_counter(enum prof_counter counter)
+{
+#ifdef __linux__
+    static const uint64_t configs[PROF_NCOUNTERS] = {
+        [PROF_CYCLES]        = PERF_COUNT_HW_CPU_CYCLES,
+        [PROF_INSTRUCTIONS]  = PERF_COUNT_HW_INSTRUCTIONS,
+        [PROF_CACHE_MISSES]  = PERF_COUNT_HW_CACHE_MISSES,
+        [PROF_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES,
+    };
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size           = sizeof attr;
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = configs[counter];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.inherit        = 1;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                          PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void) counter;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static uint64_t now_nanos(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+// Reads every open counter into `out`; counters that cannot be read
+// are left as they were.
+static void read_counters(struct reading out[PROF_NCOUNTERS])
+{
+    for (size_t k = 0; k < PROF_NCOUNTERS; ++k) {
+        struct reading r;
+        if (prof.fds[k] >= 0 &&
+                read(prof.fds[k], &r, sizeof r) == (ssize_t) sizeof r) {
+            out[k] = r;
+        }
+    }
+}
+
+size_t prof_start(int* why)
+{
+    prof_stop();
+    memset(prof.phases, 0, sizeof prof.phases);
+    memset(prof.at, 0, sizeof prof.at);
+    prof.open = PROF_NPHASES;
+
+    size_t opened = 0;
+    int first_error = 0;
+    for (size_t k = 0; k < PROF_NCOUNTERS; ++k) {
+        prof.fds[k] = open_counter((enum prof_counter) k);
+        prof.available[k] = prof.fds[k] >= 0;
+        if (prof.available[k]) {
+            ++opened;
+        } else if (first_error == 0) {
+            first_error = errno;
+        }
+    }
+
+    if (opened == 0 && why) {
+        *why = first_error;
+    }
+    prof.enabled = true;
+    return opened;
+}
+
+void prof_stop(void)
+{
+    prof.enabled = false;
+    for (size_t k = 0; k < PROF_NCOUNTERS; ++k) {
+        if (prof.fds[k] >= 0) {
+            close(prof.fds[k]);
+            prof.fds[k] = -1;
+        }
+    }
+}
+
+void prof_enter(enum prof_phase phase)
+{
+    if (!prof.enabled) {
+        return;
+    }
+
+    // Phases must not nest.
+    assert(prof.open == PROF_NPHASES);
+    prof.open = phase;
+
+    read_counters(prof.at);
+    prof.at_nanos = now_nanos();
+}
+
+void prof_leave(enum prof_phase phase)
+{
+    if (!prof.enabled) {
+        return;
+    }
+
+    assert(prof.open == phase);
+    prof.open = PROF_NPHASES;
+
+    uint64_t nanos = now_nanos();
+    struct reading now[PROF_NCOUNTERS];
+    memcpy(now, prof.at, sizeof now);
+    read_counters(now);
+
+    struct totals* t = &prof.phases[phase];
+    ++t->calls;
+    t->nanos += nanos - prof.at_nanos;
+    for (size_t k = 0; k < PROF_NCOUNTERS; ++k) {
+        t->counters[k].value   += now[k].value - prof.at[k].value;
+        t->counters[k].enabled += now[k].enabled - prof.at[k].enabled;
+        t->counters[k].running += now[k].running - prof.at[k].running;
+    }
+}
+
+uint64_t prof_calls(enum prof_phase phase)
+{
+    return prof.phases[phase].calls;
+}
+
+uint64_t prof_nanos(enum prof_phase phase)
+{
+    return prof.phases[phase].nanos;
+}
+
+bool prof_value(enum prof_phase phase, enum prof_counter counter,
+                uint64_t* value)
+{
+    const struct reading* r = &prof.phases[phase].counters[counter];
+    if (!prof.available[counter] || (r->running == 0 && r->enabled > 0)) {
+        return false;
+    }
+
+    // Scale up for the time the kernel had the counter switched out.
+    if (r->running < r->enabled) {
+        *value = (uint64_t) ((double) r->value * r->enabled / r->running);
+    } else {
+        *value = r->value;
+    }
+    return true;
+}
+
+const char* prof_phase_name(enum prof_phase phase)
+{
+    return phase_names[phase];
+}
+
+// Prints `counter` for `phase` in a column of `width`, or "n/a".
+static void print_value(FILE* outf, enum prof_phase phase,
+                        enum prof_counter counter, int width)
+{
+    uint64_t value;
+    if (prof_value(phase, counter, &value)) {
+        fprintf(outf, " %*llu", width, (unsigned long long) value);
+    } else {
+        fprintf(outf, " %*s", width, "n/a");
+    }
+}
+
+void prof_report(FILE* outf)
+{
+    fprintf(outf, "%-10s %6s %10s %14s %14s %6s %12s %12s\n",
+            "phase", "calls", "ms", "cycles", "instructions", "IPC",
+            "cache-miss", "branch-miss");
+
+    for (size_t p = 0; p < PROF_NPHASES; ++p) {
+        enum prof_phase phase = (enum prof_phase) p;
+        const struct totals* t = &prof.phases[p];
+        if (t->calls == 0) {
+            continue;
+        }
+
+        fprintf(outf, "%-10s %6llu %10.3f", phase_names[p],
+                (unsigned long long) t->calls, t->nanos / 1e6);
+        print_value(outf, phase, PROF_CYCLES, 14);
+        print_value(outf, phase, PROF_INSTRUCTIONS, 14);
+
+        uint64_t cycles, instructions;
+        if (prof_value(phase, PROF_CYCLES, &cycles) &&
+                prof_value(phase, PROF_INSTRUCTIONS, &instructions) &&
+                cycles > 0) {
+            fprintf(outf, " %6.2f", (double) instructions / cycles);
+        } else {
+            fprintf(outf, " %6s", "n/a");
+        }
+
+        print_value(outf, phase, PROF_CACHE_MISSES, 12);
+        print_value(outf, phase, PROF_BRANCH_MISSES, 12);
+        fprintf(outf, "\n");
+    }
+}
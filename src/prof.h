@@ -0,0 +1,75 @@
+#pragma once
+
+// Per-phase hardware counter profiling (`irv --profile`).
+//
+// Once `prof_start` has been called, the code being measured brackets
+// each phase with `prof_enter` and `prof_leave`, and every counter's
+// growth in between is added to that phase's totals. Hooks are
+// process-wide and must not nest; before `prof_start` (and after
+// `prof_stop`) they do nothing but test a flag.
+//
+// The counters come from Linux's `perf_event_open`: CPU cycles,
+// instructions retired, last-level cache misses and mispredicted
+// branches, counted in user space only for the calling thread and any
+// threads it starts afterwards. Each counter is opened on its own, so
+// one the hardware or kernel does not offer (as in many virtual
+// machines, or with a strict `perf_event_paranoid` setting) is simply
+// reported as unavailable; wall time is always measured. When the
+// kernel multiplexes counters, totals are scaled by the fraction of
+// the time each was running.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum prof_phase
+{
+    PROF_INGEST,        // reading the ballots
+    PROF_COUNT,         // bb_count, or a compact engine's whole count
+    PROF_ELIMINATE,     // bb_eliminate
+    PROF_SELECT,        // choosing the leader and loser of each round
+    PROF_NPHASES,
+};
+
+enum prof_counter
+{
+    PROF_CYCLES,
+    PROF_INSTRUCTIONS,
+    PROF_CACHE_MISSES,
+    PROF_BRANCH_MISSES,
+    PROF_NCOUNTERS,
+};
+
+// Opens the counters, clears all totals and enables the hooks. Returns
+// the number of hardware counters that could be opened; if it is 0,
+// `*why` (if non-NULL) is set to the `errno` of the first failure.
+size_t prof_start(int* why);
+
+// Disables the hooks and closes the counters. Totals are kept for
+// `prof_report`.
+void prof_stop(void);
+
+// Marks the start of `phase`. No other phase may be open (checked
+// with `assert`).
+void prof_enter(enum prof_phase phase);
+
+// Marks the end of `phase`, which must be the phase last entered.
+void prof_leave(enum prof_phase phase);
+
+// Returns how many times `phase` was entered and left.
+uint64_t prof_calls(enum prof_phase phase);
+
+// Returns the wall time spent in `phase`, in nanoseconds.
+uint64_t prof_nanos(enum prof_phase phase);
+
+// Stores the (scaled) total of `counter` for `phase` in `*value` and
+// returns true, or returns false if the counter is unavailable.
+bool prof_value(enum prof_phase phase, enum prof_counter counter,
+                uint64_t* value);
+
+// Returns the name of `phase`, as used in reports.
+const char* prof_phase_name(enum prof_phase phase);
+
+// Prints a table of the totals for every phase entered at least once,
+// with instructions per cycle, to `outf`.
+void prof_report(FILE* outf);
@@ -0,0 +1,291 @@
+#include "rounds.h"
+#include "helpers.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The state of a walk through a count's rounds. In round `r`,
+// `counts[c]` is candidate `c`'s tally and `gain[c]` the votes it
+// gained since round `r - 1`; `gain` is nonzero only for the
+// candidates in round `r`'s changes, and is cleared after each round.
+// `eliminated[c]` is the round at whose end `c` was eliminated, or
+// `SIZE_MAX` if it never was.
+struct walk
+{
+    cbox_t      cb;
+    tabulator_t tab;
+    size_t      ncand;
+    size_t      nrounds;
+    size_t*     counts;
+    size_t*     gain;
+    size_t*     eliminated;
+};
+
+bool rounds_parse_format(const char* name, enum rounds_format* format)
+{
+    if (strcmp(name, "csv") == 0) {
+        *format = ROUNDS_CSV;
+    } else if (strcmp(name, "json") == 0) {
+        *format = ROUNDS_JSON;
+    } else if (strcmp(name, "text") == 0) {
+        *format = ROUNDS_TEXT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Returns whether candidate `c` is still in the running at the start of
+// round `r`.
+static bool in_round(const struct walk* w, cand_t c, size_t r)
+{
+    if (w->eliminated[c] == SIZE_MAX) {
+        return !tab_is_out(w->tab, c);
+    }
+    return w->eliminated[c] >= r;
+}
+
+// Returns the candidate eliminated at the end of round `r`, or
+// `CAND_NONE` if it is the last round.
+static cand_t loser(const struct walk* w, size_t r)
+{
+    return r + 1 < w->nrounds ? tab_eliminated(w->tab, r) : CAND_NONE;
+}
+
+// Returns the candidate elected at the end of round `r`, if any.
+static cand_t elected(const struct walk* w, size_t r)
+{
+    return r + 1 == w->nrounds ? tab_winner(w->tab) : CAND_NONE;
+}
+
+static const char* status(const struct walk* w, size_t r, cand_t c)
+{
+    if (c == loser(w, r)) {
+        return "eliminated";
+    }
+    if (c == elected(w, r)) {
+        return "elected";
+    }
+    return "continuing";
+}
+
+// Returns the number of exhausted ballots in round `r`.
+static size_t exhausted(const struct walk* w, size_t r)
+{
+    return cbox_size(w->cb) - tab_round_total(w->tab, r);
+}
+
+static void write_csv_round(FILE* outf, const struct walk* w, size_t r)
+{
+    for (size_t c = 0; c < w->ncand; ++c) {
+        if (in_round(w, (cand_t) c, r)) {
+            fprintf(outf, "%zu,%s,%zu,%zu,%s\n", r + 1,
+                    cbox_name(w->cb, (cand_t) c), w->counts[c],
+                    w->gain[c], status(w, r, (cand_t) c));
+        }
+    }
+
+    size_t gone = exhausted(w, r);
+    size_t was  = r > 0 ? exhausted(w, r - 1) : gone;
+    fprintf(outf, "%zu,(exhausted),%zu,%zu,\n", r + 1, gone, gone - was);
+}
+
+// Writes `c`'s name as a JSON value, or null for `CAND_NONE`.
+static void write_json_name(FILE* outf, cbox_t cb, cand_t c)
+{
+    if (c == CAND_NONE) {
+        fputs("null", outf);
+    } else {
+        fprintf(outf, "\"%s\"", cbox_name(cb, c));
+    }
+}
+
+static void write_json_round(FILE* outf, const struct walk* w, size_t r)
+{
+    fprintf(outf, "%s\n    {\"round\": %zu, \"continuing\": %zu, "
+            "\"exhausted\": %zu,\n     \"tallies\": {",
+            r > 0 ? "," : "", r + 1, tab_round_total(w->tab, r),
+            exhausted(w, r));
+    const char* sep = "";
+    for (size_t c = 0; c < w->ncand; ++c) {
+        if (in_round(w, (cand_t) c, r)) {
+            fprintf(outf, "%s\"%s\": %zu", sep,
+                    cbox_name(w->cb, (cand_t) c), w->counts[c]);
+            sep = ", ";
+        }
+    }
+
+    fputs("},\n     \"transfers\": {", outf);
+    sep = "";
+    for (size_t c = 0; c < w->ncand; ++c) {
+        if (w->gain[c] > 0 && in_round(w, (cand_t) c, r)) {
+            fprintf(outf, "%s\"%s\": %zu", sep,
+                    cbox_name(w->cb, (cand_t) c), w->gain[c]);
+            sep = ", ";
+        }
+    }
+
+    fputs("},\n     \"eliminated\": ", outf);
+    write_json_name(outf, w->cb, loser(w, r));
+    fputs("}", outf);
+}
+
+static void write_text_round(FILE* outf, const struct walk* w, size_t r)
+{
+    fprintf(outf, "%zu %zu", r + 1, tab_round_total(w->tab, r));
+    for (size_t c = 0; c < w->ncand; ++c) {
+        if (w->counts[c] > 0) {
+            fprintf(outf, " %s=%zu", cbox_name(w->cb, (cand_t) c),
+                    w->counts[c]);
+        }
+    }
+
+    if (loser(w, r) != CAND_NONE) {
+        fprintf(outf, "; out %s\n", cbox_name(w->cb, loser(w, r)));
+    } else if (elected(w, r) != CAND_NONE) {
+        fprintf(outf, "; won %s\n", cbox_name(w->cb, elected(w, r)));
+    } else {
+        fprintf(outf, "; none\n");
+    }
+}
+
+// Sets up `w` for a walk through the rounds of `tab`, with `counts`
+// for `ncells` tallies.
+static void start_walk(struct walk* w, cbox_t cb, tabulator_t tab,
+                       size_t ncells)
+{
+    w->cb         = cb;
+    w->tab        = tab;
+    w->ncand      = cbox_candidates(cb);
+    w->nrounds    = tab_rounds(tab);
+    size_t cap    = w->ncand > 0 ? w->ncand : 1;
+    w->counts     = callocb(ncells > 0 ? ncells : 1, sizeof *w->counts,
+                            "rounds_write");
+    w->gain       = callocb(cap, sizeof *w->gain, "rounds_write");
+    w->eliminated = mallocb(cap * sizeof *w->eliminated, "rounds_write");
+    for (size_t c = 0; c < w->ncand; ++c) {
+        w->eliminated[c] = SIZE_MAX;
+    }
+    for (size_t r = 0; r + 1 < w->nrounds; ++r) {
+        w->eliminated[tab_eliminated(tab, r)] = r;
+    }
+}
+
+static void end_walk(struct walk* w)
+{
+    free(w->counts);
+    free(w->gain);
+    free(w->eliminated);
+}
+
+void rounds_write(FILE* outf, cbox_t cb, tabulator_t tab,
+                  enum rounds_format format)
+{
+    struct walk w;
+    start_walk(&w, cb, tab, cbox_candidates(cb));
+
+    if (format == ROUNDS_CSV) {
+        fputs("round,candidate,votes,transfer,status\n", outf);
+    } else if (format == ROUNDS_JSON) {
+        fprintf(outf, "{\"ballots\": %zu, \"winner\": ", cbox_size(cb));
+        write_json_name(outf, cb, tab_winner(tab));
+        fputs(",\n \"rounds\": [", outf);
+    }
+
+    for (size_t r = 0; r < w.nrounds; ++r) {
+        size_t nchanges;
+        const struct tab_change* changes =
+            tab_round_changes(tab, r, &nchanges);
+
+        // Round 0's changes are the first choices, not transfers.
+        for (size_t j = 0; j < nchanges; ++j) {
+            cand_t c = changes[j].cand;
+            if (r > 0 && changes[j].count > w.counts[c]) {
+                w.gain[c] = changes[j].count - w.counts[c];
+            }
+            w.counts[c] = changes[j].count;
+        }
+
+        switch (format) {
+        case ROUNDS_CSV:
+            write_csv_round(outf, &w, r);
+            break;
+        case ROUNDS_JSON:
+            write_json_round(outf, &w, r);
+            break;
+        case ROUNDS_TEXT:
+            write_text_round(outf, &w, r);
+            break;
+        }
+
+        for (size_t j = 0; j < nchanges; ++j) {
+            w.gain[changes[j].cand] = 0;
+        }
+    }
+
+    if (format == ROUNDS_JSON) {
+        fputs("\n ]}\n", outf);
+    }
+
+    end_walk(&w);
+}
+
+// Writes `field` to `outf` as a CSV field, quoted if need be. Group
+// keys, unlike candidate names, are free text.
+static void write_csv_field(FILE* outf, const char* field)
+{
+    if (strpbrk(field, ",\"\r\n") == NULL) {
+        fputs(field, outf);
+        return;
+    }
+
+    putc('"', outf);
+    for (const char* p = field; *p; ++p) {
+        if (*p == '"') {
+            putc('"', outf);
+        }
+        putc(*p, outf);
+    }
+    putc('"', outf);
+}
+
+void rounds_write_groups(FILE* outf, cbox_t cb, tabulator_t tab,
+                         groups_t gs)
+{
+    // Here `counts[g * ncand + c]` is group `g`'s tally for `c`.
+    struct walk w;
+    size_t ngroups = groups_count(gs);
+    start_walk(&w, cb, tab, ngroups * cbox_candidates(cb));
+
+    fputs("round,group,candidate,votes\n", outf);
+    for (size_t r = 0; r < w.nrounds; ++r) {
+        size_t nchanges;
+        const struct tab_group_change* changes =
+            tab_round_group_changes(tab, r, &nchanges);
+        for (size_t j = 0; j < nchanges; ++j) {
+            w.counts[changes[j].group * w.ncand + changes[j].cand] =
+                changes[j].count;
+        }
+
+        for (size_t g = 0; g < ngroups; ++g) {
+            const size_t* counts = w.counts + g * w.ncand;
+            size_t continuing = 0;
+            for (size_t c = 0; c < w.ncand; ++c) {
+                if (in_round(&w, (cand_t) c, r)) {
+                    fprintf(outf, "%zu,", r + 1);
+                    write_csv_field(outf, groups_name(gs, g));
+                    fprintf(outf, ",%s,%zu\n", cbox_name(cb, (cand_t) c),
+                            counts[c]);
+                    continuing += counts[c];
+                }
+            }
+            fprintf(outf, "%zu,", r + 1);
+            write_csv_field(outf, groups_name(gs, g));
+            fprintf(outf, ",(exhausted),%zu\n",
+                    groups_size(gs, g) - continuing);
+        }
+    }
+
+    end_walk(&w);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+// Round-by-round result tables.
+//
+// A finished count in a `tabulator_t` already holds its round history
+// as per-round changes to the tallies (see `tab_round_changes`), so a
+// table is written by replaying those changes into one set of running
+// tallies: each round costs time in proportion to the tallies that
+// changed, plus the output itself, and the count is never rerun.
+//
+// Each round lists every candidate still in the running at its start
+// with their votes, the votes transferred to them from the candidate
+// eliminated in the round before, and whether they continue, are
+// eliminated at the end of the round, or are elected; and the number
+// of exhausted ballots, which rank no continuing candidate. Withdrawn
+// candidates never appear. Candidate names are letters only (see
+// `clean_name`), so they need no quoting in either CSV or JSON.
+
+#include "cbox.h"
+#include "groups.h"
+#include "tabulate.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+enum rounds_format
+{
+    // One row per candidate per round, with a header row:
+    // round,candidate,votes,transfer,status. Rounds count from 1, and
+    // each round ends with a row for the candidate "(exhausted)" with
+    // an empty status.
+    ROUNDS_CSV,
+
+    // One object: {"ballots", "winner", "rounds": [{"round",
+    // "continuing", "exhausted", "tallies", "transfers",
+    // "eliminated"}, ...]}, with tallies and nonzero transfers keyed
+    // by name.
+    ROUNDS_JSON,
+
+    // One line per round, as the server's ROUNDS response: the round
+    // number, the continuing total, each nonzero tally as NAME=votes,
+    // and "; out NAME", "; won NAME" or "; none".
+    ROUNDS_TEXT,
+};
+
+// Sets `*format` to the format named `name` ("csv", "json" or "text")
+// and returns true, or returns false if there is no such format.
+bool rounds_parse_format(const char* name, enum rounds_format* format);
+
+// Writes the round table of the finished count in `tab` of the ballots
+// in `cb` to `outf`.
+//
+// OWNERSHIP:
+//  - Borrows all arguments transiently.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+void rounds_write(FILE* outf, cbox_t cb, tabulator_t tab,
+                  enum rounds_format format);
+
+// Writes the round table of the finished count in `tab`, broken down
+// by the groups in `gs`, to `outf` as CSV: a header row
+// round,group,candidate,votes, then for each round and group a row for
+// each candidate still in the running and one for "(exhausted)". The
+// count must have been kept by group (see `tab_set_groups`) with the
+// group numbers from `gs`.
+//
+// OWNERSHIP:
+//  - Borrows all arguments transiently.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+void rounds_write_groups(FILE* outf, cbox_t cb, tabulator_t tab,
+                         groups_t gs);
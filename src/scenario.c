@@ -0,0 +1,108 @@
+#include "scenario.h"
+#include "helpers.h"
+#include "pool.h"
+#include "tabulate.h"
+
+#include <stdlib.h>
+
+// Per-worker state, reused for every scenario the worker runs.
+struct worker
+{
+    tabulator_t tab;
+    size_t*     rank;       // tie-break ranks, one per candidate
+};
+
+struct scen
+{
+    cbox_t                   cb;
+    const struct scenario*   scenarios;
+    struct scen_result*      results;
+    struct worker*           workers;
+};
+
+// Fills `rank` for `tiebreak`, returning NULL for the usual tie-break.
+static const size_t* set_ranks(size_t* rank, size_t ncand,
+                               const struct scenario* sc)
+{
+    switch (sc->tiebreak) {
+    case SCEN_TIE_BALLOTS:
+        return NULL;
+
+    case SCEN_TIE_LISTED:
+        for (size_t c = 0; c < ncand; ++c) {
+            rank[c] = ncand - c;
+        }
+        return rank;
+
+    case SCEN_TIE_LOT: {
+        // A Fisher-Yates shuffle of the ranks, inside out: `rank[c]`
+        // is unset until it is reached, so it is only copied from
+        // another slot.
+        struct rng rng;
+        rng_seed(&rng, sc->seed, 0);
+        for (size_t c = 0; c < ncand; ++c) {
+            size_t j = (size_t) rng_below(&rng, c + 1);
+            if (j != c) {
+                rank[c] = rank[j];
+            }
+            rank[j] = c;
+        }
+        return rank;
+    }
+    }
+
+    return NULL;
+}
+
+static void run_task(void* ctx, size_t task, size_t worker)
+{
+    struct scen* s            = ctx;
+    struct worker* w          = &s->workers[worker];
+    const struct scenario* sc = &s->scenarios[task];
+
+    struct tab_rules rules = {
+        .depth = sc->depth,
+        .rank  = set_ranks(w->rank, cbox_candidates(s->cb), sc),
+    };
+    tab_set_rules(w->tab, &rules);
+    cand_t winner = tab_run(w->tab, s->cb, sc->withdrawn);
+
+    s->results[task] = (struct scen_result) {
+        .winner     = winner,
+        .rounds     = tab_rounds(w->tab),
+        .votes      = winner == CAND_NONE ? 0 : tab_count(w->tab, winner),
+        .continuing = tab_total(w->tab),
+    };
+}
+
+void scen_run(cbox_t cb, const struct scenario* scenarios, size_t n,
+              struct scen_result* results, size_t nworkers)
+{
+    if (nworkers == 0) {
+        nworkers = pool_default_workers();
+    }
+    if (nworkers > n) {
+        nworkers = n > 0 ? n : 1;
+    }
+
+    size_t ncand = cbox_candidates(cb);
+    struct scen s = {
+        .cb        = cb,
+        .scenarios = scenarios,
+        .results   = results,
+        .workers   = mallocb(nworkers * sizeof *s.workers, "scen_run"),
+    };
+    for (size_t i = 0; i < nworkers; ++i) {
+        s.workers[i].tab  = tab_create();
+        s.workers[i].rank = mallocb((ncand > 0 ? ncand : 1) *
+                                    sizeof *s.workers[i].rank, "scen_run");
+    }
+
+    pool_run(nworkers, n, run_task, &s);
+
+    for (size_t i = 0; i < nworkers; ++i) {
+        tab_destroy(s.workers[i].tab);
+        free(s.workers[i].rank);
+    }
+    free(s.workers);
+}
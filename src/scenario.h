@@ -0,0 +1,78 @@
+#pragma once
+
+// What-if counts: many tabulations of one loaded ballot box.
+//
+// `get_irv_winner` marks eliminations on the ballots themselves, so a
+// counterfactual with it needs a freshly read box. A tabulator
+// (tabulate.h) instead only borrows its compact box and keeps the
+// elimination state (a cursor per ballot and a pile per candidate) to
+// itself. So a box loaded once serves every scenario: `scen_run` runs
+// each against it on a tabulator of its own, several at a time on the
+// pool's threads (pool.h). Each worker thread reuses one tabulator for all
+// the scenarios it runs, so a scenario costs one count and, after the
+// first, no allocation.
+
+#include "cbox.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// How a scenario breaks ties, both for the leader and the loser.
+enum scen_tiebreak
+{
+    // As `get_irv_winner` does, by ballot order (see tabulate.h).
+    SCEN_TIE_BALLOTS,
+
+    // By the order candidates were added to the box: the earlier
+    // candidate leads, and the later one is eliminated.
+    SCEN_TIE_LISTED,
+
+    // By lot: a random order of the candidates drawn from the
+    // scenario's `seed`, the same for every scenario with that seed.
+    SCEN_TIE_LOT,
+};
+
+// One counterfactual. The zero value is the count as it happened.
+struct scenario
+{
+    // NULL, or `cbox_candidates(cb)` flags marking candidates to treat
+    // as withdrawn before the count.
+    const bool* withdrawn;
+
+    // If nonzero, only the first `depth` choices on each ballot count.
+    size_t depth;
+
+    enum scen_tiebreak tiebreak;
+
+    // For SCEN_TIE_LOT.
+    uint64_t seed;
+};
+
+struct scen_result
+{
+    // The winner, or `CAND_NONE` if no ballot ranks a continuing
+    // candidate.
+    cand_t winner;
+
+    // The number of rounds, counting the last.
+    size_t rounds;
+
+    // The winner's votes and the continuing ballots in the last round.
+    size_t votes;
+    size_t continuing;
+};
+
+// Runs the `n` scenarios in `scenarios` against `cb`, storing the
+// result of `scenarios[k]` in `results[k]`, using up to `nworkers`
+// threads (0 for the default; see pool.h). The results do not depend
+// on the number of threads.
+//
+// OWNERSHIP:
+//  - Borrows all arguments for the duration of the call; `cb` must not
+//    be modified during that time.
+//
+// ERRORS:
+//  - Exits with code 1 if threads or memory cannot be allocated.
+void scen_run(cbox_t cb, const struct scenario* scenarios, size_t n,
+              struct scen_result* results, size_t nworkers);
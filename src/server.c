@@ -0,0 +1,641 @@
+#include "server.h"
+#include "ballot.h"
+#include "cbox.h"
+#include "helpers.h"
+#include "rounds.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// One named ballot box. `first[c]` is candidate `c`'s first-round
+// tally, kept current as batches arrive. If `counted`, then `tab` holds
+// a count of `cb`, brought up to date with `tab_append` as batches
+// arrive, though perhaps not finished; if `rounds` is non-NULL, it is
+// the (owned) ROUNDS response for `cb` as it is now.
+struct box
+{
+    char*       name;
+    cbox_t      cb;
+    size_t*     first;
+    size_t      first_cap;
+    tabulator_t tab;
+    bool        counted;
+    char*       rounds;
+};
+
+// One connection, served by its own thread. Once `done`, the thread has
+// closed `fd` and can be joined.
+struct client
+{
+    struct server* srv;
+    int            fd;
+    pthread_t      thread;
+    bool           done;
+};
+
+// The boxes, and the list of connections, are shared by all the client
+// threads and guarded by `lock`. A thread holds it only while it works
+// on the boxes, never while it reads from or writes to its client, so a
+// slow or idle client holds up no one else.
+struct server
+{
+    pthread_mutex_t lock;
+    struct box*     boxes;
+    size_t          nboxes;
+    size_t          cap;
+
+    struct client** clients;
+    size_t          nclients;
+    size_t          client_cap;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void on_signal(int sig)
+{
+    (void) sig;
+    stopping = 1;
+}
+
+///
+/// BOXES
+///
+
+static struct box* find_box(struct server* srv, const char* name)
+{
+    for (size_t i = 0; i < srv->nboxes; ++i) {
+        if (strcmp(srv->boxes[i].name, name) == 0) {
+            return &srv->boxes[i];
+        }
+    }
+    return NULL;
+}
+
+static struct box* find_or_add_box(struct server* srv, const char* name)
+{
+    struct box* box = find_box(srv, name);
+    if (box != NULL) {
+        return box;
+    }
+
+    if (srv->nboxes == srv->cap) {
+        srv->cap   = srv->cap ? 2 * srv->cap : 4;
+        srv->boxes = reallocb(srv->boxes, srv->cap * sizeof *srv->boxes,
+                              "server");
+    }
+
+    box = &srv->boxes[srv->nboxes++];
+    box->name      = strdupb(name, "server");
+    box->cb        = cbox_create();
+    box->first     = NULL;
+    box->first_cap = 0;
+    box->tab       = tab_create();
+    box->counted   = false;
+    box->rounds    = NULL;
+    return box;
+}
+
+static void destroy_box(struct box* box)
+{
+    free(box->name);
+    cbox_destroy(box->cb);
+    free(box->first);
+    tab_destroy(box->tab);
+    free(box->rounds);
+}
+
+// Updates the count after ballots are added to `box->cb`, and throws
+// away the cached ROUNDS response.
+static void invalidate(struct box* box)
+{
+    if (box->counted) {
+        tab_append(box->tab, box->cb);
+    }
+    free(box->rounds);
+    box->rounds = NULL;
+}
+
+// Adds the first choices of ballots `from ..` to the running tallies.
+static void update_first(struct box* box, size_t from)
+{
+    size_t ncand = cbox_candidates(box->cb);
+    if (ncand > box->first_cap) {
+        box->first = reallocb(box->first, ncand * sizeof *box->first,
+                              "server");
+        memset(box->first + box->first_cap, 0,
+               (ncand - box->first_cap) * sizeof *box->first);
+        box->first_cap = ncand;
+    }
+
+    size_t n = cbox_size(box->cb);
+    for (size_t i = from; i < n; ++i) {
+        size_t len;
+        const cand_t* ranks = cbox_ballot(box->cb, i, &len);
+        if (len > 0) {
+            ++box->first[ranks[0]];
+        }
+    }
+}
+
+///
+/// REQUESTS
+///
+
+// Checks that adding the names in `buf` to `cb` (NULL for a new box)
+// would not overfill its candidate table, since `cbox_intern` would
+// exit rather than reject them. `nnames` is how many name lines there
+// are; only when there are that many new names can it overflow, so only
+// then are the new ones actually found.
+static bool candidates_fit(cbox_t cb, const char* buf, size_t len,
+                           size_t nnames)
+{
+    size_t known = cb ? cbox_candidates(cb) : 0;
+    if (nnames <= CBOX_MAX_CANDIDATES - known) {
+        return true;
+    }
+
+    cbox_t fresh = cbox_create();
+    char*  name  = NULL;
+    size_t cap   = 0;
+    bool   fits  = true;
+    const char* end = buf + len;
+    while (fits && buf < end) {
+        const char* nl = memchr(buf, '\n', end - buf);
+        size_t n = nl ? (size_t) (nl - buf) : (size_t) (end - buf);
+        if (!(n == 1 && buf[0] == '%')) {
+            if (n + 1 > cap) {
+                cap  = 2 * (n + 1);
+                name = reallocb(name, cap, "server");
+            }
+            memcpy(name, buf, n);
+            name[n] = 0;
+            clean_name(name);
+            if ((cb == NULL || cbox_find(cb, name) == CAND_NONE) &&
+                    cbox_find(fresh, name) == CAND_NONE) {
+                if (cbox_candidates(fresh) == CBOX_MAX_CANDIDATES - known) {
+                    fits = false;
+                } else {
+                    cbox_intern(fresh, name);
+                }
+            }
+        }
+        buf += n + 1;
+    }
+
+    free(name);
+    cbox_destroy(fresh);
+    return fits;
+}
+
+// Checks that no ballot in `buf` has more than MAX_CANDIDATES names,
+// since `cbox_push` would exit rather than reject it, and counts the
+// name lines into `*nnames`.
+static bool ballots_fit(const char* buf, size_t len, size_t* nnames_out)
+{
+    size_t names  = 0;
+    size_t nnames = 0;
+    const char* p   = buf;
+    const char* end = buf + len;
+    while (p < end) {
+        const char* nl = memchr(p, '\n', end - p);
+        size_t n = nl ? (size_t) (nl - p) : (size_t) (end - p);
+        if (n == 1 && p[0] == '%') {
+            names = 0;
+        } else if (++names > MAX_CANDIDATES) {
+            return false;
+        } else {
+            ++nnames;
+        }
+        p += n + 1;
+    }
+
+    *nnames_out = nnames;
+    return true;
+}
+
+// Reads `len` bytes from `in` into `buf`, giving up if the client
+// stalls for SERVER_BATCH_TIMEOUT seconds.
+static bool read_batch(FILE* in, char* buf, size_t len)
+{
+    int fd = fileno(in);
+    struct timeval limit = { .tv_sec = SERVER_BATCH_TIMEOUT };
+    struct timeval none  = { .tv_sec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof limit);
+    bool ok = fread(buf, 1, len, in) == len;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &none, sizeof none);
+    return ok;
+}
+
+// Parses the <nbytes> of a BATCH request: digits only, at most
+// SERVER_MAX_BATCH.
+static bool parse_batch_size(const char* arg, size_t* len)
+{
+    if (arg == NULL || *arg < '0' || *arg > '9') {
+        return false;
+    }
+
+    char* endp;
+    errno = 0;
+    unsigned long long n = strtoull(arg, &endp, 10);
+    if (*endp != 0 || errno == ERANGE || n > SERVER_MAX_BATCH) {
+        return false;
+    }
+    *len = (size_t) n;
+    return true;
+}
+
+// Handles a BATCH request, reading the batch before taking the lock.
+// Returns false if the connection must be closed, because the batch's
+// size was bad or it did not all arrive, and so it cannot be skipped.
+static bool do_batch(struct server* srv, const char* name, const char* arg,
+                     FILE* in, FILE* out)
+{
+    size_t len;
+    if (!parse_batch_size(arg, &len)) {
+        fprintf(out, "ERR usage: BATCH <box> <nbytes> (nbytes at most "
+                "%zu)\n", SERVER_MAX_BATCH);
+        return false;
+    }
+
+    char* buf = malloc(len + 1);
+    if (buf == NULL) {
+        fprintf(out, "ERR out of memory\n");
+        return false;
+    }
+    if (!read_batch(in, buf, len)) {
+        fprintf(out, "ERR short batch\n");
+        free(buf);
+        return false;
+    }
+    size_t nnames;
+    if (!ballots_fit(buf, len, &nnames)) {
+        fprintf(out, "ERR ballot with too many names\n");
+        free(buf);
+        return true;
+    }
+
+    pthread_mutex_lock(&srv->lock);
+    struct box* box = find_box(srv, name);
+    if (!candidates_fit(box ? box->cb : NULL, buf, len, nnames)) {
+        pthread_mutex_unlock(&srv->lock);
+        fprintf(out, "ERR too many candidates\n");
+        free(buf);
+        return true;
+    }
+
+    box = find_or_add_box(srv, name);
+    size_t before   = cbox_size(box->cb);
+    if (len > 0) {
+        FILE* batch = fmemopen(buf, len, "r");
+        if (batch == NULL) {
+            perror("server");
+            exit(1);
+        }
+        cbox_read(box->cb, batch);
+        fclose(batch);
+    }
+    free(buf);
+
+    update_first(box, before);
+    invalidate(box);
+    fprintf(out, "OK %zu %zu\n", cbox_size(box->cb) - before,
+            cbox_size(box->cb));
+    pthread_mutex_unlock(&srv->lock);
+    return true;
+}
+
+// Finishes the count of `box`, starting it if need be.
+static void finish_count(struct box* box)
+{
+    if (!box->counted) {
+        tab_start(box->tab, box->cb, NULL);
+        box->counted = true;
+    }
+    while (tab_round(box->tab)) {
+        continue;
+    }
+}
+
+static void do_winner(struct box* box, FILE* out)
+{
+    finish_count(box);
+    cand_t winner = tab_winner(box->tab);
+    fprintf(out, "OK %s\n",
+            winner == CAND_NONE ? "-" : cbox_name(box->cb, winner));
+}
+
+static void do_tally(struct box* box, FILE* out)
+{
+    size_t ncand = cbox_candidates(box->cb);
+    fprintf(out, "OK %zu\n", ncand);
+    for (size_t c = 0; c < ncand; ++c) {
+        fprintf(out, "%s %zu\n", cbox_name(box->cb, (cand_t) c),
+                box->first[c]);
+    }
+}
+
+// Finishes the count of `box` and renders its rounds from the
+// tabulator's history, saving the response in `box->rounds`.
+static void count_rounds(struct box* box)
+{
+    char*  text;
+    size_t size;
+    FILE*  rounds = open_memstream(&text, &size);
+    if (rounds == NULL) {
+        perror("server");
+        exit(1);
+    }
+
+    finish_count(box);
+    rounds_write(rounds, box->cb, box->tab, ROUNDS_TEXT);
+    fclose(rounds);
+
+    size_t nrounds = tab_rounds(box->tab);
+    size_t header  = (size_t) snprintf(NULL, 0, "OK %zu\n", nrounds);
+    box->rounds = mallocb(header + size + 1, "server");
+    snprintf(box->rounds, header + 1, "OK %zu\n", nrounds);
+    memcpy(box->rounds + header, text, size + 1);
+    free(text);
+}
+
+static void do_rounds(struct box* box, FILE* out)
+{
+    if (box->rounds == NULL) {
+        count_rounds(box);
+    }
+    fputs(box->rounds, out);
+}
+
+static void do_drop(struct server* srv, struct box* box, FILE* out)
+{
+    destroy_box(box);
+    *box = srv->boxes[--srv->nboxes];
+    fprintf(out, "OK\n");
+}
+
+// Handles one request line, writing the response to `out`, which is a
+// memory stream, so that no lock is held while the client reads it.
+// Returns false if the client is done.
+static bool handle(struct server* srv, char* line, FILE* in, FILE* out)
+{
+    char* save;
+    char* cmd  = strtok_r(line, " \t", &save);
+    char* name = strtok_r(NULL, " \t", &save);
+    char* arg  = strtok_r(NULL, " \t", &save);
+
+    if (cmd == NULL) {
+        fprintf(out, "ERR empty request\n");
+        return true;
+    }
+    if (strcmp(cmd, "QUIT") == 0) {
+        return false;
+    }
+    if (name == NULL) {
+        fprintf(out, "ERR missing box name\n");
+        return true;
+    }
+    if (strcmp(cmd, "BATCH") == 0) {
+        return do_batch(srv, name, arg, in, out);
+    }
+
+    pthread_mutex_lock(&srv->lock);
+    struct box* box = find_box(srv, name);
+    if (box == NULL) {
+        fprintf(out, "ERR no such box: %s\n", name);
+    } else if (strcmp(cmd, "WINNER") == 0) {
+        do_winner(box, out);
+    } else if (strcmp(cmd, "TALLY") == 0) {
+        do_tally(box, out);
+    } else if (strcmp(cmd, "ROUNDS") == 0) {
+        do_rounds(box, out);
+    } else if (strcmp(cmd, "DROP") == 0) {
+        do_drop(srv, box, out);
+    } else {
+        fprintf(out, "ERR unknown request: %s\n", cmd);
+    }
+    pthread_mutex_unlock(&srv->lock);
+    return true;
+}
+
+// Serves one client until it quits or disconnects, then marks it done.
+static void* serve_client(void* arg)
+{
+    struct client* client = arg;
+    struct server* srv    = client->srv;
+    int   fd  = client->fd;
+    int   fd2 = dup(fd);
+    FILE* in  = fdopen(fd, "r");
+    FILE* out = fd2 < 0 ? NULL : fdopen(fd2, "w");
+    if (in == NULL || out == NULL) {
+        perror("server");
+    }
+
+    char*  line;
+    char*  text;
+    size_t size;
+    bool   more = in != NULL && out != NULL;
+    while (more && (line = fread_line(in)) != NULL) {
+        FILE* reply = open_memstream(&text, &size);
+        if (reply == NULL) {
+            perror("server");
+            exit(1);
+        }
+        more = handle(srv, line, in, reply);
+        fclose(reply);
+        free(line);
+
+        fwrite(text, 1, size, out);
+        free(text);
+        fflush(out);
+    }
+
+    // Closing under the lock keeps `server_run` from shutting down a
+    // descriptor that has been closed and reused.
+    pthread_mutex_lock(&srv->lock);
+    if (in != NULL) {
+        fclose(in);
+    } else {
+        close(fd);
+    }
+    if (out != NULL) {
+        fclose(out);
+    } else if (fd2 >= 0) {
+        close(fd2);
+    }
+    client->done = true;
+    pthread_mutex_unlock(&srv->lock);
+    return NULL;
+}
+
+// Joins and forgets the clients that are done (all of them, if `all`,
+// waiting for each). Must be called without the lock.
+static void reap_clients(struct server* srv, bool all)
+{
+    pthread_mutex_lock(&srv->lock);
+    size_t kept = 0;
+    for (size_t i = 0; i < srv->nclients; ++i) {
+        struct client* client = srv->clients[i];
+        if (all || client->done) {
+            pthread_mutex_unlock(&srv->lock);
+            pthread_join(client->thread, NULL);
+            pthread_mutex_lock(&srv->lock);
+            free(client);
+        } else {
+            srv->clients[kept++] = client;
+        }
+    }
+    srv->nclients = kept;
+    pthread_mutex_unlock(&srv->lock);
+}
+
+// Starts a thread serving `fd`, which it takes ownership of. The thread
+// blocks SIGINT and SIGTERM, so they interrupt `accept` in the main
+// thread instead.
+static void add_client(struct server* srv, int fd)
+{
+    struct client* client = mallocb(sizeof *client, "server");
+    client->srv  = srv;
+    client->fd   = fd;
+    client->done = false;
+
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    int err = pthread_create(&client->thread, NULL, serve_client, client);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err != 0) {
+        fprintf(stderr, "server: cannot start a thread: %s\n",
+                strerror(err));
+        close(fd);
+        free(client);
+        return;
+    }
+
+    pthread_mutex_lock(&srv->lock);
+    if (srv->nclients == srv->client_cap) {
+        srv->client_cap = srv->client_cap ? 2 * srv->client_cap : 8;
+        srv->clients    = reallocb(srv->clients,
+                                   srv->client_cap * sizeof *srv->clients,
+                                   "server");
+    }
+    srv->clients[srv->nclients++] = client;
+    pthread_mutex_unlock(&srv->lock);
+}
+
+///
+/// SOCKET
+///
+
+// Checks whether a server is listening at `addr`.
+static bool in_use(const struct sockaddr_un* addr)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    bool live = connect(fd, (const struct sockaddr*) addr, sizeof *addr) == 0;
+    close(fd);
+    return live;
+}
+
+static int open_socket(const char* path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof addr.sun_path) {
+        fprintf(stderr, "server: socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    // Replace a stale socket from an earlier run, but not one that a
+    // server is still listening on, and nothing else.
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        if (in_use(&addr)) {
+            fprintf(stderr, "server: already serving on %s\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("server: socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr*) &addr, sizeof addr) < 0 ||
+            listen(fd, 16) < 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int server_run(const char* path)
+{
+    int fd = open_socket(path);
+    if (fd < 0) {
+        return 1;
+    }
+
+    // No SA_RESTART, so that a signal interrupts accept(2).
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct server srv = { .boxes = NULL };
+    pthread_mutex_init(&srv.lock, NULL);
+    while (!stopping) {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            if (errno != EINTR) {
+                perror("server: accept");
+            }
+            continue;
+        }
+        reap_clients(&srv, false);
+        add_client(&srv, client);
+    }
+
+    // Wake the clients still connected, and wait for them to finish.
+    pthread_mutex_lock(&srv.lock);
+    for (size_t i = 0; i < srv.nclients; ++i) {
+        if (!srv.clients[i]->done) {
+            shutdown(srv.clients[i]->fd, SHUT_RDWR);
+        }
+    }
+    pthread_mutex_unlock(&srv.lock);
+    reap_clients(&srv, true);
+    free(srv.clients);
+    pthread_mutex_destroy(&srv.lock);
+
+    for (size_t i = 0; i < srv.nboxes; ++i) {
+        destroy_box(&srv.boxes[i]);
+    }
+    free(srv.boxes);
+    close(fd);
+    unlink(path);
+    return 0;
+}
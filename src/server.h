@@ -0,0 +1,63 @@
+#pragma once
+
+// A long-running tabulation server (`irv --serve PATH`).
+//
+// The server listens on a Unix domain socket and keeps any number of
+// named ballot boxes loaded in memory. Clients send ballot batches and
+// queries; the server keeps each box's first-round tallies up to date
+// as batches arrive, and once a box has been counted, brings its count
+// up to date by counting only each new batch (see `tab_append`). A
+// dashboard polling an unchanged box is answered without recounting.
+//
+// The protocol is line-based text. Each request is one line; each
+// response starts with "OK" or "ERR <message>":
+//
+//   BATCH <box> <nbytes>   followed by exactly <nbytes> bytes of
+//                          ballots in the `read_ballot` format; adds
+//                          them to <box> (creating it if needed).
+//                          <nbytes> is at most SERVER_MAX_BATCH; the
+//                          connection is closed after an ERR for a
+//                          bad <nbytes>, since the batch that follows
+//                          cannot be skipped, and likewise if the
+//                          batch does not all arrive within
+//                          SERVER_BATCH_TIMEOUT seconds.
+//                          -> OK <ballots added> <ballots in box>
+//
+//   WINNER <box>           -> OK <winner>  (or "OK -" if no votes)
+//
+//   TALLY <box>            first-round tallies.
+//                          -> OK <n>, then n lines "<name> <count>"
+//
+//   ROUNDS <box>           the round table.
+//                          -> OK <rounds>, then one line per round:
+//                             "<round> <continuing>", then
+//                             " <name>=<count>" for each candidate
+//                             with votes that round, then "; out
+//                             <name>", "; won <name>" or "; none"
+//
+//   DROP <box>             forgets <box>.  -> OK
+//
+//   QUIT                   closes the connection.
+//
+// A batch that would overfill a ballot or the box's candidate table is
+// rejected with ERR, leaving the box unchanged.
+//
+// Each connection is served by its own thread, so an idle or slow client
+// does not hold up the others; requests from different clients are
+// applied one at a time, in the order they arrive.
+
+// The largest batch the server accepts, in bytes.
+#define SERVER_MAX_BATCH ((size_t) 64 << 20)
+
+// How long, in seconds, the server waits for the rest of a batch.
+#define SERVER_BATCH_TIMEOUT 30
+
+// Serves requests on a Unix domain socket at `path` until interrupted
+// (SIGINT or SIGTERM), then removes the socket. Returns 0 on a clean
+// shutdown and 1 if the socket cannot be set up, including when another
+// server is already listening at `path` (after printing a message to
+// stderr).
+//
+// OWNERSHIP:
+//  - Borrows `path` for the duration of the call.
+int server_run(const char* path);
@@ -0,0 +1,253 @@
+#include "sim.h"
+#include "cbox.h"
+#include "helpers.h"
+#include "pool.h"
+#include "tabulate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Trials per pool task: enough to amortize scheduling, few enough to
+// balance the load.
+#define TRIALS_PER_TASK 64
+
+// Per-worker state, reused for every trial the worker runs.
+struct worker
+{
+    cbox_t      cb;
+    tabulator_t tab;
+    struct rng  rng;
+
+    cand_t*     perm;       // candidates, for drawing rankings
+    double*     weight;     // weights of `perm` (Plackett-Luce)
+    double*     where;      // candidate positions (spatial)
+    double*     dist;       // distances to one voter (spatial)
+
+    size_t*     wins;       // `candidates + 1` counts
+};
+
+struct sim
+{
+    const struct sim_config* config;
+    size_t         depth;
+    struct worker* workers;
+};
+
+// Draws an impartial-culture ranking: a partial Fisher-Yates shuffle.
+// `perm` need not be reset between ballots, since shuffling any
+// permutation gives a uniformly random one; it is reset per trial only
+// so that trials do not depend on each other.
+static void draw_impartial(const struct sim* s, struct worker* w,
+                           cand_t* ranks)
+{
+    size_t n = s->config->candidates;
+    for (size_t i = 0; i < s->depth; ++i) {
+        size_t j = i + rng_below(&w->rng, n - i);
+        cand_t t = w->perm[i];
+        w->perm[i] = w->perm[j];
+        w->perm[j] = t;
+        ranks[i] = w->perm[i];
+    }
+}
+
+static void draw_plackett_luce(const struct sim* s, struct worker* w,
+                               cand_t* ranks)
+{
+    size_t n = s->config->candidates;
+    double total = 0;
+    for (size_t c = 0; c < n; ++c) {
+        w->perm[c]   = (cand_t) c;
+        w->weight[c] = s->config->weights[c];
+        total       += w->weight[c];
+    }
+
+    for (size_t i = 0; i < s->depth; ++i) {
+        double x = rng_unit(&w->rng) * total;
+        size_t j = i;
+        while (j + 1 < n && x >= w->weight[j]) {
+            x -= w->weight[j];
+            ++j;
+        }
+
+        ranks[i] = w->perm[j];
+        total   -= w->weight[j];
+        w->perm[j]   = w->perm[i];
+        w->weight[j] = w->weight[i];
+    }
+}
+
+static void draw_spatial(const struct sim* s, struct worker* w,
+                         cand_t* ranks)
+{
+    size_t n    = s->config->candidates;
+    size_t dims = s->config->dimensions;
+    double voter[SIM_MAX_DIMENSIONS];
+    for (size_t d = 0; d < dims; ++d) {
+        voter[d] = rng_unit(&w->rng);
+    }
+
+    for (size_t c = 0; c < n; ++c) {
+        double sum = 0;
+        for (size_t d = 0; d < dims; ++d) {
+            double delta = w->where[c * dims + d] - voter[d];
+            sum += delta * delta;
+        }
+        w->perm[c] = (cand_t) c;
+        w->dist[c] = sum;
+    }
+
+    // Partial selection sort: only the first `depth` places matter.
+    for (size_t i = 0; i < s->depth; ++i) {
+        size_t best = i;
+        for (size_t j = i + 1; j < n; ++j) {
+            if (w->dist[j] < w->dist[best]) {
+                best = j;
+            }
+        }
+        ranks[i] = w->perm[best];
+        w->perm[best] = w->perm[i];
+        w->dist[best] = w->dist[i];
+    }
+}
+
+static void run_trial(const struct sim* s, struct worker* w, size_t trial)
+{
+    const struct sim_config* config = s->config;
+    cand_t ranks[MAX_CANDIDATES];
+
+    rng_seed(&w->rng, config->seed, trial);
+    cbox_clear(w->cb);
+    for (size_t c = 0; c < config->candidates; ++c) {
+        w->perm[c] = (cand_t) c;
+    }
+
+    if (config->model == SIM_SPATIAL) {
+        size_t n = config->candidates * config->dimensions;
+        for (size_t i = 0; i < n; ++i) {
+            w->where[i] = rng_unit(&w->rng);
+        }
+    }
+
+    for (size_t v = 0; v < config->voters; ++v) {
+        switch (config->model) {
+        case SIM_IMPARTIAL:
+            draw_impartial(s, w, ranks);
+            break;
+        case SIM_PLACKETT_LUCE:
+            draw_plackett_luce(s, w, ranks);
+            break;
+        case SIM_SPATIAL:
+            draw_spatial(s, w, ranks);
+            break;
+        }
+        cbox_push(w->cb, ranks, s->depth);
+    }
+
+    cand_t winner = tab_run(w->tab, w->cb, NULL);
+    ++w->wins[winner == CAND_NONE ? config->candidates : winner];
+}
+
+static void run_task(void* ctx, size_t task, size_t worker)
+{
+    struct sim* s = ctx;
+    size_t first  = task * TRIALS_PER_TASK;
+    size_t end    = first + TRIALS_PER_TASK;
+    if (end > s->config->trials) {
+        end = s->config->trials;
+    }
+
+    for (size_t trial = first; trial < end; ++trial) {
+        run_trial(s, &s->workers[worker], trial);
+    }
+}
+
+static bool valid_config(const struct sim_config* config, size_t depth)
+{
+    if (config->candidates == 0 ||
+            config->candidates > CBOX_MAX_CANDIDATES ||
+            depth > MAX_CANDIDATES || depth > config->candidates) {
+        return false;
+    }
+
+    switch (config->model) {
+    case SIM_IMPARTIAL:
+        return true;
+    case SIM_PLACKETT_LUCE:
+        if (config->weights != NULL) {
+            for (size_t c = 0; c < config->candidates; ++c) {
+                if (!(config->weights[c] > 0)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    case SIM_SPATIAL:
+        return config->dimensions >= 1 &&
+               config->dimensions <= SIM_MAX_DIMENSIONS;
+    }
+
+    return false;
+}
+
+bool sim_run(const struct sim_config* config, size_t* wins)
+{
+    size_t depth = config->depth ? config->depth : config->candidates;
+    if (!valid_config(config, depth)) {
+        return false;
+    }
+
+    size_t n = config->candidates;
+    struct sim_config equal;
+    if (config->model == SIM_PLACKETT_LUCE && config->weights == NULL) {
+        equal       = *config;
+        equal.model = SIM_IMPARTIAL;
+        config      = &equal;
+    }
+
+    size_t nworkers = config->workers ? config->workers
+                                      : pool_default_workers();
+    struct sim s = {
+        .config  = config,
+        .depth   = depth,
+        .workers = mallocb(nworkers * sizeof *s.workers, "sim_run"),
+    };
+
+    char name[32];
+    for (size_t i = 0; i < nworkers; ++i) {
+        struct worker* w = &s.workers[i];
+        w->cb  = cbox_create();
+        w->tab = tab_create();
+        for (size_t c = 0; c < n; ++c) {
+            snprintf(name, sizeof name, "C%zu", c);
+            cbox_intern(w->cb, name);
+        }
+        w->perm   = mallocb(n * sizeof *w->perm, "sim_run");
+        w->weight = mallocb(n * sizeof *w->weight, "sim_run");
+        w->dist   = mallocb(n * sizeof *w->dist, "sim_run");
+        w->where  = mallocb(n * SIM_MAX_DIMENSIONS * sizeof *w->where,
+                            "sim_run");
+        w->wins   = callocb(n + 1, sizeof *w->wins, "sim_run");
+    }
+
+    size_t ntasks = (config->trials + TRIALS_PER_TASK - 1) / TRIALS_PER_TASK;
+    pool_run(nworkers, ntasks, run_task, &s);
+
+    memset(wins, 0, (n + 1) * sizeof *wins);
+    for (size_t i = 0; i < nworkers; ++i) {
+        struct worker* w = &s.workers[i];
+        for (size_t c = 0; c <= n; ++c) {
+            wins[c] += w->wins[c];
+        }
+        cbox_destroy(w->cb);
+        tab_destroy(w->tab);
+        free(w->perm);
+        free(w->weight);
+        free(w->dist);
+        free(w->where);
+        free(w->wins);
+    }
+    free(s.workers);
+
+    return true;
+}
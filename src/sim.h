@@ -0,0 +1,82 @@
+#pragma once
+
+// Monte Carlo election simulation.
+//
+// `sim_run` draws many random elections from a preference model and
+// tabulates each one in process. Ballots are sampled straight into a
+// compact ballot box (cbox.h) and counted with a tabulator
+// (tabulate.h); each worker thread reuses one of each from trial to
+// trial, so after the first few trials no trial allocates.
+//
+// Every trial seeds its own random number generator from the
+// configured seed and the trial number, so the results depend only on
+// the configuration, not on the number of threads or how trials were
+// scheduled.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// How voters' rankings are drawn.
+enum sim_model
+{
+    // Impartial culture: every ranking equally likely.
+    SIM_IMPARTIAL,
+
+    // Plackett-Luce: each next choice is drawn from the candidates not
+    // yet ranked, with probability proportional to `weights`.
+    SIM_PLACKETT_LUCE,
+
+    // Spatial: candidates and voters get uniformly random positions in
+    // the unit cube of `dimensions` dimensions (candidates once per
+    // trial), and each voter ranks candidates from nearest to farthest.
+    SIM_SPATIAL,
+};
+
+struct sim_config
+{
+    enum sim_model model;
+
+    // The number of candidates; at least 1.
+    size_t candidates;
+
+    // The number of ballots in each election.
+    size_t voters;
+
+    // The number of elections to simulate.
+    size_t trials;
+
+    // How many candidates each voter ranks; 0 means all of them. At
+    // most MAX_CANDIDATES.
+    size_t depth;
+
+    // For SIM_PLACKETT_LUCE: `candidates` positive weights, or NULL for
+    // equal weights (which is the same as SIM_IMPARTIAL).
+    const double* weights;
+
+    // For SIM_SPATIAL: the number of dimensions, from 1 to
+    // SIM_MAX_DIMENSIONS.
+    size_t dimensions;
+
+    uint64_t seed;
+
+    // Worker threads to use; 0 for the default (see pool.h).
+    size_t workers;
+};
+
+#define SIM_MAX_DIMENSIONS 8
+
+// Runs the simulation described by `config`. On return, `wins[c]` is
+// the number of trials that candidate `c` won, for each `c <
+// config->candidates`, and `wins[config->candidates]` is the number of
+// trials with no winner (which happens only with no voters).
+//
+// OWNERSHIP:
+//  - Borrows both arguments transiently; `wins` must have room for
+//    `config->candidates + 1` counts.
+//
+// ERRORS:
+//  - Returns false, without running anything, if the configuration is
+//    invalid.
+//  - Exits with code 1 if memory cannot be allocated.
+bool sim_run(const struct sim_config* config, size_t* wins);
@@ -0,0 +1,741 @@
+#include "tabulate.h"
+#include "helpers.h"
+#include "tally.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// End of a pile.
+#define PILE_END UINT32_MAX
+
+// A `tabulator_t` (defined in `tabulate.h`) is a pointer to a
+// heap-allocated `struct tabulator`. While a count is in progress
+// (after `tab_start`), with `n = cbox_candidates(cb)`:
+//
+//  - `out[c]` says whether candidate `c < n` is eliminated or
+//    withdrawn (`withdrawn[c]`); `order[0 .. neliminated)` lists the
+//    eliminated ones in order.
+//
+//  - Ballot `i` currently counts for the candidate at position
+//    `cursor[i]` of its ranking, or is exhausted if `cursor[i]` equals
+//    its length. Every non-exhausted ballot is on the pile of its
+//    candidate: the singly linked list starting at `pile[c]` and
+//    continuing through `next[i]`.
+//
+//  - `counts[c]` is the size of `c`'s pile, `last[c]` is one more
+//    than the largest ballot number on it (0 if empty), and `total` is
+//    the sum of `counts`. `tally` holds the same counts and `last`
+//    values, to pick each round's leader and loser.
+//
+//  - The tallies at the start of each of the `nrounds` rounds so far
+//    (always `neliminated + 1`) are kept as deltas: round `k`'s entries
+//    `hist[round_start[k] .. round_start[k + 1])` give the tallies that
+//    changed since round `k - 1` (for round 0, every nonzero one), and
+//    `round_total[k]` its total. `tab_append` uses them to check the
+//    earlier rounds against new ballots, recording the combined history
+//    in the `spare` buffers and then swapping them in.
+//
+//  - `changed` lists candidates whose tallies changed in the current
+//    transfer, with `mark` set for each; `mark` is otherwise all false.
+//    `new_*` and `old_*` are scratch space for `tab_append`.
+//
+//  - If `group` is non-NULL (see `tab_set_groups`), the tallies are
+//    also kept by group: `gcount[g * n + c]` is the number of ballots
+//    in group `g` on `c`'s pile. `ghist` and `ground_start` hold their
+//    history just as `hist` and `round_start` do the overall tallies,
+//    and `gchanged` and `gmark` play the part of `changed` and `mark`,
+//    listing cells of `gcount`.
+//
+//  - `rules` are those last set with `tab_set_rules`. With
+//    `rules.rank`, `tally` holds each candidate's rank in place of its
+//    `last` value, so that the tally breaks ties by rank.
+//
+// The arrays are sized by `cand_cap` and `ballot_cap` and only grow.
+struct tabulator
+{
+    cbox_t    cb;
+    size_t    ncand;
+    size_t    nballots;
+
+    size_t*   counts;
+    size_t*   last;
+    bool*     out;
+    bool*     withdrawn;
+    uint32_t* pile;
+    cand_t*   order;
+    cand_t*   changed;
+    bool*     mark;
+    size_t*   old_count;
+    size_t*   old_last;
+    size_t*   new_count;
+    size_t*   new_last;
+    uint32_t* new_pile;
+    size_t*   round_start;
+    size_t*   round_total;
+    size_t    cand_cap;
+
+    uint32_t* cursor;
+    uint32_t* next;
+    size_t    ballot_cap;
+
+    struct tab_change* hist;
+    size_t    hist_len;
+    size_t    hist_cap;
+    struct tab_change* spare;
+    size_t    spare_cap;
+    size_t*   spare_start;
+
+    const uint32_t* group;
+    size_t    ngroups;
+    size_t*   gcount;
+    bool*     gmark;
+    size_t*   gchanged;
+    size_t    ngchanged;
+    size_t    gcell_cap;
+    struct tab_group_change* ghist;
+    size_t    ghist_len;
+    size_t    ghist_cap;
+    size_t*   ground_start;
+
+    tally_t   tally;
+    struct tab_rules rules;
+    size_t    total;
+    size_t    neliminated;
+    size_t    nrounds;
+    bool      done;
+    cand_t    winner;
+};
+
+tabulator_t tab_create(void)
+{
+    tabulator_t tab = mallocb(sizeof *tab, "tab_create");
+    memset(tab, 0, sizeof *tab);
+    tab->tally  = tally_create();
+    tab->done   = true;
+    tab->winner = CAND_NONE;
+    return tab;
+}
+
+void tab_destroy(tabulator_t tab)
+{
+    if (tab == NULL) {
+        return;
+    }
+
+    free(tab->counts);
+    free(tab->last);
+    free(tab->out);
+    free(tab->withdrawn);
+    free(tab->pile);
+    free(tab->order);
+    free(tab->changed);
+    free(tab->mark);
+    free(tab->old_count);
+    free(tab->old_last);
+    free(tab->new_count);
+    free(tab->new_last);
+    free(tab->new_pile);
+    free(tab->round_start);
+    free(tab->spare_start);
+    free(tab->round_total);
+    free(tab->cursor);
+    free(tab->next);
+    free(tab->hist);
+    free(tab->spare);
+    free(tab->gcount);
+    free(tab->gmark);
+    free(tab->gchanged);
+    free(tab->ghist);
+    free(tab->ground_start);
+    tally_destroy(tab->tally);
+    free(tab);
+}
+
+// Makes sure the arrays can hold `ncand` candidates and `nballots`
+// ballots.
+static void reserve(tabulator_t tab, size_t ncand, size_t nballots)
+{
+    // The round history has room for a round even with no candidates.
+    if (ncand > tab->cand_cap || tab->round_start == NULL) {
+        size_t cap = ncand > 0 ? ncand : 1;
+#define GROW(field, n) \
+        tab->field = reallocb(tab->field, (n) * sizeof *tab->field, \
+                              "tab_start")
+        GROW(counts, cap);
+        GROW(last, cap);
+        GROW(out, cap);
+        GROW(withdrawn, cap);
+        GROW(pile, cap);
+        GROW(order, cap);
+        GROW(changed, cap);
+        GROW(mark, cap);
+        GROW(old_count, cap);
+        GROW(old_last, cap);
+        GROW(new_count, cap);
+        GROW(new_last, cap);
+        GROW(new_pile, cap);
+        GROW(round_start, cap + 2);
+        GROW(spare_start, cap + 2);
+        GROW(round_total, cap + 1);
+        GROW(ground_start, cap + 2);
+#undef GROW
+        tab->cand_cap = cap;
+    }
+
+    if (nballots > tab->ballot_cap) {
+        if (nballots >= PILE_END) {
+            exit(4);
+        }
+        size_t cap = nballots;
+        tab->cursor = reallocb(tab->cursor, cap * sizeof *tab->cursor,
+                               "tab_start");
+        tab->next   = reallocb(tab->next, cap * sizeof *tab->next,
+                               "tab_start");
+        tab->ballot_cap = cap;
+    }
+}
+
+// Moves ballot `i` to the first continuing candidate at or after
+// position `pos` of its ranking and adds it to that candidate's pile in
+// `pile`, `counts` and `last`, returning the candidate, or returns
+// `CAND_NONE` if there is none. The caller keeps the total.
+static cand_t place(tabulator_t tab, size_t i, size_t pos,
+                    uint32_t* pile, size_t* counts, size_t* last)
+{
+    size_t len;
+    const cand_t* ranks = cbox_ballot(tab->cb, i, &len);
+    if (tab->rules.depth > 0 && len > tab->rules.depth) {
+        len = tab->rules.depth;
+    }
+
+    while (pos < len && tab->out[ranks[pos]]) {
+        ++pos;
+    }
+
+    tab->cursor[i] = (uint32_t) pos;
+    if (pos == len) {
+        return CAND_NONE;
+    }
+
+    cand_t c = ranks[pos];
+    tab->next[i] = pile[c];
+    pile[c] = (uint32_t) i;
+    ++counts[c];
+    if (last[c] < i + 1) {
+        last[c] = i + 1;
+    }
+    return c;
+}
+
+// Adds `c` to the `changed` list (once).
+static size_t note_changed(tabulator_t tab, size_t nchanged, cand_t c)
+{
+    if (!tab->mark[c]) {
+        tab->mark[c] = true;
+        tab->changed[nchanged++] = c;
+    }
+    return nchanged;
+}
+
+// Makes room for the group tallies and clears them.
+static void reset_groups(tabulator_t tab)
+{
+    size_t cells = tab->ngroups * tab->ncand;
+    if (cells > tab->gcell_cap || tab->gcount == NULL) {
+        size_t cap = cells > 0 ? cells : 1;
+        tab->gcell_cap = cap;
+        tab->gcount    = reallocb(tab->gcount, cap * sizeof *tab->gcount,
+                                  "tab_start");
+        tab->gmark     = reallocb(tab->gmark, cap * sizeof *tab->gmark,
+                                  "tab_start");
+        tab->gchanged  = reallocb(tab->gchanged,
+                                  cap * sizeof *tab->gchanged,
+                                  "tab_start");
+    }
+    memset(tab->gcount, 0, cells * sizeof *tab->gcount);
+    memset(tab->gmark, 0, cells * sizeof *tab->gmark);
+    tab->ngchanged = 0;
+    tab->ghist_len = 0;
+}
+
+// Adds `delta` (+1 or -1) to the tally of ballot `i`'s group for `c`.
+static void group_add(tabulator_t tab, size_t i, cand_t c, int delta)
+{
+    size_t cell = (size_t) tab->group[i] * tab->ncand + c;
+    tab->gcount[cell] += (size_t) delta;
+    if (!tab->gmark[cell]) {
+        tab->gmark[cell] = true;
+        tab->gchanged[tab->ngchanged++] = cell;
+    }
+}
+
+// Appends a group history entry for each changed cell (clearing their
+// marks) as the start of round `nrounds`.
+static void record_group_round(tabulator_t tab)
+{
+    size_t n = tab->ngchanged;
+    if (tab->ghist_len + n > tab->ghist_cap) {
+        size_t cap = 2 * tab->ghist_cap;
+        tab->ghist_cap = tab->ghist_len + n > cap ? tab->ghist_len + n : cap;
+        tab->ghist = reallocb(tab->ghist,
+                              tab->ghist_cap * sizeof *tab->ghist,
+                              "tab_round");
+    }
+
+    tab->ground_start[tab->nrounds] = tab->ghist_len;
+    for (size_t j = 0; j < n; ++j) {
+        size_t cell = tab->gchanged[j];
+        tab->gmark[cell] = false;
+        tab->ghist[tab->ghist_len++] = (struct tab_group_change) {
+            (uint32_t) (cell / tab->ncand), (cand_t) (cell % tab->ncand),
+            tab->gcount[cell]
+        };
+    }
+    tab->ground_start[tab->nrounds + 1] = tab->ghist_len;
+    tab->ngchanged = 0;
+}
+
+static void reserve_hist(struct tab_change** hist, size_t* cap, size_t n)
+{
+    if (n > *cap) {
+        *cap  = n > 2 * *cap ? n : 2 * *cap;
+        *hist = reallocb(*hist, *cap * sizeof **hist, "tab_round");
+    }
+}
+
+// Appends a history entry for each candidate in `changed[0 .. n)`
+// (clearing their marks) as the start of a new round, with tallies
+// taken from `counts` and `last` and the given total, and updates
+// `tally` to match.
+static void record_round(tabulator_t tab, size_t n, const size_t* counts,
+                         const size_t* last, size_t total)
+{
+    reserve_hist(&tab->hist, &tab->hist_cap, tab->hist_len + n);
+
+    tab->round_start[tab->nrounds] = tab->hist_len;
+    for (size_t j = 0; j < n; ++j) {
+        cand_t c = tab->changed[j];
+        tab->mark[c] = false;
+        tally_set(tab->tally, c, counts[c],
+                  tab->rules.rank ? tab->rules.rank[c] : last[c]);
+        tab->hist[tab->hist_len++] = (struct tab_change) {
+            c, counts[c], last[c]
+        };
+    }
+    tab->round_total[tab->nrounds] = total;
+    tab->round_start[++tab->nrounds] = tab->hist_len;
+}
+
+// Records the first round: every candidate with votes.
+static void record_first_round(tabulator_t tab)
+{
+    tally_reset(tab->tally, tab->ncand);
+    size_t n = 0;
+    for (size_t c = 0; c < tab->ncand; ++c) {
+        if (tab->counts[c] > 0) {
+            n = note_changed(tab, n, (cand_t) c);
+        }
+    }
+    if (tab->group) {
+        record_group_round(tab);
+    }
+    record_round(tab, n, tab->counts, tab->last, tab->total);
+}
+
+// Eliminates `loser`, moves the ballots on its pile to their next
+// choices, and records the new round.
+static void eliminate(tabulator_t tab, cand_t loser)
+{
+    tab->out[loser] = true;
+    tab->order[tab->neliminated++] = loser;
+
+    uint32_t i = tab->pile[loser];
+    tab->pile[loser]   = PILE_END;
+    tab->total        -= tab->counts[loser];
+    tab->counts[loser] = 0;
+    tab->last[loser]   = 0;
+
+    size_t nchanged = note_changed(tab, 0, loser);
+    while (i != PILE_END) {
+        uint32_t next = tab->next[i];
+        cand_t c = place(tab, i, tab->cursor[i] + 1,
+                         tab->pile, tab->counts, tab->last);
+        if (c != CAND_NONE) {
+            ++tab->total;
+            nchanged = note_changed(tab, nchanged, c);
+        }
+        if (tab->group) {
+            group_add(tab, i, loser, -1);
+            if (c != CAND_NONE) {
+                group_add(tab, i, c, 1);
+            }
+        }
+        i = next;
+    }
+
+    if (tab->group) {
+        record_group_round(tab);
+    }
+    record_round(tab, nchanged, tab->counts, tab->last, tab->total);
+}
+
+void tab_set_rules(tabulator_t tab, const struct tab_rules* rules)
+{
+    if (rules) {
+        tab->rules = *rules;
+    } else {
+        tab->rules = (struct tab_rules) { 0, NULL };
+    }
+}
+
+void tab_set_groups(tabulator_t tab, const uint32_t* group,
+                    size_t ngroups)
+{
+    tab->group   = group;
+    tab->ngroups = ngroups;
+}
+
+void tab_start(tabulator_t tab, cbox_t cb, const bool* withdrawn)
+{
+    tab_resume(tab, cb, withdrawn, NULL, 0);
+}
+
+void tab_resume(tabulator_t tab, cbox_t cb, const bool* withdrawn,
+                const cand_t* order, size_t neliminated)
+{
+    size_t ncand    = cbox_candidates(cb);
+    size_t nballots = cbox_size(cb);
+    reserve(tab, ncand, nballots);
+
+    tab->cb          = cb;
+    tab->ncand       = ncand;
+    tab->nballots    = nballots;
+    tab->total       = 0;
+    tab->neliminated = 0;
+    tab->nrounds     = 0;
+    tab->hist_len    = 0;
+    tab->done        = false;
+    tab->winner      = CAND_NONE;
+
+    for (size_t c = 0; c < ncand; ++c) {
+        tab->counts[c]    = 0;
+        tab->last[c]      = 0;
+        tab->withdrawn[c] = withdrawn ? withdrawn[c] : false;
+        tab->out[c]       = tab->withdrawn[c];
+        tab->mark[c]      = false;
+        tab->pile[c]      = PILE_END;
+    }
+
+    if (tab->group) {
+        reset_groups(tab);
+    }
+    for (size_t i = 0; i < nballots; ++i) {
+        cand_t c = place(tab, i, 0, tab->pile, tab->counts, tab->last);
+        if (c != CAND_NONE) {
+            ++tab->total;
+            if (tab->group) {
+                group_add(tab, i, c, 1);
+            }
+        }
+    }
+    record_first_round(tab);
+
+    // Replaying the eliminations moves each ballot no more often than
+    // the original count did, and rebuilds the round history.
+    for (size_t k = 0; k < neliminated; ++k) {
+        eliminate(tab, order[k]);
+    }
+}
+
+bool tab_round(tabulator_t tab)
+{
+    if (tab->done) {
+        return false;
+    }
+
+    cand_t leader = tally_max(tab->tally);
+    if (leader == CAND_NONE || 2 * tab->counts[leader] > tab->total) {
+        tab->winner = leader;
+        tab->done   = true;
+        return false;
+    }
+
+    eliminate(tab, tally_min(tab->tally));
+    return true;
+}
+
+// Sets `old_count` and `old_last` to the tallies of the earlier
+// ballots at the start of round `k`, given those for round `k - 1`,
+// from the history in `hist` and `start`, and adds the candidates that
+// changed to the `changed` list.
+static size_t replay_round(tabulator_t tab, const struct tab_change* hist,
+                           const size_t* start, size_t k, size_t nchanged)
+{
+    for (size_t j = start[k]; j < start[k + 1]; ++j) {
+        tab->old_count[hist[j].cand] = hist[j].count;
+        tab->old_last[hist[j].cand]  = hist[j].last;
+        nchanged = note_changed(tab, nchanged, hist[j].cand);
+    }
+    return nchanged;
+}
+
+size_t tab_append(tabulator_t tab, cbox_t cb)
+{
+    size_t from      = tab->nballots;
+    size_t nballots  = cbox_size(cb);
+    size_t old_ncand = tab->ncand;
+    size_t ncand     = cbox_candidates(cb);
+    size_t rounds    = tab->neliminated;
+    reserve(tab, ncand, nballots);
+
+    for (size_t c = old_ncand; c < ncand; ++c) {
+        tab->withdrawn[c] = false;
+        tab->mark[c]      = false;
+        tab->pile[c]      = PILE_END;
+    }
+    tab->cb       = cb;
+    tab->ncand    = ncand;
+    tab->nballots = nballots;
+
+    // Back to the first round's continuing candidates.
+    for (size_t c = 0; c < ncand; ++c) {
+        tab->out[c]       = tab->withdrawn[c];
+        tab->counts[c]    = 0;
+        tab->last[c]      = 0;
+        tab->old_count[c] = 0;
+        tab->old_last[c]  = 0;
+        tab->new_count[c] = 0;
+        tab->new_last[c]  = 0;
+        tab->new_pile[c]  = PILE_END;
+    }
+
+    // Count the new ballots on piles of their own.
+    size_t new_total = 0;
+    for (size_t i = from; i < nballots; ++i) {
+        if (place(tab, i, 0, tab->new_pile, tab->new_count, tab->new_last)
+                != CAND_NONE) {
+            ++new_total;
+        }
+    }
+
+    // The old history becomes the spare, and the combined one is
+    // recorded in its place.
+    struct tab_change* old_hist = tab->hist;
+    size_t*            old_start = tab->round_start;
+    size_t             old_cap   = tab->hist_cap;
+    tab->hist         = tab->spare;
+    tab->hist_cap     = tab->spare_cap;
+    tab->round_start  = tab->spare_start;
+    tab->spare        = old_hist;
+    tab->spare_cap    = old_cap;
+    tab->spare_start  = old_start;
+    tab->hist_len     = 0;
+    tab->nrounds      = 0;
+
+    // Walk the earlier rounds, combining the old tallies with those of
+    // the new ballots in `counts` and `last`, until a round whose
+    // elimination no longer holds (or the current round).
+    size_t k        = 0;
+    size_t nchanged = 0;
+    size_t total;
+    for (;;) {
+        nchanged = replay_round(tab, old_hist, old_start, k, nchanged);
+        if (k == 0) {
+            // Candidates that only the new ballots lead.
+            for (size_t c = 0; c < ncand; ++c) {
+                if (tab->new_count[c] > 0) {
+                    nchanged = note_changed(tab, nchanged, (cand_t) c);
+                }
+            }
+        }
+        for (size_t j = 0; j < nchanged; ++j) {
+            cand_t c = tab->changed[j];
+            tab->counts[c] = tab->old_count[c] + tab->new_count[c];
+            tab->last[c]   = tab->new_count[c] > 0 ? tab->new_last[c]
+                                                   : tab->old_last[c];
+        }
+
+        total = tab->round_total[k] + new_total;
+        if (k == 0) {
+            tally_reset(tab->tally, ncand);
+        }
+        record_round(tab, nchanged, tab->counts, tab->last, total);
+
+        if (k == rounds) {
+            break;
+        }
+
+        cand_t loser  = tab->order[k];
+        cand_t leader = tally_max(tab->tally);
+        if (leader == CAND_NONE || 2 * tab->counts[leader] > total ||
+                tally_min(tab->tally) != loser) {
+            break;
+        }
+
+        // Eliminate `loser` again, moving only the new ballots.
+        tab->out[loser] = true;
+        uint32_t i = tab->new_pile[loser];
+        tab->new_pile[loser]  = PILE_END;
+        new_total            -= tab->new_count[loser];
+        tab->new_count[loser] = 0;
+        tab->new_last[loser]  = 0;
+        nchanged = note_changed(tab, 0, loser);
+        while (i != PILE_END) {
+            uint32_t next = tab->next[i];
+            cand_t c = place(tab, i, tab->cursor[i] + 1, tab->new_pile,
+                             tab->new_count, tab->new_last);
+            if (c != CAND_NONE) {
+                ++new_total;
+                nchanged = note_changed(tab, nchanged, c);
+            }
+            i = next;
+        }
+        ++k;
+    }
+
+    tab->neliminated = k;
+    tab->total       = total;
+    tab->done        = false;
+    tab->winner      = CAND_NONE;
+
+    if (k == rounds) {
+        // Every elimination still holds, and `counts` and `last` are
+        // this round's tallies: just move the new ballots onto the main
+        // piles.
+        for (size_t c = 0; c < ncand; ++c) {
+            uint32_t i = tab->new_pile[c];
+            while (i != PILE_END) {
+                uint32_t next = tab->next[i];
+                tab->next[i] = tab->pile[c];
+                tab->pile[c] = i;
+                i = next;
+            }
+        }
+    } else {
+        // Candidates `order[k ..]` are back in, so re-place every
+        // ballot among this round's continuing candidates.
+        tab->total = 0;
+        for (size_t c = 0; c < ncand; ++c) {
+            tab->counts[c] = 0;
+            tab->last[c]   = 0;
+            tab->pile[c]   = PILE_END;
+        }
+        for (size_t i = 0; i < nballots; ++i) {
+            if (place(tab, i, 0, tab->pile, tab->counts, tab->last)
+                    != CAND_NONE) {
+                ++tab->total;
+            }
+        }
+    }
+
+    // The group tallies are not kept through the steps above, so they
+    // are counted afresh, with the eliminations that held.
+    if (tab->group) {
+        tab_resume(tab, cb, tab->withdrawn, tab->order, k);
+    }
+
+    return k;
+}
+
+cand_t tab_run(tabulator_t tab, cbox_t cb, const bool* withdrawn)
+{
+    tab_start(tab, cb, withdrawn);
+    while (tab_round(tab)) {
+        continue;
+    }
+    return tab->winner;
+}
+
+bool tab_done(tabulator_t tab)
+{
+    return tab->done;
+}
+
+cand_t tab_winner(tabulator_t tab)
+{
+    return tab->winner;
+}
+
+size_t tab_count(tabulator_t tab, cand_t c)
+{
+    return tab->counts[c];
+}
+
+size_t tab_total(tabulator_t tab)
+{
+    return tab->total;
+}
+
+size_t tab_eliminations(tabulator_t tab)
+{
+    return tab->neliminated;
+}
+
+cand_t tab_eliminated(tabulator_t tab, size_t k)
+{
+    return tab->order[k];
+}
+
+bool tab_is_out(tabulator_t tab, cand_t c)
+{
+    return tab->out[c];
+}
+
+size_t tab_rounds(tabulator_t tab)
+{
+    return tab->nrounds;
+}
+
+size_t tab_round_total(tabulator_t tab, size_t r)
+{
+    return tab->round_total[r];
+}
+
+const struct tab_change* tab_round_changes(tabulator_t tab, size_t r,
+                                           size_t* n)
+{
+    *n = tab->round_start[r + 1] - tab->round_start[r];
+    return tab->hist + tab->round_start[r];
+}
+
+const struct tab_group_change* tab_round_group_changes(tabulator_t tab,
+                                                      size_t r, size_t* n)
+{
+    if (tab->group == NULL) {
+        *n = 0;
+        return NULL;
+    }
+    *n = tab->ground_start[r + 1] - tab->ground_start[r];
+    return tab->ghist + tab->ground_start[r];
+}
+
+cand_t tab_pick_max(size_t n, const size_t* counts, const size_t* last)
+{
+    cand_t best = CAND_NONE;
+    for (size_t c = 0; c < n; ++c) {
+        if (counts[c] == 0) {
+            continue;
+        }
+        if (best == CAND_NONE || counts[c] > counts[best] ||
+                (counts[c] == counts[best] && last[c] > last[best])) {
+            best = (cand_t) c;
+        }
+    }
+    return best;
+}
+
+cand_t tab_pick_min(size_t n, const size_t* counts, const size_t* last)
+{
+    cand_t best = CAND_NONE;
+    for (size_t c = 0; c < n; ++c) {
+        if (counts[c] == 0) {
+            continue;
+        }
+        if (best == CAND_NONE || counts[c] < counts[best] ||
+                (counts[c] == counts[best] && last[c] < last[best])) {
+            best = (cand_t) c;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+// An IRV tabulator for compact ballot boxes (see cbox.h).
+//
+// A `tabulator_t` holds all the scratch state for one count: the
+// current tallies, the eliminated set, and each ballot's current rank.
+// It borrows the ballot box and never modifies it, so any number of
+// tabulators may count the same box at once. Reusing a tabulator for
+// another count of the same size allocates nothing.
+//
+// Rather than recounting every ballot each round, the tabulator keeps
+// each candidate's ballots on a "pile"; eliminating a candidate moves
+// only the ballots on its pile to their next choices. It also keeps
+// each round's tallies, as deltas from the round before, so that
+// ballots added later can be counted without recounting the rest (see
+// `tab_append`). Each round's leader and loser come from a `tally_t`
+// (tally.h), so a round with many candidates costs O(log n) per
+// candidate whose tally changed rather than a scan of them all.
+//
+// Results match `get_irv_winner`, including its tie-breaking: in each
+// round, candidates rank in the order `bb_count` would first add them
+// to its `vote_count_t`. Since `bb_count` walks the ballots newest
+// first, that is the order of the *last* (highest-numbered) ballot that
+// each candidate leads. So among tied candidates, `vc_max` picks the
+// one whose last ballot is latest, and `vc_min` the one whose last
+// ballot is earliest.
+
+#include "cbox.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct tabulator* tabulator_t;
+
+// One entry of the round history: candidate `cand`'s tally (`count`,
+// and `last` as for `tab_pick_max`) at the start of some round.
+struct tab_change
+{
+    cand_t cand;
+    size_t count;
+    size_t last;
+};
+
+// One entry of the group round history: the tally of group `group`'s
+// ballots for candidate `cand` at the start of some round.
+struct tab_group_change
+{
+    uint32_t group;
+    cand_t   cand;
+    size_t   count;
+};
+
+// Departures from `get_irv_winner`'s rules, for what-if counts (see
+// scenario.h). The zero value means none.
+struct tab_rules
+{
+    // If nonzero, only the first `depth` choices on each ballot count;
+    // a ballot is exhausted once they are all out.
+    size_t depth;
+
+    // If non-NULL, ties are broken by rank instead of by ballot order:
+    // among tied candidates, the leader is the one with the highest
+    // `rank[c]` and the loser the one with the lowest. It has an
+    // element for every candidate in the box, and the ranks should be
+    // distinct.
+    const size_t* rank;
+};
+
+// Creates a new tabulator with no count in progress.
+//
+// OWNERSHIP:
+//  - The caller owns the result and must free it with `tab_destroy`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+tabulator_t tab_create(void);
+
+// Frees `tab`. `tab` may be NULL.
+//
+// OWNERSHIP:
+//  - Takes ownership of `tab`.
+void tab_destroy(tabulator_t tab);
+
+// Sets the rules for counts started (or appended to) from now on, or
+// restores the usual ones if `rules` is NULL. Until the first call,
+// the rules are the usual ones.
+//
+// OWNERSHIP:
+//  - Borrows `rules` transiently, and `rules->rank` until the rules
+//    next change; while it is set, `tab_append` may not add
+//    candidates.
+void tab_set_rules(tabulator_t tab, const struct tab_rules* rules);
+
+// Makes counts started from now on also keep each round's tallies
+// broken down by group, or stops them if `group` is NULL. `group[i]`
+// (less than `ngroups`) is the group of ballot `i`, and must be given
+// for every ballot the count will see (see groups.h).
+//
+// The group tallies are kept as ballots are placed and moved, so they
+// cost little beyond the count itself: memory for `ngroups` tallies of
+// each candidate, and a history entry per group tally that changes in
+// a round. `tab_append`, however, counts the group tallies afresh.
+//
+// OWNERSHIP:
+//  - Borrows `group` until the groups next change; when ballots are
+//    appended, call this again with an array that covers them before
+//    `tab_append`.
+void tab_set_groups(tabulator_t tab, const uint32_t* group,
+                    size_t ngroups);
+
+// Starts a new count of `cb` by counting every ballot's first choice.
+// If `withdrawn` is non-NULL, then it has `cbox_candidates(cb)`
+// elements, and each candidate `c` with `withdrawn[c]` is treated as
+// eliminated before the count begins.
+//
+// OWNERSHIP:
+//  - Borrows `withdrawn` transiently.
+//  - Borrows `cb` until the count finishes or the next `tab_start`;
+//    `cb` must not be modified during that time.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+void tab_start(tabulator_t tab, cbox_t cb, const bool* withdrawn);
+
+// Picks up a count of `cb` that had already eliminated the
+// `neliminated` candidates in `order` (as reported by `tab_eliminated`
+// from an earlier count), by replaying those eliminations without
+// deciding them. The count continues exactly as the earlier one would
+// have.
+//
+// OWNERSHIP:
+//  - As for `tab_start`; `order` is borrowed transiently.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+void tab_resume(tabulator_t tab, cbox_t cb, const bool* withdrawn,
+                const cand_t* order, size_t neliminated);
+
+// Brings the count in `tab` up to date after ballots (and perhaps
+// candidates) have been added to the end of its box, which is now
+// `cb`: either the same `cbox_t` or a copy of it with the additions
+// (such as one resumed from a checkpoint). New candidates are not
+// withdrawn.
+//
+// Only the new ballots are counted and moved: the tabulator keeps the
+// tallies of every earlier round, checks each earlier elimination
+// against the combined tallies, and keeps the eliminations up to the
+// first one that no longer holds. If they all hold, the count carries
+// on from the current round; otherwise every ballot is placed afresh
+// for the first round that changed, without recounting the rounds
+// before it. Either way, the count is left unfinished, to be continued
+// with `tab_round`; it ends as a fresh count of `cb` would.
+//
+// Returns the number of earlier eliminations that still hold.
+//
+// OWNERSHIP:
+//  - As for `tab_start`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+size_t tab_append(tabulator_t tab, cbox_t cb);
+
+// Finishes the current round: if some candidate has a majority of the
+// continuing ballots (or none are left), records the winner and
+// returns false; otherwise eliminates the weakest candidate, transfers
+// its ballots, and returns true.
+bool tab_round(tabulator_t tab);
+
+// Runs `tab_start` and then `tab_round` to completion, returning the
+// winner, or `CAND_NONE` if no ballot ranks anyone.
+cand_t tab_run(tabulator_t tab, cbox_t cb, const bool* withdrawn);
+
+// Returns whether the current count has finished.
+bool tab_done(tabulator_t tab);
+
+// Returns the winner of a finished count, or `CAND_NONE` if there
+// were no votes or the count has not finished.
+cand_t tab_winner(tabulator_t tab);
+
+// Returns candidate `c`'s tally in the current round.
+size_t tab_count(tabulator_t tab, cand_t c);
+
+// Returns the number of continuing (non-exhausted) ballots in the
+// current round.
+size_t tab_total(tabulator_t tab);
+
+// Returns the number of candidates eliminated so far, which is one
+// less than the current round number.
+size_t tab_eliminations(tabulator_t tab);
+
+// Returns the `k`th candidate eliminated (counting from 0), which must
+// be less than `tab_eliminations(tab)`.
+cand_t tab_eliminated(tabulator_t tab, size_t k);
+
+// Returns whether candidate `c` has been eliminated or withdrawn.
+bool tab_is_out(tabulator_t tab, cand_t c);
+
+// Returns the number of rounds of the current count so far, including
+// the current one: `tab_eliminations(tab) + 1` once a count has
+// started.
+size_t tab_rounds(tabulator_t tab);
+
+// Returns the number of continuing ballots at the start of round `r`
+// (counting from 0), which must be less than `tab_rounds(tab)`.
+size_t tab_round_total(tabulator_t tab, size_t r);
+
+// Returns the tallies that changed at the start of round `r` (less than
+// `tab_rounds(tab)`) from round `r - 1`, storing their number in `*n`.
+// For round 0 that is every nonzero tally; an eliminated candidate's
+// tally changes to 0 in the round after its elimination. Applying the
+// changes of rounds `0 .. r` in turn to all-zero tallies gives every
+// tally in round `r`, so the tabulator never copies whole tallies.
+//
+// OWNERSHIP:
+//  - The result is borrowed from `tab` and is valid until the count
+//    next changes.
+const struct tab_change* tab_round_changes(tabulator_t tab, size_t r,
+                                           size_t* n);
+
+// Like `tab_round_changes`, but for the group tallies of round `r`
+// (less than `tab_rounds(tab)`). Returns NULL with `*n` set to 0 if
+// the count is not kept by group.
+//
+// OWNERSHIP:
+//  - As for `tab_round_changes`.
+const struct tab_group_change* tab_round_group_changes(tabulator_t tab,
+                                                      size_t r, size_t* n);
+
+// The round rules, shared with engines that keep their own tallies.
+// `counts` and `last` have `n` elements; `last[c]` is one more than the
+// number of the last ballot counted for `c` (0 if none). Candidates
+// with a count of 0 are never picked; if all counts are 0 the result is
+// `CAND_NONE`.
+//
+// `tab_pick_max` picks the highest count, breaking ties as `vc_max`;
+// `tab_pick_min` picks the lowest count, breaking ties as `vc_min`.
+cand_t tab_pick_max(size_t n, const size_t* counts, const size_t* last);
+cand_t tab_pick_min(size_t n, const size_t* counts, const size_t* last);
@@ -0,0 +1,200 @@
+#include "tally.h"
+#include "helpers.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Not in a heap.
+#define NO_POS SIZE_MAX
+
+// The two heaps.
+enum { MAX_HEAP, MIN_HEAP };
+
+// A `tally_t` (defined in `tally.h`) is a pointer to a heap-allocated
+// `struct tally`. For candidates `c < ncand`:
+//
+//  - `count[c]` and `last[c]` are as set; `total` is the sum of
+//    `count`.
+//
+//  - The candidates with nonzero counts, `size` of them, are in both
+//    heaps: `heap[MAX_HEAP][0 .. size)` with the `tally_max` candidate
+//    at the root, and `heap[MIN_HEAP][0 .. size)` with the `tally_min`
+//    candidate at the root. `pos[h][c]` is `c`'s index in heap `h`, or
+//    NO_POS if `count[c]` is 0.
+//
+// The arrays are sized by `cap` and only grow.
+struct tally
+{
+    size_t  ncand;
+    size_t  cap;
+    size_t  size;
+    size_t  total;
+    size_t* count;
+    size_t* last;
+    cand_t* heap[2];
+    size_t* pos[2];
+};
+
+tally_t tally_create(void)
+{
+    tally_t t = callocb(1, sizeof *t, "tally_create");
+    return t;
+}
+
+void tally_destroy(tally_t t)
+{
+    if (t == NULL) {
+        return;
+    }
+
+    free(t->count);
+    free(t->last);
+    for (int h = 0; h < 2; ++h) {
+        free(t->heap[h]);
+        free(t->pos[h]);
+    }
+    free(t);
+}
+
+void tally_reset(tally_t t, size_t ncand)
+{
+    if (ncand > t->cap) {
+        t->count = reallocb(t->count, ncand * sizeof *t->count,
+                            "tally_reset");
+        t->last  = reallocb(t->last, ncand * sizeof *t->last,
+                            "tally_reset");
+        for (int h = 0; h < 2; ++h) {
+            t->heap[h] = reallocb(t->heap[h], ncand * sizeof *t->heap[h],
+                                  "tally_reset");
+            t->pos[h]  = reallocb(t->pos[h], ncand * sizeof *t->pos[h],
+                                  "tally_reset");
+        }
+        t->cap = ncand;
+    }
+
+    t->ncand = ncand;
+    t->size  = 0;
+    t->total = 0;
+    for (size_t c = 0; c < ncand; ++c) {
+        t->count[c]         = 0;
+        t->last[c]          = 0;
+        t->pos[MAX_HEAP][c] = NO_POS;
+        t->pos[MIN_HEAP][c] = NO_POS;
+    }
+}
+
+// Whether `a` belongs above `b` in heap `h`.
+static bool above(tally_t t, int h, cand_t a, cand_t b)
+{
+    if (t->count[a] != t->count[b]) {
+        return (t->count[a] > t->count[b]) == (h == MAX_HEAP);
+    }
+    return (t->last[a] > t->last[b]) == (h == MAX_HEAP);
+}
+
+static void put(tally_t t, int h, size_t i, cand_t c)
+{
+    t->heap[h][i] = c;
+    t->pos[h][c]  = i;
+}
+
+static void sift_up(tally_t t, int h, size_t i)
+{
+    cand_t c = t->heap[h][i];
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!above(t, h, c, t->heap[h][parent])) {
+            break;
+        }
+        put(t, h, i, t->heap[h][parent]);
+        i = parent;
+    }
+    put(t, h, i, c);
+}
+
+static void sift_down(tally_t t, int h, size_t i)
+{
+    cand_t c = t->heap[h][i];
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= t->size) {
+            break;
+        }
+        if (child + 1 < t->size &&
+                above(t, h, t->heap[h][child + 1], t->heap[h][child])) {
+            ++child;
+        }
+        if (!above(t, h, t->heap[h][child], c)) {
+            break;
+        }
+        put(t, h, i, t->heap[h][child]);
+        i = child;
+    }
+    put(t, h, i, c);
+}
+
+// Removes the candidate at index `i` of heap `h`. `size` must already
+// have been decremented.
+static void remove_at(tally_t t, int h, size_t i)
+{
+    cand_t moved = t->heap[h][t->size];
+    t->pos[h][t->heap[h][i]] = NO_POS;
+    if (i == t->size) {
+        return;
+    }
+    put(t, h, i, moved);
+    sift_up(t, h, i);
+    sift_down(t, h, t->pos[h][moved]);
+}
+
+void tally_set(tally_t t, cand_t c, size_t count, size_t last)
+{
+    bool was_in = t->count[c] > 0;
+    t->total   += count - t->count[c];
+    t->count[c] = count;
+    t->last[c]  = last;
+
+    if (count == 0) {
+        if (was_in) {
+            --t->size;
+            remove_at(t, MAX_HEAP, t->pos[MAX_HEAP][c]);
+            remove_at(t, MIN_HEAP, t->pos[MIN_HEAP][c]);
+        }
+        return;
+    }
+
+    for (int h = 0; h < 2; ++h) {
+        if (was_in) {
+            size_t i = t->pos[h][c];
+            sift_up(t, h, i);
+            sift_down(t, h, t->pos[h][c]);
+        } else {
+            put(t, h, t->size, c);
+            sift_up(t, h, t->size);
+        }
+    }
+    if (!was_in) {
+        ++t->size;
+    }
+}
+
+size_t tally_count(tally_t t, cand_t c)
+{
+    return t->count[c];
+}
+
+size_t tally_total(tally_t t)
+{
+    return t->total;
+}
+
+cand_t tally_max(tally_t t)
+{
+    return t->size ? t->heap[MAX_HEAP][0] : CAND_NONE;
+}
+
+cand_t tally_min(tally_t t)
+{
+    return t->size ? t->heap[MIN_HEAP][0] : CAND_NONE;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// A tally of votes per candidate that answers "who leads?" and "who
+// trails?" in O(1) and absorbs each change in O(log n).
+//
+// `vc_max` and `vc_min` (libvc.h) and `tab_pick_max` and `tab_pick_min`
+// (tabulate.h) scan every candidate on every call, which dominates a
+// count with hundreds of candidates. A `tally_t` instead keeps the
+// candidates with votes in two indexed binary heaps, one ordered for
+// each question, and repairs only the changed candidate's position
+// when its count changes.
+//
+// Each candidate `c` has a count and a `last` value, as for
+// `tab_pick_max`; the orderings and tie-breaks are exactly those of
+// `tab_pick_max` and `tab_pick_min`, so a tabulator can switch between
+// them freely.
+
+#include "cbox.h"
+
+#include <stddef.h>
+
+typedef struct tally* tally_t;
+
+// Creates a new, empty tally.
+//
+// OWNERSHIP:
+//  - The caller owns the result and must free it with `tally_destroy`.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+tally_t tally_create(void);
+
+// Frees `t`. `t` may be NULL.
+//
+// OWNERSHIP:
+//  - Takes ownership of `t`.
+void tally_destroy(tally_t t);
+
+// Empties `t` and makes room for candidates `0 .. ncand`, all with a
+// count of 0.
+//
+// ERRORS:
+//  - Exits with code 1 if memory cannot be allocated.
+void tally_reset(tally_t t, size_t ncand);
+
+// Sets candidate `c`'s count and `last` value. `c` must be less than
+// the `ncand` passed to `tally_reset`.
+void tally_set(tally_t t, cand_t c, size_t count, size_t last);
+
+// Returns candidate `c`'s count.
+size_t tally_count(tally_t t, cand_t c);
+
+// Returns the sum of all counts.
+size_t tally_total(tally_t t);
+
+// Returns the candidate `tab_pick_max` would pick: the highest count,
+// ties going to the larger `last`; or `CAND_NONE` if every count is 0.
+cand_t tally_max(tally_t t);
+
+// Returns the candidate `tab_pick_min` would pick: the lowest nonzero
+// count, ties going to the smaller `last`; or `CAND_NONE` if every
+// count is 0.
+cand_t tally_min(tally_t t);
@@ -9,6 +9,7 @@
 #include <ipd.h>
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -25,6 +26,7 @@ static void check_clean_name(const char* name, const char* expected);
 static void test_clean_name(void);
 static void test_ballot_3(void);
 static void test_ballot_with_vc(void);
+static void test_read_ballot(void);
 
 
 ///
@@ -36,6 +38,7 @@ int main(int argc, char* argv[])
     test_clean_name();
     test_ballot_3();
     test_ballot_with_vc();
+    test_read_ballot();
 }
 
 
@@ -108,6 +111,36 @@ static void test_ballot_with_vc(void)
     vc_destroy(count);
 }
 
+static void test_read_ballot(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    // Two ballots, the second without a closing "%".
+    FILE* f = tmpfile();
+    assert(f);
+    fputs("alan turing\nGrace Hopper\n%\nada\n", f);
+    rewind(f);
+
+    ballot_t ballot = read_ballot(f);
+    CHECK(ballot != NULL);
+    if (ballot == NULL) return;
+    CHECK_STRING(ballot_leader(ballot), "ALANTURING");
+    ballot_eliminate(ballot, "ALANTURING");
+    CHECK_STRING(ballot_leader(ballot), "GRACEHOPPER");
+    ballot_destroy(ballot);
+
+    ballot = read_ballot(f);
+    CHECK(ballot != NULL);
+    if (ballot == NULL) return;
+    CHECK_STRING(ballot_leader(ballot), "ADA");
+    ballot_eliminate(ballot, "ADA");
+    CHECK_POINTER(ballot_leader(ballot), NULL);
+    ballot_destroy(ballot);
+
+    CHECK_POINTER(read_ballot(f), NULL);
+    fclose(f);
+}
+
 
 ///
 /// HELPER FUNCTIONS
@@ -8,6 +8,7 @@
 #include <ipd.h>
 
 #include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -25,6 +26,9 @@ static void check_election(const char* expected_winner, ...);
 static void three_candidates_tied(void),
             win_on_second_round(void),
             example_from_wikipedia(void);
+static void one_ballot(void);
+static void no_ballots(void);
+static void read_two_ballots(void);
 
 
 ///
@@ -36,6 +40,9 @@ int main(void)
     three_candidates_tied();
     win_on_second_round();
     example_from_wikipedia();
+    one_ballot();
+    no_ballots();
+    read_two_ballots();
 }
 
 
@@ -80,6 +87,67 @@ static void example_from_wikipedia(void)
             NULL);
 }
 
+// A box of one ballot is counted, and has a candidate eliminated, once.
+static void one_ballot(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    ballot_t ballot = ballot_create();
+    ballot_insert(ballot, strdupb("a", "one_ballot"));
+    ballot_insert(ballot, strdupb("b", "one_ballot"));
+    ballot_box_t bb = empty_ballot_box;
+    bb_insert(&bb, ballot);
+
+    vote_count_t vc = bb_count(bb);
+    CHECK_SIZE(vc_lookup(vc, "A"), 1);
+    CHECK_SIZE(vc_total(vc), 1);
+    vc_destroy(vc);
+
+    bb_eliminate(bb, "A");
+    vc = bb_count(bb);
+    CHECK_SIZE(vc_lookup(vc, "B"), 1);
+    CHECK_SIZE(vc_total(vc), 1);
+    vc_destroy(vc);
+
+    char* winner = get_irv_winner(bb);
+    CHECK_STRING(winner, "B");
+    free(winner);
+    bb_destroy(bb);
+}
+
+static void no_ballots(void)
+{
+    check_election(NULL, NULL);
+
+    // Ballots that rank no one have no winner either.
+    check_election(NULL, "%", "%", NULL);
+}
+
+static void read_two_ballots(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    FILE* f = tmpfile();
+    if (f == NULL) {
+        perror("tmpfile");
+        exit(1);
+    }
+    fputs("a\nb\n%\nb\n%\nb\na\n%\n", f);
+    rewind(f);
+
+    ballot_box_t bb = read_ballot_box(f);
+    vote_count_t vc = bb_count(bb);
+    CHECK_SIZE(vc_lookup(vc, "A"), 1);
+    CHECK_SIZE(vc_lookup(vc, "B"), 2);
+    vc_destroy(vc);
+
+    char* winner = get_irv_winner(bb);
+    CHECK_STRING(winner, "B");
+    free(winner);
+    bb_destroy(bb);
+    fclose(f);
+}
+
 
 ///
 /// HELPER FUNCTIONS YOU SHOULD USE
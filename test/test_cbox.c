@@ -0,0 +1,335 @@
+///
+/// Tests for functions in ../src/cbox.c.
+///
+
+#include "ballot_box.h"
+#include "cbox.h"
+#include "helpers.h"
+
+#include <ipd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Heap allocations are counted with AddressSanitizer's hooks, so the
+// allocation test only runs in sanitized builds (as the CMake ones are).
+// GCC says so with __SANITIZE_ADDRESS__, and Clang with __has_feature.
+#if defined(__SANITIZE_ADDRESS__)
+#define HAVE_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define HAVE_ASAN 1
+#endif
+#endif
+
+#ifdef HAVE_ASAN
+// From <sanitizer/allocator_interface.h>, which not every compiler
+// installs.
+int __sanitizer_install_malloc_and_free_hooks(
+        void (*malloc_hook)(const volatile void*, size_t),
+        void (*free_hook)(const volatile void*));
+#define COUNT_ALLOCATIONS 1
+#else
+#define COUNT_ALLOCATIONS 0
+#endif
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+// Starts counting heap allocations (from zero) and returns the count
+// so far, respectively; the latter returns SIZE_MAX if they cannot be
+// counted.
+static void start_counting(void);
+static size_t stop_counting(void);
+
+static void test_cbox_intern(void);
+static void test_cbox_order(void);
+static void test_cbox_read(void);
+static void test_cbox_spellings(void);
+static void test_cbox_read_allocations(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_cbox_intern();
+    test_cbox_order();
+    test_cbox_read();
+    test_cbox_spellings();
+    test_cbox_read_allocations();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_cbox_intern(void)
+{
+    cbox_t cb = cbox_create();
+
+    CHECK_SIZE(cbox_candidates(cb), 0);
+    CHECK_INT(cbox_find(cb, "A"), CAND_NONE);
+
+    cand_t a = cbox_intern(cb, "A");
+    cand_t b = cbox_intern(cb, "B");
+    CHECK_INT(a, 0);
+    CHECK_INT(b, 1);
+    CHECK_INT(cbox_intern(cb, "A"), a);
+    CHECK_INT(cbox_find(cb, "B"), b);
+    CHECK_STRING(cbox_name(cb, b), "B");
+
+    // Enough names to make the index grow.
+    char name[16];
+    for (int i = 0; i < 200; ++i) {
+        sprintf(name, "N%d", i);
+        CHECK_INT(cbox_intern(cb, name), i + 2);
+    }
+    CHECK_INT(cbox_find(cb, "N0"), 2);
+    CHECK_INT(cbox_find(cb, "N199"), 201);
+
+    cbox_destroy(cb);
+}
+
+static void test_cbox_order(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    ballot_box_t bb = empty_ballot_box;
+    ballot_t ballot = ballot_create();
+    ballot_insert(ballot, strdupb("x", "test_cbox_order"));
+    ballot_insert(ballot, strdupb("y", "test_cbox_order"));
+    ballot_insert(ballot, strdupb("X", "test_cbox_order"));
+    bb_insert(&bb, ballot);
+    ballot = ballot_create();
+    bb_insert(&bb, ballot);
+    ballot = ballot_create();
+    ballot_insert(ballot, strdupb("z", "test_cbox_order"));
+    bb_insert(&bb, ballot);
+
+    cbox_t cb = cbox_from_bb(bb);
+    size_t len;
+    const cand_t* ranks;
+
+    // Input order, with the repeated X dropped.
+    CHECK_SIZE(cbox_size(cb), 3);
+    ranks = cbox_ballot(cb, 0, &len);
+    CHECK_SIZE(len, 2);
+    CHECK_STRING(cbox_name(cb, ranks[0]), "X");
+    CHECK_STRING(cbox_name(cb, ranks[1]), "Y");
+    cbox_ballot(cb, 1, &len);
+    CHECK_SIZE(len, 0);
+    ranks = cbox_ballot(cb, 2, &len);
+    CHECK_SIZE(len, 1);
+    CHECK_STRING(cbox_name(cb, ranks[0]), "Z");
+
+    cbox_destroy(cb);
+    bb_destroy(bb);
+}
+
+static void test_cbox_read(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    // A name longer than the reader's first buffer, an empty line, an
+    // empty ballot, and a last line with no newline.
+    char text[1024] = "Alice\n";
+    for (int i = 0; i < 300; ++i) {
+        strcat(text, i % 50 ? "b" : " ");
+    }
+    strcat(text, "\n\n%\n%\ncarol\n%\nbob\nCarol");
+
+    // The same input read by `read_ballot_box` and `cbox_read`.
+    FILE* f = tmpfile();
+    fputs(text, f);
+    rewind(f);
+    ballot_box_t bb = read_ballot_box(f);
+    cbox_t expected = cbox_from_bb(bb);
+    bb_destroy(bb);
+
+    rewind(f);
+    cbox_t cb = cbox_create();
+    CHECK_SIZE(cbox_read(cb, f), 4);
+    CHECK_SIZE(cbox_size(cb), cbox_size(expected));
+    for (size_t i = 0; i < cbox_size(cb) && i < cbox_size(expected); ++i) {
+        size_t len, expected_len;
+        const cand_t* ranks = cbox_ballot(cb, i, &len);
+        const cand_t* expected_ranks =
+            cbox_ballot(expected, i, &expected_len);
+        CHECK_SIZE(len, expected_len);
+        for (size_t j = 0; j < len && j < expected_len; ++j) {
+            CHECK_STRING(cbox_name(cb, ranks[j]),
+                         cbox_name(expected, expected_ranks[j]));
+        }
+    }
+
+    // One reader can serve several boxes and files.
+    struct cbox_reader r = CBOX_READER_INIT;
+    cbox_t again = cbox_create();
+    rewind(f);
+    while (cbox_read_ballot_into(again, f, &r)) {
+        continue;
+    }
+    rewind(f);
+    CHECK(cbox_read_ballot_into(again, f, &r));
+    CHECK_SIZE(cbox_size(again), 5);
+    CHECK(r.cap > 250);
+    cbox_reader_free(&r);
+    CHECK_POINTER(r.line, NULL);
+
+    cbox_destroy(again);
+    cbox_destroy(cb);
+    cbox_destroy(expected);
+    fclose(f);
+}
+
+// Many spellings of one name, read again and again, and more distinct
+// spellings than the cache holds.
+static void test_cbox_spellings(void)
+{
+    if (MAX_CANDIDATES < 4) return;
+
+    FILE* f = tmpfile();
+    for (int i = 0; i < 3; ++i) {
+        fputs("alice\nALICE!\n a-l-i-c-e \nBob\n%\n", f);
+    }
+    fputs("bob\n\n%\n", f);
+    for (int i = 0; i < 70000; ++i) {
+        fprintf(f, "Bob %d\n%%\n", i);
+    }
+    fputs("Carol\n", f);
+    rewind(f);
+
+    cbox_t cb = cbox_create();
+    CHECK_SIZE(cbox_read(cb, f), 70005);
+    CHECK_SIZE(cbox_candidates(cb), 4);
+
+    cand_t alice = cbox_find(cb, "ALICE");
+    cand_t bob   = cbox_find(cb, "BOB");
+    size_t len;
+    const cand_t* ranks = cbox_ballot(cb, 2, &len);
+    CHECK_SIZE(len, 2);
+    CHECK_INT(ranks[0], alice);
+    CHECK_INT(ranks[1], bob);
+
+    // An empty line names the candidate "".
+    ranks = cbox_ballot(cb, 3, &len);
+    CHECK_SIZE(len, 2);
+    CHECK_INT(ranks[0], bob);
+    CHECK_STRING(cbox_name(cb, ranks[1]), "");
+
+    for (size_t i = 4; i < 70004; ++i) {
+        ranks = cbox_ballot(cb, i, &len);
+        CHECK_SIZE(len, 1);
+        CHECK_INT(ranks[0], bob);
+    }
+    ranks = cbox_ballot(cb, 70004, &len);
+    CHECK_STRING(cbox_name(cb, ranks[0]), "CAROL");
+
+    // The cache outlives clearing the ballots.
+    cbox_clear(cb);
+    rewind(f);
+    CHECK(cbox_read_ballot(cb, f));
+    ranks = cbox_ballot(cb, 0, &len);
+    CHECK_SIZE(len, 2);
+    CHECK_INT(ranks[0], alice);
+    CHECK_INT(ranks[1], bob);
+
+    cbox_destroy(cb);
+    fclose(f);
+}
+
+// Once a box and its reader have seen the names and the longest line,
+// reading the same input again after `cbox_clear` allocates nothing.
+static void test_cbox_read_allocations(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+    if (!COUNT_ALLOCATIONS) {
+        fprintf(stderr, "test_cbox_read_allocations: skipped, since "
+                "allocations are counted only under AddressSanitizer\n");
+        return;
+    }
+
+    static const char* const spellings[] = {
+        "alice", "Alice", " bob", "Bob ", "CAROL", "carol",
+    };
+    FILE* f = tmpfile();
+    for (int i = 0; i < 5000; ++i) {
+        for (int j = 0; j < 1 + i % 3; ++j) {
+            fprintf(f, "%s\n", spellings[(i + 2 * j) % 6]);
+        }
+        fputs("%\n", f);
+    }
+
+    cbox_t cb = cbox_create();
+    rewind(f);
+    CHECK_SIZE(cbox_read(cb, f), 5000);
+    CHECK_SIZE(cbox_candidates(cb), 3);
+
+    cbox_clear(cb);
+    rewind(f);
+    start_counting();
+    size_t nread = cbox_read(cb, f);
+    CHECK_SIZE(stop_counting(), 0);
+    CHECK_SIZE(nread, 5000);
+
+    cbox_destroy(cb);
+    fclose(f);
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+#if COUNT_ALLOCATIONS
+static bool   counting;
+static size_t allocations;
+
+static void count_malloc(const volatile void* ptr, size_t size)
+{
+    (void) ptr;
+    (void) size;
+    if (counting) {
+        ++allocations;
+    }
+}
+
+static void ignore_free(const volatile void* ptr)
+{
+    (void) ptr;
+}
+
+static void start_counting(void)
+{
+    static bool installed = false;
+    if (!installed) {
+        CHECK(__sanitizer_install_malloc_and_free_hooks(count_malloc,
+                                                        ignore_free));
+        installed = true;
+    }
+    allocations = 0;
+    counting    = true;
+}
+
+static size_t stop_counting(void)
+{
+    counting = false;
+    return allocations;
+}
+#else
+static void start_counting(void)
+{
+}
+
+static size_t stop_counting(void)
+{
+    return SIZE_MAX;
+}
+#endif
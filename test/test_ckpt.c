@@ -0,0 +1,451 @@
+///
+/// Tests for functions in ../src/ckpt.c.
+///
+
+#include "cbox.h"
+#include "ckpt.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CKPT_PATH "test_ckpt.ckpt"
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+// Returns a box with candidates A, B, C (ids 0, 1, 2) and the five
+// ballots A, A, B>A, B, C>B, in which C is eliminated and B wins.
+static cbox_t example_box(void);
+
+// Saves `cb` and `tab` to CKPT_PATH, then finds the `len` bytes `find`
+// in the file and overwrites them with `with`.
+static void save_corrupted(cbox_t cb, tabulator_t tab,
+                           const void* find, const void* with, size_t len);
+
+// Sets `name` to a shared memory name unique to this process.
+static void shm_name(char name[64], const char* what);
+
+static void test_round_trip(void);
+static void test_record_round(void);
+static void test_add_after_resume(void);
+static void test_append(void);
+static void test_invalid_file(void);
+static void test_corrupt_file(void);
+static void test_publish(void);
+static void test_republish(void);
+static void test_attach_invalid(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_round_trip();
+    test_record_round();
+    test_add_after_resume();
+    test_append();
+    test_invalid_file();
+    test_corrupt_file();
+    test_publish();
+    test_republish();
+    test_attach_invalid();
+    unlink(CKPT_PATH);
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_round_trip(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    cbox_t cb = example_box();
+    tabulator_t tab = tab_create();
+    tab_start(tab, cb, NULL);
+    CHECK(tab_round(tab));
+    CHECK(ckpt_save(CKPT_PATH, cb, 1234, true, tab));
+
+    ckpt_t ck = ckpt_open(CKPT_PATH);
+    CHECK(ck != NULL);
+    if (ck == NULL) return;
+
+    CHECK_SIZE((size_t) ckpt_input_offset(ck), 1234);
+    CHECK(ckpt_ingest_done(ck));
+    CHECK_SIZE(ckpt_eliminations(ck), 1);
+
+    cbox_t saved = ckpt_cbox(ck);
+    CHECK_SIZE(cbox_candidates(saved), 3);
+    CHECK_SIZE(cbox_size(saved), 5);
+    CHECK_SIZE(cbox_rank_count(saved), 7);
+    CHECK_STRING(cbox_name(saved, 2), "C");
+    CHECK_INT(cbox_find(saved, "B"), 1);
+
+    size_t len;
+    const cand_t* ranks = cbox_ballot(saved, 4, &len);
+    CHECK_SIZE(len, 2);
+    CHECK_INT(ranks[0], 2);
+    CHECK_INT(ranks[1], 1);
+
+    // The resumed count is in the second round, with C's ballot moved.
+    tabulator_t resumed = tab_create();
+    CHECK(ckpt_resume_count(ck, resumed));
+    CHECK_SIZE(tab_eliminations(resumed), 1);
+    CHECK(tab_is_out(resumed, 2));
+    CHECK_SIZE(tab_count(resumed, 1), 3);
+    CHECK(! tab_round(resumed));
+    CHECK_INT(tab_winner(resumed), 1);
+
+    tab_destroy(resumed);
+    ckpt_close(ck);
+    tab_destroy(tab);
+    cbox_destroy(cb);
+}
+
+static void test_record_round(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    cbox_t cb = example_box();
+    CHECK(ckpt_save(CKPT_PATH, cb, -1, true, NULL));
+
+    tabulator_t tab = tab_create();
+    tab_start(tab, cb, NULL);
+    CHECK(tab_round(tab));
+    CHECK(ckpt_record_round(CKPT_PATH, tab));
+
+    ckpt_t ck = ckpt_open(CKPT_PATH);
+    CHECK(ck != NULL);
+    if (ck == NULL) return;
+
+    CHECK_INT((int) ckpt_input_offset(ck), -1);
+    CHECK_SIZE(ckpt_eliminations(ck), 1);
+
+    tabulator_t resumed = tab_create();
+    CHECK(ckpt_resume_count(ck, resumed));
+    CHECK_INT(tab_eliminated(resumed, 0), 2);
+    CHECK_SIZE(tab_total(resumed), 5);
+
+    tab_destroy(resumed);
+    ckpt_close(ck);
+    tab_destroy(tab);
+    cbox_destroy(cb);
+}
+
+static void test_add_after_resume(void)
+{
+    if (MAX_CANDIDATES < 4) return;
+
+    cbox_t cb = example_box();
+    CHECK(ckpt_save(CKPT_PATH, cb, 99, false, NULL));
+    cbox_destroy(cb);
+
+    ckpt_t ck = ckpt_open(CKPT_PATH);
+    CHECK(ck != NULL);
+    if (ck == NULL) return;
+    CHECK(! ckpt_ingest_done(ck));
+
+    // Adding to the mapped box copies it first, and adds a candidate.
+    cbox_t saved = ckpt_cbox(ck);
+    cand_t d = cbox_intern(saved, "D");
+    CHECK_INT(d, 3);
+    cbox_push(saved, (cand_t[]) {d}, 1);
+    cbox_push(saved, (cand_t[]) {d}, 1);
+    CHECK_SIZE(cbox_size(saved), 7);
+    CHECK_STRING(cbox_name(saved, 0), "A");
+
+    // The saved count no longer applies, so it starts over.
+    tabulator_t tab = tab_create();
+    CHECK(ckpt_resume_count(ck, tab));
+    CHECK_SIZE(tab_eliminations(tab), 0);
+    CHECK_SIZE(tab_total(tab), 7);
+    CHECK_SIZE(tab_count(tab, d), 2);
+
+    tab_destroy(tab);
+    ckpt_close(ck);
+}
+
+static void test_append(void)
+{
+    if (MAX_CANDIDATES < 4) return;
+
+    cbox_t cb = example_box();
+    CHECK(ckpt_save(CKPT_PATH, cb, 10, false, NULL));
+    struct stat before, after;
+    CHECK(stat(CKPT_PATH, &before) == 0);
+
+    // New ballots and a new candidate fit in the room left for them,
+    // so the file is added to in place.
+    cand_t d = cbox_intern(cb, "D");
+    cbox_push(cb, (cand_t[]) {d, 0}, 2);
+    cbox_push(cb, (cand_t[]) {d}, 1);
+    CHECK(ckpt_append(CKPT_PATH, cb, 20, false));
+    CHECK(stat(CKPT_PATH, &after) == 0);
+    CHECK(after.st_ino == before.st_ino);
+    CHECK_SIZE((size_t) after.st_size, (size_t) before.st_size);
+
+    ckpt_t ck = ckpt_open(CKPT_PATH);
+    CHECK(ck != NULL);
+    if (ck == NULL) return;
+    CHECK_SIZE((size_t) ckpt_input_offset(ck), 20);
+    CHECK(! ckpt_ingest_done(ck));
+    cbox_t saved = ckpt_cbox(ck);
+    CHECK_SIZE(cbox_candidates(saved), 4);
+    CHECK_STRING(cbox_name(saved, 3), "D");
+    CHECK_SIZE(cbox_size(saved), 7);
+    CHECK_SIZE(cbox_rank_count(saved), 10);
+    size_t len;
+    const cand_t* ranks = cbox_ballot(saved, 5, &len);
+    CHECK_SIZE(len, 2);
+    CHECK_INT(ranks[0], d);
+    CHECK_INT(ranks[1], 0);
+    ckpt_close(ck);
+
+    // Once the room is used up, the file is rewritten with more.
+    for (size_t i = 0; i < 200; ++i) {
+        cbox_push(cb, (cand_t[]) {(cand_t) (i % 4)}, 1);
+    }
+    CHECK(ckpt_append(CKPT_PATH, cb, 30, true));
+    CHECK(stat(CKPT_PATH, &after) == 0);
+    CHECK(after.st_ino != before.st_ino);
+
+    ck = ckpt_open(CKPT_PATH);
+    CHECK(ck != NULL);
+    if (ck == NULL) return;
+    CHECK(ckpt_ingest_done(ck));
+    CHECK_SIZE(cbox_size(ckpt_cbox(ck)), 207);
+    tabulator_t tab = tab_create();
+    CHECK(ckpt_resume_count(ck, tab));
+    CHECK_SIZE(tab_total(tab), 207);
+    CHECK_SIZE(tab_count(tab, d), 52);
+    ckpt_close(ck);
+
+    // A checkpoint with a count is no longer an ingest to add to.
+    CHECK(ckpt_record_round(CKPT_PATH, tab));
+    CHECK(! ckpt_append(CKPT_PATH, cb, 40, true));
+
+    tab_destroy(tab);
+    cbox_destroy(cb);
+}
+
+static void test_invalid_file(void)
+{
+    FILE* f = fopen(CKPT_PATH, "w");
+    fputs("not a checkpoint\n", f);
+    fclose(f);
+
+    CHECK_POINTER(ckpt_open(CKPT_PATH), NULL);
+    CHECK_POINTER(ckpt_open("test_ckpt.missing"), NULL);
+}
+
+static void test_publish(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    char name[64];
+    shm_name(name, "publish");
+    cbox_t cb = example_box();
+    CHECK(ckpt_publish(name, cb));
+    cbox_destroy(cb);
+
+    // Two attachments, each with its own count.
+    ckpt_t one = ckpt_attach(name);
+    ckpt_t two = ckpt_attach(name);
+    CHECK(one != NULL && two != NULL);
+    if (one == NULL || two == NULL) return;
+
+    CHECK(ckpt_ingest_done(one));
+    CHECK_SIZE(ckpt_eliminations(one), 0);
+    CHECK_INT((int) ckpt_input_offset(one), -1);
+
+    cbox_t shared = ckpt_cbox(one);
+    CHECK_SIZE(cbox_size(shared), 5);
+    CHECK_SIZE(cbox_rank_count(shared), 7);
+    CHECK_STRING(cbox_name(shared, 2), "C");
+
+    tabulator_t tab1 = tab_create();
+    tabulator_t tab2 = tab_create();
+    tab_start(tab1, shared, NULL);
+    CHECK(tab_round(tab1));
+    CHECK_INT(tab_run(tab2, ckpt_cbox(two), NULL), 1);
+    CHECK_SIZE(tab_eliminations(tab1), 1);
+    CHECK(! tab_round(tab1));
+    CHECK_INT(tab_winner(tab1), 1);
+
+    // A count with B withdrawn leaves the shared ballots as they were.
+    bool withdrawn[] = {false, true, false};
+    CHECK_INT(tab_run(tab2, ckpt_cbox(two), withdrawn), 0);
+    CHECK_SIZE(tab_count(tab2, 0), 3);
+    size_t len;
+    const cand_t* ranks = cbox_ballot(shared, 2, &len);
+    CHECK_SIZE(len, 2);
+    CHECK_INT(ranks[0], 1);
+
+    // Unpublishing leaves the attachments as they are.
+    CHECK(ckpt_unpublish(name));
+    CHECK_POINTER(ckpt_attach(name), NULL);
+    CHECK(! ckpt_unpublish(name));
+    CHECK_INT(tab_run(tab1, ckpt_cbox(two), NULL), 1);
+
+    tab_destroy(tab2);
+    tab_destroy(tab1);
+    ckpt_close(two);
+    ckpt_close(one);
+}
+
+static void test_republish(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    char name[64];
+    shm_name(name, "republish");
+    cbox_t cb = example_box();
+    CHECK(ckpt_publish(name, cb));
+    ckpt_t old = ckpt_attach(name);
+    CHECK(old != NULL);
+    if (old == NULL) return;
+
+    // Two more ballots for A, so A wins the new box; the old
+    // attachment keeps the old ballots.
+    cbox_push(cb, (cand_t[]) {0}, 1);
+    cbox_push(cb, (cand_t[]) {0}, 1);
+    CHECK(ckpt_publish(name, cb));
+    ckpt_t new = ckpt_attach(name);
+    CHECK(new != NULL);
+    if (new == NULL) return;
+
+    tabulator_t tab = tab_create();
+    CHECK_SIZE(cbox_size(ckpt_cbox(old)), 5);
+    CHECK_INT(tab_run(tab, ckpt_cbox(old), NULL), 1);
+    CHECK_SIZE(cbox_size(ckpt_cbox(new)), 7);
+    CHECK_INT(tab_run(tab, ckpt_cbox(new), NULL), 0);
+
+    tab_destroy(tab);
+    ckpt_close(new);
+    ckpt_close(old);
+    ckpt_unpublish(name);
+    cbox_destroy(cb);
+}
+
+// An object that is not a checkpoint, such as one still being written,
+// cannot be attached.
+// Damage that leaves the sizes right must still be caught, since the
+// tabulator would index out of bounds with it.
+static void test_corrupt_file(void)
+{
+    if (MAX_CANDIDATES < 1) return;
+
+    // C and then D are eliminated.
+    cbox_t cb = cbox_create();
+    const char* names[] = { "A", "A", "A", "B", "B", "C", "D" };
+    for (size_t i = 0; i < 7; ++i) {
+        cand_t c = cbox_intern(cb, names[i]);
+        cbox_push(cb, &c, 1);
+    }
+    tabulator_t tab = tab_create();
+    tab_start(tab, cb, NULL);
+    CHECK(tab_round(tab));
+    CHECK(tab_round(tab));
+    CHECK_SIZE(tab_eliminations(tab), 2);
+
+    cand_t   ranks[7]      = { 0, 0, 0, 1, 1, 2, 3 };
+    cand_t   bad_rank[7]   = { 0, 0, 0, 1, 1, 2, 4 };
+    uint64_t starts[8]     = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    uint64_t bad_starts[8] = { 0, 1, 2, 5, 4, 5, 6, 7 };
+    cand_t   order[4]      = { 2, 3, CAND_NONE, CAND_NONE };
+    cand_t   repeated[4]   = { 2, 2, CAND_NONE, CAND_NONE };
+    cand_t   bad_order[4]  = { 2, 4, CAND_NONE, CAND_NONE };
+
+    // Unchanged, it opens.
+    save_corrupted(cb, tab, ranks, ranks, sizeof ranks);
+    ckpt_t ck = ckpt_open(CKPT_PATH);
+    CHECK(ck != NULL);
+    ckpt_close(ck);
+
+    save_corrupted(cb, tab, ranks, bad_rank, sizeof ranks);
+    CHECK_POINTER(ckpt_open(CKPT_PATH), NULL);
+    save_corrupted(cb, tab, starts, bad_starts, sizeof starts);
+    CHECK_POINTER(ckpt_open(CKPT_PATH), NULL);
+    save_corrupted(cb, tab, order, repeated, sizeof order);
+    CHECK_POINTER(ckpt_open(CKPT_PATH), NULL);
+    save_corrupted(cb, tab, order, bad_order, sizeof order);
+    CHECK_POINTER(ckpt_open(CKPT_PATH), NULL);
+
+    tab_destroy(tab);
+    cbox_destroy(cb);
+}
+
+static void test_attach_invalid(void)
+{
+    char name[64];
+    shm_name(name, "invalid");
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    CHECK(ftruncate(fd, 4096) == 0);
+    close(fd);
+
+    CHECK_POINTER(ckpt_attach(name), NULL);
+    CHECK(ckpt_unpublish(name));
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+static cbox_t example_box(void)
+{
+    cbox_t cb = cbox_create();
+    cand_t a = cbox_intern(cb, "A");
+    cand_t b = cbox_intern(cb, "B");
+    cand_t c = cbox_intern(cb, "C");
+
+    cbox_push(cb, (cand_t[]) {a}, 1);
+    cbox_push(cb, (cand_t[]) {a}, 1);
+    cbox_push(cb, (cand_t[]) {b, a}, 2);
+    cbox_push(cb, (cand_t[]) {b}, 1);
+    cbox_push(cb, (cand_t[]) {c, b}, 2);
+    return cb;
+}
+
+static void save_corrupted(cbox_t cb, tabulator_t tab,
+                           const void* find, const void* with, size_t len)
+{
+    CHECK(ckpt_save(CKPT_PATH, cb, -1, true, tab));
+
+    FILE* f = fopen(CKPT_PATH, "r+b");
+    CHECK(f != NULL);
+    if (f == NULL) return;
+    char data[4096];
+    size_t size = fread(data, 1, sizeof data, f);
+
+    size_t at = 0;
+    while (at + len <= size && memcmp(data + at, find, len) != 0) {
+        ++at;
+    }
+    CHECK(at + len <= size);
+    if (at + len <= size) {
+        fseek(f, (long) at, SEEK_SET);
+        fwrite(with, 1, len, f);
+    }
+    fclose(f);
+}
+
+static void shm_name(char name[64], const char* what)
+{
+    snprintf(name, 64, "/irv-test_ckpt-%s-%ld", what, (long) getpid());
+}
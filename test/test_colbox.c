@@ -0,0 +1,91 @@
+///
+/// Tests for functions in ../src/colbox.c.
+///
+
+#include "cbox.h"
+#include "colbox.h"
+
+#include <ipd.h>
+
+#include <stdlib.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+static void test_columns(void);
+static void test_empty(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_columns();
+    test_empty();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_columns(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    cbox_t cb = cbox_create();
+    cand_t a = cbox_intern(cb, "A");
+    cand_t b = cbox_intern(cb, "B");
+    cand_t c = cbox_intern(cb, "C");
+    cbox_push(cb, (cand_t[]) {a, b, c}, 3);
+    cbox_push(cb, (cand_t[]) {c}, 1);
+    cbox_push(cb, NULL, 0);
+
+    colbox_t col = colbox_from_cbox(cb);
+    CHECK_SIZE(colbox_size(col), 3);
+    CHECK_SIZE(colbox_candidates(col), 3);
+    CHECK_SIZE(colbox_depth(col), 3);
+
+    const cand_t* first  = colbox_column(col, 0);
+    const cand_t* second = colbox_column(col, 1);
+    CHECK_INT(first[0], a);
+    CHECK_INT(first[1], c);
+    CHECK_INT(first[2], CAND_NONE);
+    CHECK_INT(second[0], b);
+    CHECK_INT(second[1], CAND_NONE);
+
+    // A and C tie 1-1; C's ballot is later, so A goes out and its
+    // ballot moves to B, then B and C tie and B goes out.
+    cand_t order[3];
+    size_t neliminated;
+    CHECK_INT(colbox_run(col, NULL, order, &neliminated), c);
+    CHECK_SIZE(neliminated, 2);
+    CHECK_INT(order[0], a);
+    CHECK_INT(order[1], b);
+
+    // With C withdrawn, A wins outright.
+    bool withdrawn[] = {false, false, true};
+    CHECK_INT(colbox_run(col, withdrawn, NULL, NULL), a);
+
+    colbox_destroy(col);
+    cbox_destroy(cb);
+}
+
+static void test_empty(void)
+{
+    cbox_t cb = cbox_create();
+    colbox_t col = colbox_from_cbox(cb);
+    CHECK_SIZE(colbox_depth(col), 0);
+    CHECK_INT(colbox_run(col, NULL, NULL, NULL), CAND_NONE);
+    colbox_destroy(col);
+
+    cbox_push(cb, NULL, 0);
+    col = colbox_from_cbox(cb);
+    CHECK_INT(colbox_run(col, NULL, NULL, NULL), CAND_NONE);
+    colbox_destroy(col);
+    cbox_destroy(cb);
+}
@@ -0,0 +1,197 @@
+///
+/// Tests for functions in ../src/conbox.c.
+///
+
+#include "cbox.h"
+#include "conbox.h"
+#include "helpers.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+#define WRITERS 4
+#define BALLOTS_EACH 30000
+
+// What each writer thread is given.
+struct producer
+{
+    conbox_t        box;
+    size_t          id;
+    _Atomic size_t* running;
+};
+
+// Inserts BALLOTS_EACH ballots. Ballot `k` of writer `id` ranks "W"
+// followed by the letter `id`, then "S" followed by letter `k % 26`.
+static void* produce(void* arg);
+
+// Returns a new ballot ranking the given names.
+static ballot_t make_ballot(const char* first, const char* second);
+
+static void test_single_thread(void);
+static void test_concurrent(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_single_thread();
+    test_concurrent();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_single_thread(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    conbox_t box = conbox_create();
+    cbox_t cb = cbox_create();
+    CHECK_SIZE(conbox_collect(box, cb), 0);
+
+    conbox_writer_t w = conbox_writer_create(box);
+    conbox_insert(w, make_ballot("a", "b"));
+    conbox_insert(w, make_ballot("B!", "c"));
+    CHECK_SIZE(conbox_collect(box, cb), 2);
+    CHECK_SIZE(conbox_collect(box, cb), 0);
+
+    // Enough to fill several chunks.
+    for (int i = 0; i < 1000; ++i) {
+        conbox_insert(w, make_ballot("c", "a"));
+    }
+    CHECK_SIZE(conbox_collect(box, cb), 1000);
+    CHECK_SIZE(cbox_size(cb), 1002);
+
+    size_t len;
+    const cand_t* ranks = cbox_ballot(cb, 1, &len);
+    CHECK_SIZE(len, 2);
+    CHECK_STRING(cbox_name(cb, ranks[0]), "B");
+    CHECK_STRING(cbox_name(cb, ranks[1]), "C");
+
+    conbox_writer_destroy(w);
+    cbox_destroy(cb);
+    conbox_destroy(box);
+}
+
+static void test_concurrent(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    conbox_t box = conbox_create();
+    _Atomic size_t running = WRITERS;
+    struct producer producers[WRITERS];
+    pthread_t threads[WRITERS];
+    for (size_t i = 0; i < WRITERS; ++i) {
+        producers[i] = (struct producer) { box, i, &running };
+        pthread_create(&threads[i], NULL, produce, &producers[i]);
+    }
+
+    // Count live while the writers run, appending each collect.
+    cbox_t cb = cbox_create();
+    tabulator_t tab = tab_create();
+    bool started = false;
+    size_t total = 0;
+    bool more = true;
+    while (more) {
+        more = atomic_load(&running) > 0;
+        size_t n = conbox_collect(box, cb);
+        total += n;
+        if (n > 0 && !started) {
+            tab_start(tab, cb, NULL);
+            started = true;
+        } else if (n > 0) {
+            tab_append(tab, cb);
+        }
+        while (started && tab_round(tab)) {
+            continue;
+        }
+    }
+
+    for (size_t i = 0; i < WRITERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    total += conbox_collect(box, cb);
+    if (started) {
+        tab_append(tab, cb);
+    } else {
+        tab_start(tab, cb, NULL);
+    }
+    while (tab_round(tab)) {
+        continue;
+    }
+
+    CHECK_SIZE(total, WRITERS * BALLOTS_EACH);
+    CHECK_SIZE(cbox_size(cb), WRITERS * BALLOTS_EACH);
+
+    // Each writer's ballots arrive in the order it inserted them.
+    size_t seen[WRITERS] = {0};
+    for (size_t i = 0; i < cbox_size(cb); ++i) {
+        size_t len;
+        const cand_t* ranks = cbox_ballot(cb, i, &len);
+        const char* writer = cbox_name(cb, ranks[0]);
+        const char* seq    = cbox_name(cb, ranks[1]);
+        size_t id = (size_t) (writer[1] - 'A');
+        CHECK(id < WRITERS);
+        if (id < WRITERS) {
+            CHECK_INT(seq[1] - 'A', (int) (seen[id] % 26));
+            ++seen[id];
+        }
+    }
+    for (size_t i = 0; i < WRITERS; ++i) {
+        CHECK_SIZE(seen[i], BALLOTS_EACH);
+    }
+
+    // The live count ends where a count from scratch does.
+    tabulator_t fresh = tab_create();
+    CHECK_INT(tab_run(fresh, cb, NULL), tab_winner(tab));
+
+    tab_destroy(fresh);
+    tab_destroy(tab);
+    cbox_destroy(cb);
+    conbox_destroy(box);
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+static void* produce(void* arg)
+{
+    struct producer* p = arg;
+    conbox_writer_t w = conbox_writer_create(p->box);
+
+    char first[3]  = { 'W', (char) ('A' + p->id), 0 };
+    char second[3] = { 'S', 'A', 0 };
+    for (size_t k = 0; k < BALLOTS_EACH; ++k) {
+        second[1] = (char) ('A' + k % 26);
+        conbox_insert(w, make_ballot(first, second));
+    }
+
+    conbox_writer_destroy(w);
+    atomic_fetch_sub(p->running, 1);
+    return NULL;
+}
+
+static ballot_t make_ballot(const char* first, const char* second)
+{
+    ballot_t ballot = ballot_create();
+    ballot_insert(ballot, strdupb(first, "make_ballot"));
+    ballot_insert(ballot, strdupb(second, "make_ballot"));
+    return ballot;
+}
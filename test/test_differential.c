@@ -0,0 +1,486 @@
+///
+/// Differential tests: the compact engines against the reference
+/// `get_irv_winner`, on randomized elections of many sizes.
+///
+/// For each election, the reference count is replayed round by round
+/// with `bb_count`, `vc_max`, `vc_min` and `bb_eliminate`, exactly as
+/// `get_irv_winner` runs it, and every round's tally, every eliminated
+/// candidate and the winner must match the pile tabulator's. The
+/// columnar, external and packed engines, and the pile tabulator
+/// counting the same ballots in two appended batches, must eliminate
+/// the same candidates in the same order and elect the same winner.
+/// In every third election one candidate is withdrawn: the engines are
+/// told so, and must match the reference counting the ballots with that
+/// candidate struck off them. Timings of the larger elections are printed as ratios to the
+/// reference.
+///
+
+#include "ballot_box.h"
+#include "cbox.h"
+#include "colbox.h"
+#include "extbox.h"
+#include "helpers.h"
+#include "packbox.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+// The engines timed against the reference.
+enum engine
+{
+    ENGINE_REFERENCE,
+    ENGINE_PILE,
+    ENGINE_COLUMNAR,
+    ENGINE_EXTERNAL,
+    ENGINE_PACKED,
+    NENGINES,
+};
+
+// A randomly generated election: ballot `i` ranks candidates
+// `ids[i * MAX_CANDIDATES ..]`, `lens[i]` of them, each spelled with
+// variant `spell[...]` of its name (see `spelled`).
+struct election
+{
+    size_t         ncand;
+    size_t         nballots;
+    size_t*        lens;
+    unsigned char* ids;
+    unsigned char* spell;
+};
+
+// The reference count's results: `counts[r * ncand + c]` is candidate
+// `c`'s tally in round `r`, `totals[r]` the round's total, and
+// `losers[r]` the candidate eliminated after it (for all but the last
+// of `nrounds` rounds).
+struct rounds
+{
+    size_t  nrounds;
+    size_t* counts;
+    size_t* totals;
+    size_t* losers;
+    char*   winner;
+};
+
+// Seconds spent by each engine on elections of at least
+// TIMED_BALLOTS ballots.
+#define TIMED_BALLOTS 1000
+static double timings[NENGINES];
+
+static void generate(struct election* e, struct rng* rng,
+                     size_t ncand, size_t nballots);
+static void election_destroy(struct election* e);
+static ballot_box_t build_ballot_box(const struct election* e);
+static void name_of(size_t c, char name[3]);
+static char* spelled(size_t c, unsigned variant);
+static void reference_rounds(const struct election* e, struct rounds* r);
+static void rounds_destroy(struct rounds* r);
+static cand_t id_of(cbox_t cb, size_t c);
+static void check_order(cbox_t cb, const struct rounds* r,
+                        const cand_t* order, size_t neliminated,
+                        cand_t winner);
+static void strike(const struct election* e, size_t c,
+                   struct election* out);
+static void check_election(const struct election* e, size_t withdraw);
+static double now(void);
+
+static void test_sizes(void);
+static void test_ties(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_sizes();
+    test_ties();
+
+    if (timings[ENGINE_REFERENCE] > 0) {
+        printf("differential: time relative to reference (>= %d ballots):"
+               " pile %.3f, columnar %.3f, external %.3f, packed %.3f\n",
+               TIMED_BALLOTS,
+               timings[ENGINE_PILE] / timings[ENGINE_REFERENCE],
+               timings[ENGINE_COLUMNAR] / timings[ENGINE_REFERENCE],
+               timings[ENGINE_EXTERNAL] / timings[ENGINE_REFERENCE],
+               timings[ENGINE_PACKED] / timings[ENGINE_REFERENCE]);
+    }
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_sizes(void)
+{
+    static const size_t sizes[]  = {1, 2, 5, 20, 100, 1000, 20000};
+    static const size_t trials[] = {50, 50, 100, 100, 50, 10, 2};
+
+    struct rng rng;
+    rng_seed(&rng, 37, 0);
+
+    for (size_t s = 0; s < sizeof sizes / sizeof *sizes; ++s) {
+        for (size_t t = 0; t < trials[s]; ++t) {
+            size_t ncand = 1 + rng_below(&rng, MAX_CANDIDATES);
+            struct election e;
+            generate(&e, &rng, ncand, sizes[s]);
+            check_election(&e, t % 3 == 2 ? t % ncand : SIZE_MAX);
+            election_destroy(&e);
+        }
+    }
+}
+
+static void test_ties(void)
+{
+    // Few ballots over many candidates make ties for the leader and
+    // the loser common, so tie-breaking is exercised every round.
+    struct rng rng;
+    rng_seed(&rng, 37, 1);
+
+    for (size_t t = 0; t < 500; ++t) {
+        size_t ncand    = MAX_CANDIDATES;
+        size_t nballots = 1 + rng_below(&rng, 2 * MAX_CANDIDATES);
+        struct election e;
+        generate(&e, &rng, ncand, nballots);
+        check_election(&e, t % 3 == 2 ? t % ncand : SIZE_MAX);
+        election_destroy(&e);
+    }
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+static void generate(struct election* e, struct rng* rng,
+                     size_t ncand, size_t nballots)
+{
+    e->ncand    = ncand;
+    e->nballots = nballots;
+    e->lens     = mallocb(nballots * sizeof *e->lens, "generate");
+    e->ids      = mallocb(nballots * MAX_CANDIDATES, "generate");
+    e->spell    = mallocb(nballots * MAX_CANDIDATES, "generate");
+
+    // Some candidates are more popular than others, so that elections
+    // are not all near-ties.
+    size_t popular = rng_below(rng, ncand);
+
+    for (size_t i = 0; i < nballots; ++i) {
+        size_t len = rng_below(rng, MAX_CANDIDATES + 1);
+        e->lens[i] = len;
+        for (size_t j = 0; j < len; ++j) {
+            size_t c = rng_below(rng, 4) == 0 ? popular
+                                               : rng_below(rng, ncand);
+            e->ids[i * MAX_CANDIDATES + j]   = (unsigned char) c;
+            e->spell[i * MAX_CANDIDATES + j] =
+                (unsigned char) rng_below(rng, 4);
+        }
+    }
+}
+
+static void election_destroy(struct election* e)
+{
+    free(e->lens);
+    free(e->ids);
+    free(e->spell);
+}
+
+static ballot_box_t build_ballot_box(const struct election* e)
+{
+    ballot_box_t bb = empty_ballot_box;
+    for (size_t i = 0; i < e->nballots; ++i) {
+        ballot_t ballot = ballot_create();
+        for (size_t j = 0; j < e->lens[i]; ++j) {
+            size_t k = i * MAX_CANDIDATES + j;
+            ballot_insert(ballot, spelled(e->ids[k], e->spell[k]));
+        }
+        bb_insert(&bb, ballot);
+    }
+    return bb;
+}
+
+// Candidate `c`'s cleaned name: two capital letters.
+static void name_of(size_t c, char name[3])
+{
+    name[0] = (char) ('A' + c / 26);
+    name[1] = (char) ('A' + c % 26);
+    name[2] = 0;
+}
+
+// Returns a fresh copy of candidate `c`'s name, spelled one of four
+// ways that all clean to the same name.
+static char* spelled(size_t c, unsigned variant)
+{
+    char name[3];
+    name_of(c, name);
+
+    char buf[16];
+    switch (variant) {
+    case 0:
+        snprintf(buf, sizeof buf, "%s", name);
+        break;
+    case 1:
+        snprintf(buf, sizeof buf, "%c%c", name[0] + 32, name[1] + 32);
+        break;
+    case 2:
+        snprintf(buf, sizeof buf, "%c. %c!", name[0], name[1] + 32);
+        break;
+    default:
+        snprintf(buf, sizeof buf, " %c-%c7", name[0] + 32, name[1]);
+        break;
+    }
+    return strdupb(buf, "spelled");
+}
+
+static void reference_rounds(const struct election* e, struct rounds* r)
+{
+    size_t n = e->ncand;
+    r->nrounds = 0;
+    r->counts  = mallocb((n + 1) * n * sizeof *r->counts, "reference");
+    r->totals  = mallocb((n + 1) * sizeof *r->totals, "reference");
+    r->losers  = mallocb((n + 1) * sizeof *r->losers, "reference");
+    r->winner  = NULL;
+
+    // The loop of `get_irv_winner`, recording each round.
+    ballot_box_t bb = build_ballot_box(e);
+    vote_count_t vc = bb_count(bb);
+    for (;;) {
+        size_t k = r->nrounds++;
+        for (size_t c = 0; c < n; ++c) {
+            char name[3];
+            name_of(c, name);
+            r->counts[k * n + c] = vc_lookup(vc, name);
+        }
+        r->totals[k] = vc_total(vc);
+        if (vc_total(vc) == 0) {
+            break;
+        }
+
+        const char* leader = vc_max(vc);
+        if (vc_lookup(vc, leader) > vc_total(vc) / 2.0) {
+            r->winner = strdupb(leader, "reference");
+            break;
+        }
+
+        const char* loser = vc_min(vc);
+        r->losers[k] = (size_t) (loser[0] - 'A') * 26 + (loser[1] - 'A');
+        bb_eliminate(bb, loser);
+        vc_destroy(vc);
+        vc = bb_count(bb);
+    }
+    vc_destroy(vc);
+    bb_destroy(bb);
+}
+
+static void rounds_destroy(struct rounds* r)
+{
+    free(r->counts);
+    free(r->totals);
+    free(r->losers);
+    free(r->winner);
+}
+
+// Returns `cb`'s id for candidate `c`, or CAND_NONE if no ballot
+// ranks `c`.
+static cand_t id_of(cbox_t cb, size_t c)
+{
+    char name[3];
+    name_of(c, name);
+    return cbox_find(cb, name);
+}
+
+// Checks an elimination order and winner from one of the engines
+// against the reference's.
+static void check_order(cbox_t cb, const struct rounds* r,
+                        const cand_t* order, size_t neliminated,
+                        cand_t winner)
+{
+    CHECK_SIZE(neliminated, r->nrounds - 1);
+    for (size_t k = 0; k < neliminated && k + 1 < r->nrounds; ++k) {
+        CHECK_INT(order[k], id_of(cb, r->losers[k]));
+    }
+    if (r->winner) {
+        CHECK(winner != CAND_NONE &&
+              strcmp(cbox_name(cb, winner), r->winner) == 0);
+    } else {
+        CHECK_INT(winner, CAND_NONE);
+    }
+}
+
+// Sets `out` to `e` with candidate `c` struck off every ballot.
+static void strike(const struct election* e, size_t c,
+                   struct election* out)
+{
+    out->ncand    = e->ncand;
+    out->nballots = e->nballots;
+    out->lens     = mallocb(e->nballots * sizeof *out->lens, "strike");
+    out->ids      = mallocb(e->nballots * MAX_CANDIDATES, "strike");
+    out->spell    = mallocb(e->nballots * MAX_CANDIDATES, "strike");
+
+    for (size_t i = 0; i < e->nballots; ++i) {
+        size_t len = 0;
+        for (size_t j = 0; j < e->lens[i]; ++j) {
+            size_t k = i * MAX_CANDIDATES + j;
+            if (e->ids[k] != c) {
+                out->ids[i * MAX_CANDIDATES + len]   = e->ids[k];
+                out->spell[i * MAX_CANDIDATES + len] = e->spell[k];
+                ++len;
+            }
+        }
+        out->lens[i] = len;
+    }
+}
+
+// Checks every engine on `e` against the reference, with candidate
+// `withdraw` withdrawn if it is less than `e->ncand`.
+static void check_election(const struct election* e, size_t withdraw)
+{
+    bool timed = e->nballots >= TIMED_BALLOTS;
+
+    // The reference has no withdrawals, so it counts the ballots with
+    // the withdrawn candidate struck off.
+    struct election struck;
+    const struct election* ref = e;
+    if (withdraw < e->ncand) {
+        strike(e, withdraw, &struck);
+        ref = &struck;
+    }
+    struct rounds r;
+    reference_rounds(ref, &r);
+
+    // The engines count all of `e`, told of the withdrawal.
+    ballot_box_t full = build_ballot_box(e);
+    cbox_t cb = cbox_from_bb(full);
+    bb_destroy(full);
+    bool withdrawn_ids[MAX_CANDIDATES] = { false };
+    const bool* withdrawn = NULL;
+    if (withdraw < e->ncand && id_of(cb, withdraw) != CAND_NONE) {
+        withdrawn_ids[id_of(cb, withdraw)] = true;
+        withdrawn = withdrawn_ids;
+    }
+
+    // `get_irv_winner` itself agrees with the replay.
+    ballot_box_t bb = build_ballot_box(ref);
+    double start = now();
+    char* winner = get_irv_winner(bb);
+    timings[ENGINE_REFERENCE] += timed ? now() - start : 0;
+    if (r.winner) {
+        CHECK(winner && strcmp(winner, r.winner) == 0);
+    } else {
+        CHECK_POINTER(winner, NULL);
+    }
+    free(winner);
+    bb_destroy(bb);
+
+    // The pile tabulator, round by round.
+    size_t n = e->ncand;
+    tabulator_t tab = tab_create();
+    start = now();
+    tab_start(tab, cb, withdrawn);
+    for (size_t k = 0; k < r.nrounds; ++k) {
+        CHECK_SIZE(tab_total(tab), r.totals[k]);
+        for (size_t c = 0; c < n; ++c) {
+            cand_t id = id_of(cb, c);
+            size_t count = id == CAND_NONE || tab_is_out(tab, id)
+                ? 0 : tab_count(tab, id);
+            CHECK_SIZE(count, r.counts[k * n + c]);
+        }
+        if (k + 1 < r.nrounds) {
+            CHECK(tab_round(tab));
+        }
+    }
+    CHECK(!tab_round(tab));
+    timings[ENGINE_PILE] += timed ? now() - start : 0;
+
+    cand_t order[MAX_CANDIDATES];
+    size_t nelim = tab_eliminations(tab);
+    for (size_t k = 0; k < nelim && k < MAX_CANDIDATES; ++k) {
+        order[k] = tab_eliminated(tab, k);
+    }
+    check_order(cb, &r, order, nelim, tab_winner(tab));
+
+    // The pile tabulator, counting the second half of the ballots
+    // as an appended batch.
+    cbox_t part = cbox_create();
+    for (size_t c = 0; c < cbox_candidates(cb); ++c) {
+        cbox_intern(part, cbox_name(cb, (cand_t) c));
+    }
+    size_t half = cbox_size(cb) / 2;
+    for (size_t i = 0; i < cbox_size(cb); ++i) {
+        if (i == half) {
+            tab_run(tab, part, withdrawn);
+        }
+        size_t len;
+        const cand_t* ranks = cbox_ballot(cb, i, &len);
+        cbox_push(part, ranks, len);
+    }
+    if (half == 0) {
+        tab_start(tab, part, withdrawn);
+    } else {
+        tab_append(tab, part);
+    }
+    while (tab_round(tab)) {
+        continue;
+    }
+    nelim = tab_eliminations(tab);
+    for (size_t k = 0; k < nelim && k < MAX_CANDIDATES; ++k) {
+        order[k] = tab_eliminated(tab, k);
+    }
+    check_order(cb, &r, order, nelim, tab_winner(tab));
+    cbox_destroy(part);
+    tab_destroy(tab);
+
+    // The columnar engine.
+    colbox_t col = colbox_from_cbox(cb);
+    start = now();
+    cand_t col_winner = colbox_run(col, withdrawn, order, &nelim);
+    timings[ENGINE_COLUMNAR] += timed ? now() - start : 0;
+    check_order(cb, &r, order, nelim, col_winner);
+    colbox_destroy(col);
+
+    // The external engine.
+    extbox_t eb = extbox_create(NULL);
+    CHECK(eb != NULL);
+    if (eb) {
+        start = now();
+        CHECK(extbox_append(eb, cb));
+        cand_t ext_winner = extbox_run(eb, cbox_candidates(cb),
+                                       withdrawn, order, &nelim);
+        timings[ENGINE_EXTERNAL] += timed ? now() - start : 0;
+        check_order(cb, &r, order, nelim, ext_winner);
+        extbox_destroy(eb);
+    }
+
+    // The packed engine.
+    packbox_t pb = packbox_create();
+    start = now();
+    packbox_append(pb, cb);
+    cand_t packed_winner = packbox_run(pb, withdrawn, order, &nelim);
+    timings[ENGINE_PACKED] += timed ? now() - start : 0;
+    check_order(cb, &r, order, nelim, packed_winner);
+    packbox_destroy(pb);
+
+    cbox_destroy(cb);
+    rounds_destroy(&r);
+    if (ref == &struck) {
+        election_destroy(&struck);
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,187 @@
+///
+/// Tests for functions in ../src/digest.c.
+///
+
+#include "cbox.h"
+#include "digest.h"
+#include "helpers.h"
+
+#include <ipd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+// Returns the digest of `cb`, formatted, computed on `nworkers`
+// threads. The result is a static buffer.
+static const char* digest_of(cbox_t cb, size_t nworkers);
+
+static void test_empty(void);
+static void test_order_independent(void);
+static void test_sensitive(void);
+static void test_batches_and_workers(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_empty();
+    test_order_independent();
+    test_sensitive();
+    test_batches_and_workers();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_empty(void)
+{
+    struct digest d;
+    char hex[DIGEST_HEX_LEN + 1];
+    digest_init(&d);
+    digest_format(&d, hex);
+    CHECK_STRING(hex, "00000000000000000000000000000000");
+    CHECK_SIZE(d.ballots, 0);
+}
+
+static void test_order_independent(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    // The same ballots in a different order, with the candidates
+    // interned in a different order and a repeated name.
+    cbox_t one = cbox_create();
+    cand_t a = cbox_intern(one, "A");
+    cand_t b = cbox_intern(one, "B");
+    cbox_push(one, (cand_t[]) {a, b}, 2);
+    cbox_push(one, (cand_t[]) {b}, 1);
+    cbox_push(one, NULL, 0);
+
+    cbox_t two = cbox_create();
+    b = cbox_intern(two, "B");
+    a = cbox_intern(two, "A");
+    cbox_push(two, NULL, 0);
+    cbox_push(two, (cand_t[]) {b}, 1);
+    cbox_push(two, (cand_t[]) {a, b, a}, 3);
+
+    char first[DIGEST_HEX_LEN + 1];
+    strcpy(first, digest_of(one, 1));
+    CHECK_STRING(digest_of(two, 1), first);
+
+    cbox_destroy(one);
+    cbox_destroy(two);
+}
+
+static void test_sensitive(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    cbox_t cb = cbox_create();
+    cand_t a = cbox_intern(cb, "A");
+    cand_t b = cbox_intern(cb, "B");
+    cbox_push(cb, (cand_t[]) {a, b}, 2);
+
+    char before[DIGEST_HEX_LEN + 1];
+    strcpy(before, digest_of(cb, 1));
+
+    // Swapping a ranking changes the digest.
+    cbox_t swapped = cbox_create();
+    cbox_intern(swapped, "A");
+    cbox_intern(swapped, "B");
+    cbox_push(swapped, (cand_t[]) {b, a}, 2);
+    CHECK(strcmp(digest_of(swapped, 1), before) != 0);
+
+    // So does adding an empty ballot.
+    cbox_push(cb, NULL, 0);
+    CHECK(strcmp(digest_of(cb, 1), before) != 0);
+
+    cbox_destroy(swapped);
+    cbox_destroy(cb);
+}
+
+static void test_batches_and_workers(void)
+{
+    size_t ncand = MAX_CANDIDATES < 5 ? MAX_CANDIDATES : 5;
+    struct rng rng;
+    rng_seed(&rng, 34, 0);
+
+    cbox_t cb = cbox_create();
+    char name[16];
+    for (size_t c = 0; c < ncand; ++c) {
+        sprintf(name, "N%c", (char) ('A' + c));
+        cbox_intern(cb, name);
+    }
+    for (int i = 0; i < 200000; ++i) {
+        cand_t ranks[MAX_CANDIDATES];
+        size_t len = rng_below(&rng, ncand + 1);
+        for (size_t j = 0; j < len; ++j) {
+            ranks[j] = (cand_t) rng_below(&rng, ncand);
+        }
+        cbox_push(cb, ranks, len);
+    }
+
+    char whole[DIGEST_HEX_LEN + 1];
+    strcpy(whole, digest_of(cb, 1));
+    CHECK_STRING(digest_of(cb, 4), whole);
+
+    // In two batches from different boxes, as the external engine
+    // digests its input.
+    cbox_t first = cbox_create();
+    cbox_t rest  = cbox_create();
+    for (size_t c = 0; c < ncand; ++c) {
+        cbox_intern(rest, cbox_name(cb, (cand_t) (ncand - 1 - c)));
+    }
+    for (size_t i = 0; i < cbox_size(cb); ++i) {
+        size_t len;
+        const cand_t* ranks = cbox_ballot(cb, i, &len);
+        cand_t copy[MAX_CANDIDATES];
+        for (size_t j = 0; j < len; ++j) {
+            copy[j] = cbox_intern(i < 150000 ? first : rest,
+                                  cbox_name(cb, ranks[j]));
+        }
+        cbox_push(i < 150000 ? first : rest, copy, len);
+    }
+
+    struct digest d;
+    char hex[DIGEST_HEX_LEN + 1];
+    digest_init(&d);
+    digest_add(&d, rest, 0, 3);
+    digest_add(&d, first, 0, 2);
+    digest_format(&d, hex);
+    CHECK_STRING(hex, whole);
+    CHECK_SIZE(d.ballots, 200000);
+
+    // Digesting part of a box.
+    digest_init(&d);
+    digest_add(&d, cb, 150000, 2);
+    CHECK_SIZE(d.ballots, 50000);
+
+    cbox_destroy(rest);
+    cbox_destroy(first);
+    cbox_destroy(cb);
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+static const char* digest_of(cbox_t cb, size_t nworkers)
+{
+    static char hex[DIGEST_HEX_LEN + 1];
+    struct digest d;
+    digest_init(&d);
+    digest_add(&d, cb, 0, nworkers);
+    digest_format(&d, hex);
+    return hex;
+}
@@ -0,0 +1,161 @@
+///
+/// Tests for functions in ../src/extbox.c.
+///
+
+#include "cbox.h"
+#include "extbox.h"
+#include "helpers.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+// Fills `batch` (after clearing it) with `n` random ballots over
+// `ncand` candidates, and also adds them to `all`.
+static void random_ballots(struct rng* rng, cbox_t batch, cbox_t all,
+                           size_t ncand, size_t n);
+
+static void test_empty(void);
+static void test_matches_tabulator(void);
+static void test_many_blocks(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_empty();
+    test_matches_tabulator();
+    test_many_blocks();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_empty(void)
+{
+    extbox_t eb = extbox_create(NULL);
+    CHECK(eb != NULL);
+    if (eb == NULL) return;
+
+    CHECK_SIZE(extbox_size(eb), 0);
+    CHECK_INT(extbox_run(eb, 0, NULL, NULL, NULL), CAND_NONE);
+
+    cbox_t cb = cbox_create();
+    cbox_intern(cb, "A");
+    cbox_push(cb, NULL, 0);
+    CHECK(extbox_append(eb, cb));
+    CHECK_SIZE(extbox_size(eb), 1);
+    CHECK_INT(extbox_run(eb, 1, NULL, NULL, NULL), CAND_NONE);
+
+    cbox_destroy(cb);
+    extbox_destroy(eb);
+}
+
+// Random elections appended in several batches, counted both ways.
+static void test_matches_tabulator(void)
+{
+    size_t ncand = MAX_CANDIDATES < 6 ? MAX_CANDIDATES : 6;
+    struct rng rng;
+    rng_seed(&rng, 33, 0);
+
+    tabulator_t tab = tab_create();
+    cand_t order[6];
+    bool withdrawn[6] = { false };
+
+    for (int trial = 0; trial < 50; ++trial) {
+        extbox_t eb  = extbox_create(NULL);
+        cbox_t batch = cbox_create();
+        cbox_t all   = cbox_create();
+        if (eb == NULL) return;
+
+        for (int b = 0; b < 3; ++b) {
+            random_ballots(&rng, batch, all, ncand, rng_below(&rng, 40));
+            CHECK(extbox_append(eb, batch));
+        }
+        withdrawn[0] = trial % 2 == 1;
+
+        size_t neliminated;
+        CHECK_SIZE(extbox_size(eb), cbox_size(all));
+        CHECK_INT(extbox_run(eb, ncand, withdrawn, order, &neliminated),
+                  tab_run(tab, all, withdrawn));
+        CHECK_SIZE(neliminated, tab_eliminations(tab));
+        for (size_t k = 0; k < neliminated; ++k) {
+            CHECK_INT(order[k], tab_eliminated(tab, k));
+        }
+
+        cbox_destroy(all);
+        cbox_destroy(batch);
+        extbox_destroy(eb);
+    }
+
+    tab_destroy(tab);
+}
+
+// Enough ballots to fill several blocks, with a count in the middle.
+static void test_many_blocks(void)
+{
+    size_t ncand = MAX_CANDIDATES;
+    struct rng rng;
+    rng_seed(&rng, 33, 1);
+
+    extbox_t eb  = extbox_create(NULL);
+    cbox_t batch = cbox_create();
+    cbox_t all   = cbox_create();
+    tabulator_t tab = tab_create();
+    if (eb == NULL) return;
+
+    random_ballots(&rng, batch, all, ncand, 200000);
+    CHECK(extbox_append(eb, batch));
+    CHECK_INT(extbox_run(eb, ncand, NULL, NULL, NULL),
+              tab_run(tab, all, NULL));
+
+    random_ballots(&rng, batch, all, ncand, 100000);
+    CHECK(extbox_append(eb, batch));
+    CHECK_SIZE(extbox_size(eb), 300000);
+    CHECK_INT(extbox_run(eb, ncand, NULL, NULL, NULL),
+              tab_run(tab, all, NULL));
+
+    tab_destroy(tab);
+    cbox_destroy(all);
+    cbox_destroy(batch);
+    extbox_destroy(eb);
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+static void random_ballots(struct rng* rng, cbox_t batch, cbox_t all,
+                           size_t ncand, size_t n)
+{
+    char name[16];
+    for (size_t c = cbox_candidates(all); c < ncand; ++c) {
+        sprintf(name, "C%c", (char) ('A' + c));
+        cbox_intern(batch, name);
+        cbox_intern(all, name);
+    }
+
+    cbox_clear(batch);
+    for (size_t i = 0; i < n; ++i) {
+        cand_t ranks[MAX_CANDIDATES];
+        size_t len = rng_below(rng, ncand + 1);
+        for (size_t j = 0; j < len; ++j) {
+            ranks[j] = (cand_t) rng_below(rng, ncand);
+        }
+        cbox_push(batch, ranks, len);
+        cbox_push(all, ranks, len);
+    }
+}
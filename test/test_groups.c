@@ -0,0 +1,350 @@
+///
+/// Tests for functions in ../src/groups.c, and the group tallies in
+/// ../src/tabulate.c and ../src/rounds.c.
+///
+
+#include "cbox.h"
+#include "groups.h"
+#include "helpers.h"
+#include "rounds.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+#define NCAND   5
+#define NGROUPS 7
+
+// Returns a temporary file holding `text`, positioned at its start.
+static FILE* temp_with(const char* text);
+
+// Appends `nballots` random ballots over NCAND candidates to `cb`, and
+// their random groups to `group`.
+static void add_random(struct rng* rng, cbox_t cb, uint32_t* group,
+                       size_t nballots);
+
+// Checks that the group tallies of each round of `tab`'s finished count
+// of `cb` are those of counting each group's ballots alone with the
+// same eliminations.
+static void check_groups(cbox_t cb, tabulator_t tab, const uint32_t* group,
+                         size_t ngroups);
+
+static void test_read(void);
+static void test_read_n(void);
+static void test_write(void);
+static void test_random(void);
+static void test_append(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_read();
+    test_read_n();
+    test_write();
+    test_random();
+    test_append();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_read(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    // A ballot before any key, a key in the middle of a ballot, a key
+    // used twice, and a key after the last ballot.
+    FILE* f = temp_with("a\n%\n@North 1\nb\na\n%\nb\n@South, 2\n%\n"
+                        "@North 1\n%\nc\n%\n@Late\n");
+    groups_t gs = groups_create();
+    cbox_t cb   = cbox_create();
+    CHECK_SIZE(groups_read(gs, cb, f), 5);
+    CHECK_SIZE(cbox_size(cb), 5);
+
+    CHECK_SIZE(groups_count(gs), 4);
+    CHECK_STRING(groups_name(gs, 0), "");
+    CHECK_STRING(groups_name(gs, 1), "North 1");
+    CHECK_STRING(groups_name(gs, 2), "South, 2");
+    CHECK_STRING(groups_name(gs, 3), "Late");
+    CHECK_SIZE(groups_size(gs, 0), 1);
+    CHECK_SIZE(groups_size(gs, 1), 3);
+    CHECK_SIZE(groups_size(gs, 2), 1);
+    CHECK_SIZE(groups_size(gs, 3), 0);
+
+    const uint32_t* of = groups_of(gs);
+    uint32_t expected[] = { 0, 1, 2, 1, 1 };
+    for (size_t i = 0; i < 5; ++i) {
+        CHECK_INT(of[i], expected[i]);
+    }
+
+    // Key lines are not names: the ballots are those without them.
+    size_t len;
+    const cand_t* ranks = cbox_ballot(cb, 1, &len);
+    CHECK_SIZE(len, 2);
+    CHECK_STRING(cbox_name(cb, ranks[0]), "B");
+    CHECK_STRING(cbox_name(cb, ranks[1]), "A");
+    cbox_ballot(cb, 3, &len);
+    CHECK_SIZE(len, 0);
+    CHECK_SIZE(cbox_candidates(cb), 3);
+
+    // The trailing key carries over to the next read.
+    fclose(f);
+    f = temp_with("a\n%\n");
+    CHECK_SIZE(groups_read(gs, cb, f), 1);
+    CHECK_INT(groups_of(gs)[5], 3);
+    CHECK_SIZE(groups_size(gs, 3), 1);
+
+    cbox_destroy(cb);
+    groups_destroy(gs);
+    fclose(f);
+}
+
+static void test_read_n(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    // Reading two ballots at a time notes the same groups as reading
+    // them all at once, including across a key between reads.
+    FILE* f = temp_with("a\n%\n@North\nb\na\n%\nb\n%\n@South\n%\nc\n%\n");
+    groups_t gs = groups_create();
+    cbox_t cb   = cbox_create();
+    CHECK_SIZE(groups_read_n(gs, cb, f, 2), 2);
+    CHECK_SIZE(groups_read_n(gs, cb, f, 2), 2);
+    CHECK_SIZE(groups_read_n(gs, cb, f, 2), 1);
+    CHECK_SIZE(groups_read_n(gs, cb, f, 2), 0);
+    CHECK_SIZE(cbox_size(cb), 5);
+
+    const uint32_t* of = groups_of(gs);
+    uint32_t expected[] = { 0, 1, 1, 2, 2 };
+    for (size_t i = 0; i < 5; ++i) {
+        CHECK_INT(of[i], expected[i]);
+    }
+    CHECK_SIZE(groups_size(gs, 2), 2);
+
+    cbox_destroy(cb);
+    groups_destroy(gs);
+    fclose(f);
+}
+
+static void test_write(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    // Overall: A 3, B 2, C 1; C goes out and its ballot moves to B,
+    // and then B goes out and one of its ballots moves to A.
+    FILE* f = temp_with("@P1\na\n%\na\n%\nc\nb\n%\n"
+                        "@P\"2\"\nb\na\n%\nb\n%\na\n%\n");
+    groups_t gs = groups_create();
+    cbox_t cb   = cbox_create();
+    groups_read(gs, cb, f);
+
+    tabulator_t tab = tab_create();
+    tab_set_groups(tab, groups_of(gs), groups_count(gs));
+    CHECK_INT(tab_run(tab, cb, NULL), cbox_find(cb, "A"));
+
+    FILE* out = tmpfile();
+    rounds_write_groups(out, cb, tab, gs);
+    long size = ftell(out);
+    char* text = mallocb((size_t) size + 1, "test_write");
+    rewind(out);
+    text[fread(text, 1, (size_t) size, out)] = 0;
+    CHECK_STRING(text,
+                 "round,group,candidate,votes\n"
+                 "1,P1,A,2\n"
+                 "1,P1,C,1\n"
+                 "1,P1,B,0\n"
+                 "1,P1,(exhausted),0\n"
+                 "1,\"P\"\"2\"\"\",A,1\n"
+                 "1,\"P\"\"2\"\"\",C,0\n"
+                 "1,\"P\"\"2\"\"\",B,2\n"
+                 "1,\"P\"\"2\"\"\",(exhausted),0\n"
+                 "2,P1,A,2\n"
+                 "2,P1,B,1\n"
+                 "2,P1,(exhausted),0\n"
+                 "2,\"P\"\"2\"\"\",A,1\n"
+                 "2,\"P\"\"2\"\"\",B,2\n"
+                 "2,\"P\"\"2\"\"\",(exhausted),0\n"
+                 "3,P1,A,2\n"
+                 "3,P1,(exhausted),1\n"
+                 "3,\"P\"\"2\"\"\",A,2\n"
+                 "3,\"P\"\"2\"\"\",(exhausted),1\n");
+
+    free(text);
+    fclose(out);
+    tab_destroy(tab);
+    cbox_destroy(cb);
+    groups_destroy(gs);
+    fclose(f);
+}
+
+// Random elections, some with a withdrawn candidate.
+static void test_random(void)
+{
+    struct rng rng;
+    rng_seed(&rng, 43, 0);
+    tabulator_t tab = tab_create();
+    uint32_t group[300];
+    bool withdrawn[NCAND];
+
+    for (int trial = 0; trial < 100; ++trial) {
+        cbox_t cb = cbox_create();
+        add_random(&rng, cb, group, rng_below(&rng, 300));
+        for (size_t c = 0; c < NCAND; ++c) {
+            withdrawn[c] = trial % 4 == 0 && c == (size_t) trial % NCAND;
+        }
+
+        tab_set_groups(tab, group, NGROUPS);
+        tab_run(tab, cb, withdrawn);
+        check_groups(cb, tab, group, NGROUPS);
+
+        // Without groups, there are no group tallies.
+        tab_set_groups(tab, NULL, 0);
+        tab_run(tab, cb, withdrawn);
+        size_t n;
+        CHECK_POINTER(tab_round_group_changes(tab, 0, &n), NULL);
+        CHECK_SIZE(n, 0);
+
+        cbox_destroy(cb);
+    }
+
+    tab_destroy(tab);
+}
+
+static void test_append(void)
+{
+    struct rng rng;
+    rng_seed(&rng, 44, 0);
+    uint32_t group[400];
+
+    for (int trial = 0; trial < 50; ++trial) {
+        cbox_t cb = cbox_create();
+        tabulator_t tab = tab_create();
+
+        size_t first = rng_below(&rng, 200);
+        add_random(&rng, cb, group, first);
+        tab_set_groups(tab, group, NGROUPS);
+        tab_run(tab, cb, NULL);
+
+        add_random(&rng, cb, group + first, rng_below(&rng, 200));
+        tab_set_groups(tab, group, NGROUPS);
+        tab_append(tab, cb);
+        while (tab_round(tab)) {
+            continue;
+        }
+        check_groups(cb, tab, group, NGROUPS);
+
+        tab_destroy(tab);
+        cbox_destroy(cb);
+    }
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+static FILE* temp_with(const char* text)
+{
+    FILE* f = tmpfile();
+    if (f == NULL) {
+        perror("tmpfile");
+        exit(1);
+    }
+    fputs(text, f);
+    rewind(f);
+    return f;
+}
+
+static void add_random(struct rng* rng, cbox_t cb, uint32_t* group,
+                       size_t nballots)
+{
+    char name[16];
+    for (int c = 0; c < NCAND; ++c) {
+        sprintf(name, "C%c", 'A' + c);
+        cbox_intern(cb, name);
+    }
+
+    size_t depth = MAX_CANDIDATES < NCAND ? MAX_CANDIDATES : NCAND;
+    for (size_t i = 0; i < nballots; ++i) {
+        cand_t ranks[NCAND];
+        size_t len = rng_below(rng, depth + 1);
+        for (size_t j = 0; j < len; ++j) {
+            ranks[j] = (cand_t) rng_below(rng, NCAND);
+        }
+        cbox_push(cb, ranks, len);
+        group[i] = (uint32_t) rng_below(rng, NGROUPS);
+    }
+}
+
+static void check_groups(cbox_t cb, tabulator_t tab, const uint32_t* group,
+                         size_t ngroups)
+{
+    size_t ncand   = cbox_candidates(cb);
+    size_t nrounds = tab_rounds(tab);
+    size_t* counts = callocb(ngroups * ncand, sizeof *counts, "test");
+
+    // Each group's ballots alone, in a box of their own.
+    cbox_t* sub = mallocb(ngroups * sizeof *sub, "test");
+    for (size_t g = 0; g < ngroups; ++g) {
+        sub[g] = cbox_create();
+        for (size_t c = 0; c < ncand; ++c) {
+            cbox_intern(sub[g], cbox_name(cb, (cand_t) c));
+        }
+    }
+    for (size_t i = 0; i < cbox_size(cb); ++i) {
+        size_t len;
+        const cand_t* ranks = cbox_ballot(cb, i, &len);
+        cbox_push(sub[group[i]], ranks, len);
+    }
+
+    cand_t order[NCAND];
+    bool withdrawn[NCAND];
+    for (size_t k = 0; k + 1 < nrounds; ++k) {
+        order[k] = tab_eliminated(tab, k);
+    }
+    for (size_t c = 0; c < ncand; ++c) {
+        withdrawn[c] = tab_is_out(tab, (cand_t) c);
+    }
+    for (size_t k = 0; k + 1 < nrounds; ++k) {
+        withdrawn[order[k]] = false;
+    }
+
+    tabulator_t alone = tab_create();
+    for (size_t r = 0; r < nrounds; ++r) {
+        size_t n;
+        const struct tab_group_change* changes =
+            tab_round_group_changes(tab, r, &n);
+        for (size_t j = 0; j < n; ++j) {
+            counts[changes[j].group * ncand + changes[j].cand] =
+                changes[j].count;
+        }
+
+        for (size_t g = 0; g < ngroups; ++g) {
+            tab_resume(alone, sub[g], withdrawn, order, r);
+            for (size_t c = 0; c < ncand; ++c) {
+                CHECK_SIZE(counts[g * ncand + c],
+                           tab_count(alone, (cand_t) c));
+            }
+        }
+    }
+
+    tab_destroy(alone);
+    for (size_t g = 0; g < ngroups; ++g) {
+        cbox_destroy(sub[g]);
+    }
+    free(sub);
+    free(counts);
+}
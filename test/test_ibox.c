@@ -0,0 +1,187 @@
+///
+/// Tests for functions in ../src/ibox.c.
+///
+
+#include "cbox.h"
+#include "helpers.h"
+#include "ibox.h"
+
+#include <ipd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+// Returns a temporary file holding `text`, positioned at the start.
+static FILE* temp_with(const char* text);
+
+static void test_locations(void);
+static void test_many(void);
+static void test_sample(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_locations();
+    test_many();
+    test_sample();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_locations(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    // Offsets:      0       6     10 12
+    const char* one = "A\nB\n%\nB\n%\n%\nA\n";
+    // Offsets:      0
+    const char* two = "B\n";
+
+    ibox_t ib = ibox_create();
+    FILE* f = temp_with(one);
+    CHECK_SIZE(ibox_read(ib, f, "one"), 4);
+    fclose(f);
+    f = temp_with(two);
+    CHECK_SIZE(ibox_read(ib, f, "two"), 1);
+    fclose(f);
+
+    CHECK_SIZE(ibox_size(ib), 5);
+    CHECK_SIZE(ibox_sources(ib), 2);
+    CHECK_STRING(ibox_source_name(ib, 0), "one");
+    CHECK_STRING(ibox_source_name(ib, 1), "two");
+
+    int64_t offsets[] = {0, 6, 10, 12, 0};
+    size_t  sources[] = {0, 0, 0, 0, 1};
+    for (size_t i = 0; i < 5; ++i) {
+        struct ibox_loc loc = ibox_location(ib, i);
+        CHECK_SIZE(loc.source, sources[i]);
+        CHECK_INT((int) loc.offset, (int) offsets[i]);
+        CHECK_SIZE(ibox_find(ib, sources[i], offsets[i]), i);
+    }
+    CHECK_SIZE(ibox_find(ib, 0, 2), IBOX_NONE);
+    CHECK_SIZE(ibox_find(ib, 1, 6), IBOX_NONE);
+    CHECK_SIZE(ibox_find(ib, 2, 0), IBOX_NONE);
+
+    // Ballots keep input order, across sources.
+    cbox_t cb = ibox_cbox(ib);
+    size_t len;
+    const cand_t* ranks = cbox_ballot(cb, 0, &len);
+    CHECK_SIZE(len, 2);
+    CHECK_STRING(cbox_name(cb, ranks[0]), "A");
+    cbox_ballot(cb, 2, &len);
+    CHECK_SIZE(len, 0);
+    ranks = cbox_ballot(cb, 4, &len);
+    CHECK_SIZE(len, 1);
+    CHECK_STRING(cbox_name(cb, ranks[0]), "B");
+
+    ibox_destroy(ib);
+}
+
+static void test_many(void)
+{
+    // Enough ballots to grow the hash table many times.
+    size_t n = 20000;
+    char* text = mallocb(4 * n + 1, "test_many");
+    for (size_t i = 0; i < n; ++i) {
+        memcpy(text + 4 * i, "A\n%\n", 4);
+    }
+    text[4 * n] = 0;
+
+    ibox_t ib = ibox_create();
+    FILE* f = temp_with(text);
+    CHECK_SIZE(ibox_read(ib, f, "many"), n);
+    fclose(f);
+
+    for (size_t i = 0; i < n; ++i) {
+        CHECK_SIZE(ibox_find(ib, 0, (int64_t) (4 * i)), i);
+        CHECK_SIZE(ibox_find(ib, 0, (int64_t) (4 * i + 2)), IBOX_NONE);
+    }
+
+    ibox_destroy(ib);
+    free(text);
+}
+
+static void test_sample(void)
+{
+    size_t n = 1000;
+    char* text = mallocb(4 * n + 1, "test_sample");
+    for (size_t i = 0; i < n; ++i) {
+        memcpy(text + 4 * i, "A\n%\n", 4);
+    }
+    text[4 * n] = 0;
+
+    ibox_t ib = ibox_create();
+    FILE* f = temp_with(text);
+    ibox_read(ib, f, "box");
+    fclose(f);
+
+    size_t k = 50000;
+    size_t* one   = mallocb(k * sizeof *one, "test_sample");
+    size_t* four  = mallocb(k * sizeof *four, "test_sample");
+    size_t* other = mallocb(k * sizeof *other, "test_sample");
+    size_t* hits  = callocb(n, sizeof *hits, "test_sample");
+
+    ibox_sample(ib, k, 35, one, 1);
+    ibox_sample(ib, k, 35, four, 4);
+    ibox_sample(ib, k, 36, other, 1);
+
+    size_t same = 0;
+    for (size_t j = 0; j < k; ++j) {
+        CHECK(one[j] < n);
+        CHECK_SIZE(four[j], one[j]);
+        if (other[j] == one[j]) {
+            ++same;
+        }
+        ++hits[one[j]];
+    }
+    // A different seed gives a different sample.
+    CHECK(same < k / 100);
+
+    // Every ballot is drawn about k / n = 50 times.
+    for (size_t i = 0; i < n; ++i) {
+        CHECK(hits[i] > 15 && hits[i] < 100);
+    }
+
+    // A shorter sample is a prefix of a longer one.
+    ibox_sample(ib, 100, 35, other, 2);
+    for (size_t j = 0; j < 100; ++j) {
+        CHECK_SIZE(other[j], one[j]);
+    }
+
+    free(hits);
+    free(other);
+    free(four);
+    free(one);
+    ibox_destroy(ib);
+    free(text);
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+static FILE* temp_with(const char* text)
+{
+    FILE* f = tmpfile();
+    if (f == NULL) {
+        perror("tmpfile");
+        exit(1);
+    }
+    fputs(text, f);
+    rewind(f);
+    return f;
+}
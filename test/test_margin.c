@@ -0,0 +1,246 @@
+///
+/// Tests for functions in ../src/margin.c.
+///
+
+#include "ballot_box.h"
+#include "cbox.h"
+#include "helpers.h"
+#include "margin.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+// Takes the expected winner and the expected bounds on the margin,
+// followed by the votes in the same format as `check_election` in
+// test_ballot_box.c: names, with "%" after each ballot and NULL at the
+// end. Also checks that `tab_run` agrees with `get_irv_winner`.
+static void check_margin(const char* expected_winner,
+                         size_t expected_lower,
+                         size_t expected_upper,
+                         ...);
+
+static void landslide(void),
+            tie_goes_to_last_ballot(void),
+            example_from_wikipedia(void),
+            only_one_candidate(void),
+            upper_bound_is_real(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    landslide();
+    tie_goes_to_last_ballot();
+    example_from_wikipedia();
+    only_one_candidate();
+    upper_bound_is_real();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void landslide(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    // Two of A's four ballots must change to beat A.
+    check_margin("A", 2, 2,
+            "a", "%",
+            "a", "%",
+            "a", "%",
+            "a", "%",
+            "b", "%",
+            NULL);
+}
+
+static void tie_goes_to_last_ballot(void)
+{
+    if (MAX_CANDIDATES < 2) return;
+
+    check_margin("B", 0, 1,
+            "a", "%",
+            "b", "%",
+            NULL);
+}
+
+static void example_from_wikipedia(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    check_margin("SUE", 1, 1,
+            "bob", "bill", "s u e", "%",
+            "Sue", "Bob", "Bill", "%",
+            "Bill!", "Sue!", "BoB!", "%",
+            "bob", "bill", "sue", "%",
+            "sue", "bob", "bill", "%",
+            NULL);
+}
+
+static void only_one_candidate(void)
+{
+    check_margin("A", SIZE_MAX, SIZE_MAX,
+            "a", "%",
+            "a", "%",
+            NULL);
+}
+
+
+// Checks on small random boxes, by trying every choice of ballots,
+// that some `upper` of the ballots ranking the winner first really can
+// be rewritten in place to rank only `challenger` and change the winner
+// (ties included, which depend on where the rewritten ballots are).
+static void upper_bound_is_real(void)
+{
+    int ncand = MAX_CANDIDATES < 4 ? MAX_CANDIDATES : 4;
+    if (ncand < 2) return;
+
+    struct rng rng;
+    rng_seed(&rng, 26, 0);
+    tabulator_t tab = tab_create();
+
+    for (int trial = 0; trial < 300; ++trial) {
+        // A few distinct rankings, each used several times.
+        cand_t kinds[4][4];
+        size_t kind_len[4];
+        for (int k = 0; k < 4; ++k) {
+            kind_len[k] = 1 + rng_below(&rng, ncand);
+            for (size_t j = 0; j < kind_len[k]; ++j) {
+                kinds[k][j] = (cand_t) rng_below(&rng, ncand);
+            }
+        }
+
+        cbox_t cb = cbox_create();
+        char name[16];
+        for (int c = 0; c < ncand; ++c) {
+            sprintf(name, "C%d", c);
+            cbox_intern(cb, name);
+        }
+        size_t nballots = 1 + rng_below(&rng, 10);
+        size_t kind_of[10];
+        for (size_t i = 0; i < nballots; ++i) {
+            kind_of[i] = rng_below(&rng, 4);
+            cbox_push(cb, kinds[kind_of[i]], kind_len[kind_of[i]]);
+        }
+
+        struct margin m;
+        CHECK(margin_compute(cb, 1, &m));
+        CHECK(m.lower <= m.upper);
+        if (m.upper == SIZE_MAX) {
+            cbox_destroy(cb);
+            continue;
+        }
+
+        bool found = false;
+        for (unsigned set = 0; !found && set < 1u << nballots; ++set) {
+            size_t size = 0;
+            for (size_t i = 0; i < nballots; ++i) {
+                size += (set >> i) & 1;
+            }
+            if (size != m.upper) {
+                continue;
+            }
+
+            cbox_t changed = cbox_create();
+            for (int c = 0; c < ncand; ++c) {
+                sprintf(name, "C%d", c);
+                cbox_intern(changed, name);
+            }
+            bool ok = true;
+            for (size_t i = 0; i < nballots; ++i) {
+                const cand_t* ranks = kinds[kind_of[i]];
+                if (set & (1u << i)) {
+                    ok = ok && ranks[0] == m.winner;
+                    cbox_push(changed, &m.challenger, 1);
+                } else {
+                    cbox_push(changed, ranks, kind_len[kind_of[i]]);
+                }
+            }
+            found = ok && tab_run(tab, changed, NULL) != m.winner;
+            cbox_destroy(changed);
+        }
+        CHECK(found);
+
+        cbox_destroy(cb);
+    }
+
+    tab_destroy(tab);
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+// Builds a ballot box from "%"-separated names, as `build_ballot_box`
+// in test_ballot_box.c does. Returns ownership to the caller.
+static ballot_box_t
+build_ballot_box(va_list ap)
+{
+    ballot_box_t bb = empty_ballot_box;
+    ballot_t ballot = NULL;
+
+    char* name;
+    while ((name = va_arg(ap, char*))) {
+        if (!ballot) {
+            ballot = ballot_create();
+        }
+
+        if (strcmp(name, "%") == 0) {
+            bb_insert(&bb, ballot);
+            ballot = NULL;
+        } else {
+            ballot_insert(ballot, strdupb(name, "check_margin"));
+        }
+    }
+
+    if (ballot) {
+        bb_insert(&bb, ballot);
+    }
+
+    return bb;
+}
+
+static void
+check_margin(const char* expected_winner,
+             size_t expected_lower,
+             size_t expected_upper,
+             ...)
+{
+    va_list ap;
+    va_start(ap, expected_upper);
+    ballot_box_t bb = build_ballot_box(ap);
+    va_end(ap);
+
+    cbox_t cb = cbox_from_bb(bb);
+    tabulator_t tab = tab_create();
+    CHECK_STRING(cbox_name(cb, tab_run(tab, cb, NULL)), expected_winner);
+    tab_destroy(tab);
+
+    char* reference = get_irv_winner(bb);
+    CHECK_STRING(reference, expected_winner);
+    free(reference);
+
+    struct margin m;
+    CHECK(margin_compute(cb, 2, &m));
+    CHECK_STRING(cbox_name(cb, m.winner), expected_winner);
+    CHECK_SIZE(m.lower, expected_lower);
+    CHECK_SIZE(m.upper, expected_upper);
+
+    cbox_destroy(cb);
+    bb_destroy(bb);
+}
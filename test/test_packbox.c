@@ -0,0 +1,147 @@
+///
+/// Tests for functions in ../src/packbox.c.
+///
+
+#include "cbox.h"
+#include "helpers.h"
+#include "packbox.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+static void test_small(void);
+static void test_empty(void);
+static void test_batches(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_small();
+    test_empty();
+    test_batches();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_small(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    cbox_t cb = cbox_create();
+    cand_t a = cbox_intern(cb, "A");
+    cand_t b = cbox_intern(cb, "B");
+    cand_t c = cbox_intern(cb, "C");
+    cbox_push(cb, (cand_t[]) {a, b, c}, 3);
+    cbox_push(cb, (cand_t[]) {c}, 1);
+    cbox_push(cb, NULL, 0);
+
+    // Ids up to 2 take 2 bits, and lengths up to 3 take 2 bits.
+    packbox_t pb = packbox_create();
+    packbox_append(pb, cb);
+    CHECK_SIZE(packbox_size(pb), 3);
+    CHECK_SIZE(packbox_candidates(pb), 3);
+    CHECK_SIZE(packbox_bits(pb), 3 * 4 + 4 * 2);
+
+    // A and C tie 1-1; C's ballot is later, so A goes out and its
+    // ballot moves to B, then B and C tie and B goes out.
+    cand_t order[3];
+    size_t neliminated;
+    CHECK_INT(packbox_run(pb, NULL, order, &neliminated), c);
+    CHECK_SIZE(neliminated, 2);
+    CHECK_INT(order[0], a);
+    CHECK_INT(order[1], b);
+
+    // With C withdrawn, A wins outright, though the last count left
+    // the first ballot's cursor at C.
+    bool withdrawn[] = {false, false, true};
+    CHECK_INT(packbox_run(pb, withdrawn, NULL, &neliminated), a);
+    CHECK_SIZE(neliminated, 0);
+
+    packbox_destroy(pb);
+    cbox_destroy(cb);
+}
+
+static void test_empty(void)
+{
+    cbox_t cb = cbox_create();
+    packbox_t pb = packbox_create();
+    CHECK_INT(packbox_run(pb, NULL, NULL, NULL), CAND_NONE);
+
+    cbox_push(cb, NULL, 0);
+    packbox_append(pb, cb);
+    CHECK_SIZE(packbox_bits(pb), 0);
+    CHECK_INT(packbox_run(pb, NULL, NULL, NULL), CAND_NONE);
+
+    packbox_destroy(pb);
+    cbox_destroy(cb);
+}
+
+// A box built up in batches through a cleared `cbox_t`, where later
+// batches add candidates and longer ballots and so widen the fields,
+// matches a tabulator counting all the ballots at once, and counting it
+// again from the cursors the last count left comes out the same.
+static void test_batches(void)
+{
+    struct rng rng;
+    rng_seed(&rng, 44, 0);
+
+    int ncand = MAX_CANDIDATES < 20 ? MAX_CANDIDATES : 20;
+    tabulator_t tab = tab_create();
+    cbox_t all   = cbox_create();
+    cbox_t batch = cbox_create();
+    packbox_t pb = packbox_create();
+    cand_t order[20];
+    char name[16];
+
+    for (int k = 1; k <= ncand; ++k) {
+        cbox_clear(batch);
+        for (int c = 0; c < k; ++c) {
+            sprintf(name, "C%d", c);
+            cbox_intern(batch, name);
+            cbox_intern(all, name);
+        }
+
+        for (int i = 0; i < 50; ++i) {
+            cand_t ranks[MAX_CANDIDATES];
+            size_t len = rng_below(&rng, k + 1);
+            for (size_t j = 0; j < len; ++j) {
+                ranks[j] = (cand_t) rng_below(&rng, k);
+            }
+            cbox_push(batch, ranks, len);
+            cbox_push(all, ranks, len);
+        }
+        packbox_append(pb, batch);
+
+        CHECK_SIZE(packbox_size(pb), cbox_size(all));
+        CHECK_SIZE(packbox_candidates(pb), (size_t) k);
+
+        cand_t winner = tab_run(tab, all, NULL);
+        size_t neliminated;
+        CHECK_INT(packbox_run(pb, NULL, order, &neliminated), winner);
+        CHECK_SIZE(neliminated, tab_eliminations(tab));
+        for (size_t e = 0; e < neliminated; ++e) {
+            CHECK_INT(order[e], tab_eliminated(tab, e));
+        }
+        CHECK_INT(packbox_run(pb, NULL, NULL, NULL), winner);
+    }
+
+    packbox_destroy(pb);
+    cbox_destroy(batch);
+    cbox_destroy(all);
+    tab_destroy(tab);
+}
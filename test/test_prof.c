@@ -0,0 +1,127 @@
+///
+/// Tests for functions in ../src/prof.c.
+///
+
+#include "ballot_box.h"
+#include "helpers.h"
+#include "prof.h"
+
+#include <ipd.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+// Adds a ballot ranking the `n` names in `names` to `*bbp`.
+static void add_ballot(ballot_box_t* bbp, const char* names[], size_t n);
+
+static void test_disabled(void);
+static void test_phases(void);
+static void test_irv_phases(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_disabled();
+    test_phases();
+    test_irv_phases();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_disabled(void)
+{
+    // Before `prof_start`, the hooks do nothing.
+    prof_enter(PROF_INGEST);
+    prof_leave(PROF_INGEST);
+    CHECK_SIZE(prof_calls(PROF_INGEST), 0);
+    CHECK_STRING(prof_phase_name(PROF_ELIMINATE), "eliminate");
+}
+
+static void test_phases(void)
+{
+    int why = 0;
+    size_t opened = prof_start(&why);
+    CHECK(opened <= PROF_NCOUNTERS);
+    CHECK(opened > 0 || why != 0);
+
+    volatile uint64_t sink = 0;
+    for (int i = 0; i < 3; ++i) {
+        prof_enter(PROF_COUNT);
+        for (uint64_t k = 0; k < 1000000; ++k) {
+            sink += k;
+        }
+        prof_leave(PROF_COUNT);
+    }
+    prof_stop();
+
+    // Hooks after `prof_stop` are ignored; the totals stay.
+    prof_enter(PROF_COUNT);
+    prof_leave(PROF_COUNT);
+
+    CHECK_SIZE(prof_calls(PROF_COUNT), 3);
+    CHECK_SIZE(prof_calls(PROF_INGEST), 0);
+    CHECK(prof_nanos(PROF_COUNT) > 0);
+
+    // Whatever counters there are saw the loop.
+    uint64_t instructions;
+    if (prof_value(PROF_COUNT, PROF_INSTRUCTIONS, &instructions)) {
+        CHECK(instructions >= 3000000);
+    }
+
+    // A fresh start clears the totals.
+    prof_start(NULL);
+    prof_stop();
+    CHECK_SIZE(prof_calls(PROF_COUNT), 0);
+}
+
+static void test_irv_phases(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    // A wins in the second round, after C is eliminated.
+    ballot_box_t bb = empty_ballot_box;
+    add_ballot(&bb, (const char*[]) {"A"}, 1);
+    add_ballot(&bb, (const char*[]) {"A"}, 1);
+    add_ballot(&bb, (const char*[]) {"B"}, 1);
+    add_ballot(&bb, (const char*[]) {"B"}, 1);
+    add_ballot(&bb, (const char*[]) {"C", "A"}, 2);
+
+    prof_start(NULL);
+    char* winner = get_irv_winner(bb);
+    prof_stop();
+
+    CHECK_STRING(winner, "A");
+    CHECK_SIZE(prof_calls(PROF_COUNT), 2);
+    CHECK_SIZE(prof_calls(PROF_SELECT), 2);
+    CHECK_SIZE(prof_calls(PROF_ELIMINATE), 1);
+    CHECK_SIZE(prof_calls(PROF_INGEST), 0);
+
+    free(winner);
+    bb_destroy(bb);
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+static void add_ballot(ballot_box_t* bbp, const char* names[], size_t n)
+{
+    ballot_t ballot = ballot_create();
+    for (size_t i = 0; i < n; ++i) {
+        ballot_insert(ballot, strdupb(names[i], "add_ballot"));
+    }
+    bb_insert(bbp, ballot);
+}
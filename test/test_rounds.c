@@ -0,0 +1,335 @@
+///
+/// Tests for functions in ../src/rounds.c, and the round history in
+/// ../src/tabulate.c that they read.
+///
+
+#include "cbox.h"
+#include "helpers.h"
+#include "rounds.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+// Returns a box of eight ballots over A, B, C and D that takes three
+// rounds: D is eliminated, then B (tied with C), then A wins with two
+// ballots exhausted.
+static cbox_t sample_box(void);
+
+// Returns what `rounds_write` writes for `tab` in `format`.
+static char* render(cbox_t cb, tabulator_t tab, enum rounds_format format);
+
+// Checks that replaying the history of `tab`'s finished count gives the
+// tallies and totals in `counts` and `totals`, which hold
+// `tab_rounds(tab)` rounds of `ncand` tallies each.
+static void check_history(tabulator_t tab, size_t ncand,
+                          const size_t* counts, const size_t* totals);
+
+// Runs a count of `cb` round by round, saving each round's tallies in
+// `counts` and totals in `totals` (as `check_history` reads them), and
+// returns the number of rounds.
+static size_t count_live(cbox_t cb, size_t* counts, size_t* totals);
+
+static void test_parse_format(void);
+static void test_csv(void);
+static void test_json(void);
+static void test_text(void);
+static void test_withdrawn(void);
+static void test_no_ballots(void);
+static void test_history(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_parse_format();
+    test_csv();
+    test_json();
+    test_text();
+    test_withdrawn();
+    test_no_ballots();
+    test_history();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_parse_format(void)
+{
+    enum rounds_format format = ROUNDS_TEXT;
+    CHECK(rounds_parse_format("csv", &format));
+    CHECK_INT(format, ROUNDS_CSV);
+    CHECK(rounds_parse_format("json", &format));
+    CHECK_INT(format, ROUNDS_JSON);
+    CHECK(rounds_parse_format("text", &format));
+    CHECK_INT(format, ROUNDS_TEXT);
+    CHECK(!rounds_parse_format("CSV", &format));
+    CHECK(!rounds_parse_format("", &format));
+    CHECK_INT(format, ROUNDS_TEXT);
+}
+
+static void test_csv(void)
+{
+    cbox_t cb = sample_box();
+    tabulator_t tab = tab_create();
+    tab_run(tab, cb, NULL);
+
+    char* text = render(cb, tab, ROUNDS_CSV);
+    CHECK_STRING(text,
+                 "round,candidate,votes,transfer,status\n"
+                 "1,A,3,0,continuing\n"
+                 "1,B,2,0,continuing\n"
+                 "1,C,2,0,continuing\n"
+                 "1,D,1,0,eliminated\n"
+                 "1,(exhausted),0,0,\n"
+                 "2,A,3,0,continuing\n"
+                 "2,B,2,0,eliminated\n"
+                 "2,C,2,0,continuing\n"
+                 "2,(exhausted),1,1,\n"
+                 "3,A,4,1,elected\n"
+                 "3,C,2,0,continuing\n"
+                 "3,(exhausted),2,1,\n");
+
+    free(text);
+    tab_destroy(tab);
+    cbox_destroy(cb);
+}
+
+static void test_json(void)
+{
+    cbox_t cb = sample_box();
+    tabulator_t tab = tab_create();
+    tab_run(tab, cb, NULL);
+
+    char* text = render(cb, tab, ROUNDS_JSON);
+    CHECK_STRING(text,
+                 "{\"ballots\": 8, \"winner\": \"A\",\n"
+                 " \"rounds\": [\n"
+                 "    {\"round\": 1, \"continuing\": 8, \"exhausted\": 0,\n"
+                 "     \"tallies\": {\"A\": 3, \"B\": 2, \"C\": 2, \"D\": 1},\n"
+                 "     \"transfers\": {},\n"
+                 "     \"eliminated\": \"D\"},\n"
+                 "    {\"round\": 2, \"continuing\": 7, \"exhausted\": 1,\n"
+                 "     \"tallies\": {\"A\": 3, \"B\": 2, \"C\": 2},\n"
+                 "     \"transfers\": {},\n"
+                 "     \"eliminated\": \"B\"},\n"
+                 "    {\"round\": 3, \"continuing\": 6, \"exhausted\": 2,\n"
+                 "     \"tallies\": {\"A\": 4, \"C\": 2},\n"
+                 "     \"transfers\": {\"A\": 1},\n"
+                 "     \"eliminated\": null}\n"
+                 " ]}\n");
+
+    free(text);
+    tab_destroy(tab);
+    cbox_destroy(cb);
+}
+
+static void test_text(void)
+{
+    cbox_t cb = sample_box();
+    tabulator_t tab = tab_create();
+    tab_run(tab, cb, NULL);
+
+    char* text = render(cb, tab, ROUNDS_TEXT);
+    CHECK_STRING(text,
+                 "1 8 A=3 B=2 C=2 D=1; out D\n"
+                 "2 7 A=3 B=2 C=2; out B\n"
+                 "3 6 A=4 C=2; won A\n");
+
+    free(text);
+    tab_destroy(tab);
+    cbox_destroy(cb);
+}
+
+static void test_withdrawn(void)
+{
+    cbox_t cb = sample_box();
+    tabulator_t tab = tab_create();
+    bool withdrawn[4] = { false, false, false, true };
+    tab_run(tab, cb, withdrawn);
+
+    // D never appears; its one ballot is exhausted from the start.
+    char* text = render(cb, tab, ROUNDS_CSV);
+    CHECK_STRING(text,
+                 "round,candidate,votes,transfer,status\n"
+                 "1,A,3,0,continuing\n"
+                 "1,B,2,0,eliminated\n"
+                 "1,C,2,0,continuing\n"
+                 "1,(exhausted),1,0,\n"
+                 "2,A,4,1,elected\n"
+                 "2,C,2,0,continuing\n"
+                 "2,(exhausted),2,1,\n");
+
+    free(text);
+    tab_destroy(tab);
+    cbox_destroy(cb);
+}
+
+static void test_no_ballots(void)
+{
+    cbox_t cb = cbox_create();
+    tabulator_t tab = tab_create();
+    tab_run(tab, cb, NULL);
+
+    char* text = render(cb, tab, ROUNDS_TEXT);
+    CHECK_STRING(text, "1 0; none\n");
+    free(text);
+
+    text = render(cb, tab, ROUNDS_JSON);
+    CHECK_STRING(text,
+                 "{\"ballots\": 0, \"winner\": null,\n"
+                 " \"rounds\": [\n"
+                 "    {\"round\": 1, \"continuing\": 0, \"exhausted\": 0,\n"
+                 "     \"tallies\": {},\n"
+                 "     \"transfers\": {},\n"
+                 "     \"eliminated\": null}\n"
+                 " ]}\n");
+    free(text);
+
+    tab_destroy(tab);
+    cbox_destroy(cb);
+}
+
+// Random elections, the history of each checked against a live count,
+// both from scratch and after `tab_append` adds ballots.
+static void test_history(void)
+{
+    enum { NCAND = 8, ROUNDS = NCAND + 1 };
+    struct rng rng;
+    rng_seed(&rng, 40, 0);
+
+    size_t counts[ROUNDS * NCAND];
+    size_t totals[ROUNDS];
+
+    for (int trial = 0; trial < 200; ++trial) {
+        cbox_t cb = cbox_create();
+        char name[16];
+        for (int c = 0; c < NCAND; ++c) {
+            sprintf(name, "C%c", 'A' + c);
+            cbox_intern(cb, name);
+        }
+
+        tabulator_t tab = tab_create();
+        size_t depth = MAX_CANDIDATES < NCAND ? MAX_CANDIDATES : NCAND;
+        for (int batch = 0; batch < 2; ++batch) {
+            size_t nballots = rng_below(&rng, 80);
+            for (size_t i = 0; i < nballots; ++i) {
+                cand_t ranks[NCAND];
+                size_t len = rng_below(&rng, depth + 1);
+                for (size_t j = 0; j < len; ++j) {
+                    ranks[j] = (cand_t) rng_below(&rng, NCAND);
+                }
+                cbox_push(cb, ranks, len);
+            }
+
+            if (batch == 0) {
+                tab_start(tab, cb, NULL);
+            } else {
+                tab_append(tab, cb);
+            }
+            while (tab_round(tab)) {
+                continue;
+            }
+
+            size_t nrounds = count_live(cb, counts, totals);
+            CHECK_SIZE(tab_rounds(tab), nrounds);
+            check_history(tab, NCAND, counts, totals);
+        }
+
+        tab_destroy(tab);
+        cbox_destroy(cb);
+    }
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+static cbox_t sample_box(void)
+{
+    cbox_t cb = cbox_create();
+    cand_t a = cbox_intern(cb, "A");
+    cand_t b = cbox_intern(cb, "B");
+    cand_t c = cbox_intern(cb, "C");
+    cand_t d = cbox_intern(cb, "D");
+
+    cbox_push(cb, (cand_t[]) {a}, 1);
+    cbox_push(cb, (cand_t[]) {a}, 1);
+    cbox_push(cb, (cand_t[]) {a}, 1);
+    cbox_push(cb, (cand_t[]) {b, a}, 2);
+    cbox_push(cb, (cand_t[]) {b}, 1);
+    cbox_push(cb, (cand_t[]) {c, b}, 2);
+    cbox_push(cb, (cand_t[]) {c}, 1);
+    cbox_push(cb, (cand_t[]) {d}, 1);
+    return cb;
+}
+
+static char* render(cbox_t cb, tabulator_t tab, enum rounds_format format)
+{
+    FILE* f = tmpfile();
+    if (f == NULL) {
+        perror("tmpfile");
+        exit(1);
+    }
+    rounds_write(f, cb, tab, format);
+
+    long size = ftell(f);
+    char* text = mallocb((size_t) size + 1, "render");
+    rewind(f);
+    size_t got = fread(text, 1, (size_t) size, f);
+    text[got] = 0;
+    fclose(f);
+    return text;
+}
+
+static void check_history(tabulator_t tab, size_t ncand,
+                          const size_t* counts, const size_t* totals)
+{
+    size_t replayed[16] = {0};
+    for (size_t r = 0; r < tab_rounds(tab); ++r) {
+        size_t n;
+        const struct tab_change* changes = tab_round_changes(tab, r, &n);
+        for (size_t j = 0; j < n; ++j) {
+            replayed[changes[j].cand] = changes[j].count;
+        }
+
+        CHECK_SIZE(tab_round_total(tab, r), totals[r]);
+        for (size_t c = 0; c < ncand; ++c) {
+            CHECK_SIZE(replayed[c], counts[r * ncand + c]);
+        }
+    }
+}
+
+static size_t count_live(cbox_t cb, size_t* counts, size_t* totals)
+{
+    size_t ncand = cbox_candidates(cb);
+    tabulator_t live = tab_create();
+    tab_start(live, cb, NULL);
+
+    size_t r = 0;
+    bool more;
+    do {
+        totals[r] = tab_total(live);
+        for (size_t c = 0; c < ncand; ++c) {
+            counts[r * ncand + c] = tab_count(live, (cand_t) c);
+        }
+        ++r;
+        more = tab_round(live);
+    } while (more);
+
+    tab_destroy(live);
+    return r;
+}
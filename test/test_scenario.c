@@ -0,0 +1,222 @@
+///
+/// Tests for functions in ../src/scenario.c.
+///
+
+#include "cbox.h"
+#include "helpers.h"
+#include "scenario.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+#define NCAND 6
+
+// Returns a random box over NCAND candidates.
+static cbox_t random_box(struct rng* rng);
+
+// Returns a copy of `cb` with every ballot cut to its first `depth`
+// choices.
+static cbox_t truncated(cbox_t cb, size_t depth);
+
+static void test_tiebreaks(void);
+static void test_matches_tabulator(void);
+static void test_threads(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_tiebreaks();
+    test_matches_tabulator();
+    test_threads();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_tiebreaks(void)
+{
+    // A and B tie with one vote each; by ballot order A goes out first
+    // (its last ballot is earlier), and by listing order B does.
+    cbox_t cb = cbox_create();
+    cand_t a = cbox_intern(cb, "A");
+    cand_t b = cbox_intern(cb, "B");
+    cbox_push(cb, (cand_t[]) {a}, 1);
+    cbox_push(cb, (cand_t[]) {b}, 1);
+
+    struct scenario scenarios[] = {
+        { .tiebreak = SCEN_TIE_BALLOTS },
+        { .tiebreak = SCEN_TIE_LISTED },
+        { .tiebreak = SCEN_TIE_LOT, .seed = 1 },
+        { .tiebreak = SCEN_TIE_LOT, .seed = 1 },
+    };
+    struct scen_result results[4];
+    scen_run(cb, scenarios, 4, results, 2);
+
+    CHECK_INT(results[0].winner, b);
+    CHECK_SIZE(results[0].rounds, 2);
+    CHECK_SIZE(results[0].votes, 1);
+    CHECK_SIZE(results[0].continuing, 1);
+    CHECK_INT(results[1].winner, a);
+    CHECK_INT(results[2].winner, results[3].winner);
+
+    // Lots drawn from different seeds go both ways.
+    enum { NLOTS = 32 };
+    struct scenario lots[NLOTS];
+    struct scen_result lot_results[NLOTS];
+    for (size_t k = 0; k < NLOTS; ++k) {
+        lots[k] = (struct scenario) { .tiebreak = SCEN_TIE_LOT, .seed = k };
+    }
+    scen_run(cb, lots, NLOTS, lot_results, 0);
+    size_t a_wins = 0;
+    for (size_t k = 0; k < NLOTS; ++k) {
+        CHECK(lot_results[k].winner == a || lot_results[k].winner == b);
+        a_wins += lot_results[k].winner == a;
+    }
+    CHECK(a_wins > 0 && a_wins < NLOTS);
+
+    // The same box with no ballots has no winner.
+    cbox_t empty = cbox_create();
+    scen_run(empty, scenarios, 2, results, 0);
+    CHECK_INT(results[1].winner, CAND_NONE);
+    CHECK_SIZE(results[1].rounds, 1);
+
+    cbox_destroy(empty);
+    cbox_destroy(cb);
+}
+
+// Withdrawals and truncation, checked against a tabulator counting a
+// truncated copy of the box.
+static void test_matches_tabulator(void)
+{
+    struct rng rng;
+    rng_seed(&rng, 41, 0);
+
+    tabulator_t tab = tab_create();
+    bool withdrawn[NCAND];
+
+    for (int trial = 0; trial < 100; ++trial) {
+        cbox_t cb = random_box(&rng);
+        for (size_t c = 0; c < NCAND; ++c) {
+            withdrawn[c] = c == (size_t) trial % NCAND;
+        }
+
+        struct scenario scenarios[2 * (NCAND + 1)];
+        struct scen_result results[2 * (NCAND + 1)];
+        for (size_t depth = 0; depth <= NCAND; ++depth) {
+            scenarios[2 * depth]     = (struct scenario) { .depth = depth };
+            scenarios[2 * depth + 1] = (struct scenario) {
+                .depth = depth, .withdrawn = withdrawn
+            };
+        }
+        scen_run(cb, scenarios, 2 * (NCAND + 1), results, 3);
+
+        for (size_t depth = 0; depth <= NCAND; ++depth) {
+            cbox_t cut = truncated(cb, depth);
+            for (size_t w = 0; w < 2; ++w) {
+                const struct scen_result* r = &results[2 * depth + w];
+                cand_t winner = tab_run(tab, cut, w ? withdrawn : NULL);
+                CHECK_INT(r->winner, winner);
+                CHECK_SIZE(r->rounds, tab_rounds(tab));
+                CHECK_SIZE(r->continuing, tab_total(tab));
+                if (winner != CAND_NONE) {
+                    CHECK_SIZE(r->votes, tab_count(tab, winner));
+                }
+            }
+            cbox_destroy(cut);
+        }
+
+        cbox_destroy(cb);
+    }
+
+    tab_destroy(tab);
+}
+
+// Fifty scenarios come out the same on one thread as on several.
+static void test_threads(void)
+{
+    enum { N = 50 };
+    struct rng rng;
+    rng_seed(&rng, 42, 0);
+    cbox_t cb = random_box(&rng);
+
+    bool withdrawn[N][NCAND];
+    struct scenario scenarios[N];
+    for (size_t k = 0; k < N; ++k) {
+        for (size_t c = 0; c < NCAND; ++c) {
+            withdrawn[k][c] = rng_below(&rng, 4) == 0;
+        }
+        scenarios[k] = (struct scenario) {
+            .withdrawn = withdrawn[k],
+            .depth     = rng_below(&rng, NCAND + 1),
+            .tiebreak  = (enum scen_tiebreak) rng_below(&rng, 3),
+            .seed      = k,
+        };
+    }
+
+    struct scen_result one[N], many[N];
+    scen_run(cb, scenarios, N, one, 1);
+    scen_run(cb, scenarios, N, many, 4);
+    for (size_t k = 0; k < N; ++k) {
+        CHECK_INT(one[k].winner, many[k].winner);
+        CHECK_SIZE(one[k].rounds, many[k].rounds);
+        CHECK_SIZE(one[k].votes, many[k].votes);
+        CHECK_SIZE(one[k].continuing, many[k].continuing);
+    }
+
+    cbox_destroy(cb);
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+static cbox_t random_box(struct rng* rng)
+{
+    cbox_t cb = cbox_create();
+    char name[16];
+    for (int c = 0; c < NCAND; ++c) {
+        sprintf(name, "C%c", 'A' + c);
+        cbox_intern(cb, name);
+    }
+
+    size_t depth    = MAX_CANDIDATES < NCAND ? MAX_CANDIDATES : NCAND;
+    size_t nballots = rng_below(rng, 200);
+    for (size_t i = 0; i < nballots; ++i) {
+        cand_t ranks[NCAND];
+        size_t len = rng_below(rng, depth + 1);
+        for (size_t j = 0; j < len; ++j) {
+            ranks[j] = (cand_t) rng_below(rng, NCAND);
+        }
+        cbox_push(cb, ranks, len);
+    }
+    return cb;
+}
+
+static cbox_t truncated(cbox_t cb, size_t depth)
+{
+    cbox_t cut = cbox_create();
+    for (size_t c = 0; c < cbox_candidates(cb); ++c) {
+        cbox_intern(cut, cbox_name(cb, (cand_t) c));
+    }
+    for (size_t i = 0; i < cbox_size(cb); ++i) {
+        size_t len;
+        const cand_t* ranks = cbox_ballot(cb, i, &len);
+        cbox_push(cut, ranks, depth > 0 && len > depth ? depth : len);
+    }
+    return cut;
+}
@@ -0,0 +1,442 @@
+///
+/// Tests for functions in ../src/server.c.
+///
+
+#include "cbox.h"
+#include "rounds.h"
+#include "server.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+// One connection to the server under test.
+struct conn
+{
+    FILE* in;
+    FILE* out;
+};
+
+// Starts `server_run` on a temporary socket, saved in `path`, in a
+// child process, and waits until it accepts connections.
+static pid_t start_server(char path[64]);
+
+// Stops the server with SIGTERM and checks that it exits cleanly.
+static void stop_server(pid_t pid, const char* path);
+
+static struct conn connect_to(const char* path);
+static void disconnect(struct conn c);
+
+// Sends a request line, formatted like `printf`.
+static void send_line(struct conn c, const char* format, ...);
+
+// Sends "BATCH <box> <nbytes>" and then the ballots in `text`.
+static void send_batch(struct conn c, const char* box, const char* text);
+
+// Reads one response line and checks that it is `expected`.
+static void expect_line(struct conn c, const char* expected);
+
+// Reads a response of an "OK <n>" line followed by `n` lines, and
+// returns it all as one string, newlines included.
+static char* read_listing(struct conn c);
+
+// Counts `text` into `*cb` and `*tab`, which the caller destroys.
+static void count(const char* text, cbox_t* cb, tabulator_t* tab);
+
+// Counts the ballots in `text` with `tab_run` and returns the winner's
+// name, or "-", and the round table, in the server's response format.
+static const char* expected_winner(const char* text, char winner[64]);
+static char* expected_rounds(const char* text);
+
+static void test_queries(void);
+static void test_errors(void);
+static void test_second_batch(void);
+static void test_concurrent(void);
+
+// The response to a BATCH with a bad <nbytes>.
+#define BAD_SIZE \
+        "ERR usage: BATCH <box> <nbytes> (nbytes at most 67108864)"
+
+// Ballots in which C is eliminated and then B beats A, 3 to 2.
+static const char* const FIRST_BATCH =
+        "A\n%\nA\n%\nB\nA\n%\nB\n%\nC\nB\n%\n";
+
+// Ballots that turn the count around: A now wins.
+static const char* const SECOND_BATCH =
+        "A\n%\nC\nA\n%\nC\nA\n%\n";
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_queries();
+    test_errors();
+    test_second_batch();
+    test_concurrent();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_queries(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    char path[64];
+    pid_t pid = start_server(path);
+    struct conn c = connect_to(path);
+
+    send_batch(c, "box", FIRST_BATCH);
+    expect_line(c, "OK 5 5");
+
+    send_line(c, "WINNER box");
+    expect_line(c, "OK B");
+
+    send_line(c, "TALLY box");
+    char* tally = read_listing(c);
+    CHECK_STRING(tally, "OK 3\nA 2\nB 2\nC 1\n");
+    free(tally);
+
+    send_line(c, "ROUNDS box");
+    char* rounds   = read_listing(c);
+    char* expected = expected_rounds(FIRST_BATCH);
+    CHECK_STRING(rounds, expected);
+    free(rounds);
+    free(expected);
+
+    send_line(c, "DROP box");
+    expect_line(c, "OK");
+    send_line(c, "WINNER box");
+    expect_line(c, "ERR no such box: box");
+
+    send_line(c, "QUIT");
+    disconnect(c);
+    stop_server(pid, path);
+}
+
+static void test_errors(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    char path[64];
+    pid_t pid = start_server(path);
+
+    // A bad size closes the connection, since the batch can't be
+    // skipped.
+    struct conn c = connect_to(path);
+    send_line(c, "BATCH box lots");
+    expect_line(c, BAD_SIZE);
+    CHECK_POINTER(fread_line(c.in), NULL);
+    disconnect(c);
+
+    c = connect_to(path);
+    send_line(c, "BATCH box %zu", SERVER_MAX_BATCH + 1);
+    expect_line(c, BAD_SIZE);
+    CHECK_POINTER(fread_line(c.in), NULL);
+    disconnect(c);
+
+    // A ballot with too many names is rejected, leaving the box as it
+    // was; so is a batch that brings in too many candidates.
+    c = connect_to(path);
+    send_batch(c, "box", FIRST_BATCH);
+    expect_line(c, "OK 5 5");
+
+    char overfull[2 * (MAX_CANDIDATES + 1) + 3] = "";
+    for (int i = 0; i <= MAX_CANDIDATES; ++i) {
+        strcat(overfull, (char[]) {(char) ('A' + i), '\n', 0});
+    }
+    strcat(overfull, "%\n");
+    send_batch(c, "box", overfull);
+    expect_line(c, "ERR ballot with too many names");
+
+    // Each of these ballots is fine, but with A, B and C there is one
+    // candidate too many for the box.
+    size_t nnew    = CBOX_MAX_CANDIDATES - 2;
+    char*  crowded = malloc(7 * nnew + 1);
+    for (size_t i = 0; i < nnew; ++i) {
+        char* p = crowded + 7 * i;
+        size_t k = i;
+        for (int j = 3; j >= 0; --j, k /= 26) {
+            p[j] = (char) ('A' + k % 26);
+        }
+        memcpy(p + 4, "\n%\n", 3);
+    }
+    crowded[7 * nnew] = 0;
+    send_batch(c, "box", crowded);
+    expect_line(c, "ERR too many candidates");
+    free(crowded);
+
+    send_line(c, "TALLY box");
+    char* tally = read_listing(c);
+    CHECK_STRING(tally, "OK 3\nA 2\nB 2\nC 1\n");
+    free(tally);
+    send_line(c, "WINNER box");
+    expect_line(c, "OK B");
+
+    send_line(c, "FROB box");
+    expect_line(c, "ERR unknown request: FROB");
+    send_line(c, "WINNER");
+    expect_line(c, "ERR missing box name");
+
+    send_line(c, "QUIT");
+    disconnect(c);
+    stop_server(pid, path);
+}
+
+static void test_second_batch(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    char path[64];
+    pid_t pid = start_server(path);
+    struct conn c = connect_to(path);
+
+    send_batch(c, "box", FIRST_BATCH);
+    expect_line(c, "OK 5 5");
+    send_line(c, "WINNER box");
+    expect_line(c, "OK B");
+    send_line(c, "ROUNDS box");
+    free(read_listing(c));
+
+    // The second batch is counted onto the first, and must agree with
+    // a count of both from scratch.
+    send_batch(c, "box", SECOND_BATCH);
+    expect_line(c, "OK 3 8");
+
+    size_t len = strlen(FIRST_BATCH) + strlen(SECOND_BATCH);
+    char*  both = malloc(len + 1);
+    strcpy(both, FIRST_BATCH);
+    strcat(both, SECOND_BATCH);
+
+    char winner[64];
+    send_line(c, "WINNER box");
+    expect_line(c, expected_winner(both, winner));
+    CHECK_STRING(winner, "OK A");
+
+    send_line(c, "ROUNDS box");
+    char* rounds   = read_listing(c);
+    char* expected = expected_rounds(both);
+    CHECK_STRING(rounds, expected);
+    free(rounds);
+    free(expected);
+    free(both);
+
+    send_line(c, "QUIT");
+    disconnect(c);
+    stop_server(pid, path);
+}
+
+static void test_concurrent(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    char path[64];
+    pid_t pid = start_server(path);
+
+    // One client sits idle, and another stops partway through a batch;
+    // neither holds up a third.
+    struct conn idle    = connect_to(path);
+    struct conn partial = connect_to(path);
+    send_line(partial, "BATCH box %zu", strlen(FIRST_BATCH));
+    fputs("A\n%\n", partial.out);
+    fflush(partial.out);
+
+    struct conn c = connect_to(path);
+    send_batch(c, "other", FIRST_BATCH);
+    expect_line(c, "OK 5 5");
+    send_line(c, "WINNER other");
+    expect_line(c, "OK B");
+
+    send_line(idle, "WINNER other");
+    expect_line(idle, "OK B");
+
+    // The stalled batch finishes, and is added to its own box.
+    fputs(FIRST_BATCH + 4, partial.out);
+    fflush(partial.out);
+    expect_line(partial, "OK 5 5");
+    send_line(c, "TALLY box");
+    char* tally = read_listing(c);
+    CHECK_STRING(tally, "OK 3\nA 2\nB 2\nC 1\n");
+    free(tally);
+
+    // Clients still connected don't keep the server from stopping.
+    disconnect(partial);
+    disconnect(c);
+    stop_server(pid, path);
+    disconnect(idle);
+}
+
+
+///
+/// HELPER FUNCTIONS
+///
+
+static pid_t start_server(char path[64])
+{
+    static int nservers = 0;
+    snprintf(path, 64, "/tmp/irv-test_server-%ld-%d.sock",
+             (long) getpid(), nservers++);
+
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("test_server: fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        _exit(server_run(path));
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strcpy(addr.sun_path, path);
+    for (int tries = 0; tries < 500; ++tries) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 &&
+                connect(fd, (struct sockaddr*) &addr, sizeof addr) == 0) {
+            close(fd);
+            return pid;
+        }
+        if (fd >= 0) close(fd);
+        usleep(10000);
+    }
+
+    fprintf(stderr, "test_server: server did not start at %s\n", path);
+    kill(pid, SIGKILL);
+    exit(1);
+}
+
+static void stop_server(pid_t pid, const char* path)
+{
+    kill(pid, SIGTERM);
+    int status;
+    CHECK_INT(waitpid(pid, &status, 0), pid);
+    CHECK(WIFEXITED(status));
+    CHECK_INT(WEXITSTATUS(status), 0);
+    CHECK_INT(access(path, F_OK), -1);
+}
+
+static struct conn connect_to(const char* path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof addr) != 0) {
+        perror("test_server: connect");
+        exit(1);
+    }
+
+    struct conn c = { fdopen(fd, "r"), fdopen(dup(fd), "w") };
+    if (c.in == NULL || c.out == NULL) {
+        perror("test_server: fdopen");
+        exit(1);
+    }
+    return c;
+}
+
+static void disconnect(struct conn c)
+{
+    fclose(c.in);
+    fclose(c.out);
+}
+
+static void send_line(struct conn c, const char* format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(c.out, format, ap);
+    va_end(ap);
+    fputc('\n', c.out);
+    fflush(c.out);
+}
+
+static void send_batch(struct conn c, const char* box, const char* text)
+{
+    fprintf(c.out, "BATCH %s %zu\n%s", box, strlen(text), text);
+    fflush(c.out);
+}
+
+static void expect_line(struct conn c, const char* expected)
+{
+    char* line = fread_line(c.in);
+    CHECK_STRING(line, expected);
+    free(line);
+}
+
+static char* read_listing(struct conn c)
+{
+    char*  text;
+    size_t size;
+    FILE*  listing = open_memstream(&text, &size);
+
+    char* line = fread_line(c.in);
+    size_t n   = 0;
+    CHECK(line != NULL && sscanf(line, "OK %zu", &n) == 1);
+    for (size_t i = 0; line != NULL; ++i) {
+        fprintf(listing, "%s\n", line);
+        free(line);
+        line = i < n ? fread_line(c.in) : NULL;
+    }
+
+    fclose(listing);
+    return text;
+}
+
+static void count(const char* text, cbox_t* cb, tabulator_t* tab)
+{
+    FILE* inf = fmemopen((char*) text, strlen(text), "r");
+    *cb  = cbox_create();
+    *tab = tab_create();
+    cbox_read(*cb, inf);
+    fclose(inf);
+    tab_run(*tab, *cb, NULL);
+}
+
+static const char* expected_winner(const char* text, char winner[64])
+{
+    cbox_t      cb;
+    tabulator_t tab;
+    count(text, &cb, &tab);
+    cand_t c = tab_winner(tab);
+    snprintf(winner, 64, "OK %s", c == CAND_NONE ? "-" : cbox_name(cb, c));
+    tab_destroy(tab);
+    cbox_destroy(cb);
+    return winner;
+}
+
+static char* expected_rounds(const char* text)
+{
+    cbox_t      cb;
+    tabulator_t tab;
+    count(text, &cb, &tab);
+
+    char*  rounds;
+    size_t size;
+    FILE*  outf = open_memstream(&rounds, &size);
+    fprintf(outf, "OK %zu\n", tab_rounds(tab));
+    rounds_write(outf, cb, tab, ROUNDS_TEXT);
+    fclose(outf);
+
+    tab_destroy(tab);
+    cbox_destroy(cb);
+    return rounds;
+}
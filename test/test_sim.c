@@ -0,0 +1,124 @@
+///
+/// Tests for functions in ../src/sim.c.
+///
+
+#include "sim.h"
+#include "libvc.h"
+
+#include <ipd.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+static void test_wins_add_up(void);
+static void test_same_for_any_worker_count(void);
+static void test_heavy_favorite(void);
+static void test_invalid_configs(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_wins_add_up();
+    test_same_for_any_worker_count();
+    test_heavy_favorite();
+    test_invalid_configs();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_wins_add_up(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    size_t wins[4];
+    struct sim_config config = {
+        .model      = SIM_SPATIAL,
+        .candidates = 3,
+        .voters     = 11,
+        .trials     = 1000,
+        .dimensions = 2,
+        .seed       = 7,
+    };
+
+    CHECK(sim_run(&config, wins));
+    CHECK_SIZE(wins[0] + wins[1] + wins[2], 1000);
+    CHECK_SIZE(wins[3], 0);
+
+    // No voters, no winners.
+    config.voters = 0;
+    CHECK(sim_run(&config, wins));
+    CHECK_SIZE(wins[3], 1000);
+}
+
+static void test_same_for_any_worker_count(void)
+{
+    if (MAX_CANDIDATES < 4) return;
+
+    size_t one[5], four[5];
+    struct sim_config config = {
+        .model      = SIM_IMPARTIAL,
+        .candidates = 4,
+        .voters     = 9,
+        .trials     = 777,
+        .depth      = 2,
+        .seed       = 12345,
+        .workers    = 1,
+    };
+
+    CHECK(sim_run(&config, one));
+    config.workers = 4;
+    CHECK(sim_run(&config, four));
+    CHECK(memcmp(one, four, sizeof one) == 0);
+}
+
+static void test_heavy_favorite(void)
+{
+    if (MAX_CANDIDATES < 3) return;
+
+    size_t wins[4];
+    double weights[] = {1000, 1, 1};
+    struct sim_config config = {
+        .model      = SIM_PLACKETT_LUCE,
+        .candidates = 3,
+        .voters     = 51,
+        .trials     = 200,
+        .weights    = weights,
+        .seed       = 3,
+    };
+
+    CHECK(sim_run(&config, wins));
+    CHECK_SIZE(wins[0], 200);
+}
+
+static void test_invalid_configs(void)
+{
+    size_t wins[MAX_CANDIDATES + 2];
+    struct sim_config config = {
+        .model      = SIM_IMPARTIAL,
+        .candidates = 0,
+        .voters     = 1,
+        .trials     = 1,
+    };
+
+    CHECK(! sim_run(&config, wins));
+
+    config.candidates = MAX_CANDIDATES + 1;
+    CHECK(! sim_run(&config, wins));
+
+    config.candidates = 1;
+    config.model      = SIM_SPATIAL;
+    config.dimensions = 0;
+    CHECK(! sim_run(&config, wins));
+}
@@ -0,0 +1,184 @@
+///
+/// Tests for functions in ../src/tabulate.c.
+///
+
+#include "cbox.h"
+#include "helpers.h"
+#include "tabulate.h"
+
+#include <ipd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+static void test_tab_rounds(void);
+static void test_tab_append(void);
+static void test_tab_append_random(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_tab_rounds();
+    test_tab_append();
+    test_tab_append_random();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_tab_rounds(void)
+{
+    cbox_t cb = cbox_create();
+    cand_t a = cbox_intern(cb, "A");
+    cand_t b = cbox_intern(cb, "B");
+    cand_t c = cbox_intern(cb, "C");
+
+    cbox_push(cb, (cand_t[]) {a}, 1);
+    cbox_push(cb, (cand_t[]) {a}, 1);
+    cbox_push(cb, (cand_t[]) {b, a}, 2);
+    cbox_push(cb, (cand_t[]) {b}, 1);
+    cbox_push(cb, (cand_t[]) {c, b}, 2);
+
+    tabulator_t tab = tab_create();
+    tab_start(tab, cb, NULL);
+    CHECK_SIZE(tab_total(tab), 5);
+    CHECK_SIZE(tab_count(tab, a), 2);
+    CHECK_SIZE(tab_count(tab, b), 2);
+    CHECK_SIZE(tab_count(tab, c), 1);
+
+    CHECK(tab_round(tab));
+    CHECK_INT(tab_eliminated(tab, 0), c);
+    CHECK_SIZE(tab_count(tab, b), 3);
+    CHECK(! tab_round(tab));
+    CHECK_INT(tab_winner(tab), b);
+
+    // Withdrawing B sends its first choices on to A or nowhere.
+    bool withdrawn[] = {false, true, false};
+    CHECK_INT(tab_run(tab, cb, withdrawn), a);
+    CHECK_SIZE(tab_total(tab), 4);
+
+    tab_destroy(tab);
+    cbox_destroy(cb);
+}
+
+static void test_tab_append(void)
+{
+    if (MAX_CANDIDATES < 4) return;
+
+    cbox_t cb = cbox_create();
+    cand_t a = cbox_intern(cb, "A");
+    cand_t b = cbox_intern(cb, "B");
+    cand_t c = cbox_intern(cb, "C");
+
+    cbox_push(cb, (cand_t[]) {a}, 1);
+    cbox_push(cb, (cand_t[]) {a}, 1);
+    cbox_push(cb, (cand_t[]) {b, a}, 2);
+    cbox_push(cb, (cand_t[]) {b}, 1);
+    cbox_push(cb, (cand_t[]) {c, b}, 2);
+
+    tabulator_t tab = tab_create();
+    CHECK_INT(tab_run(tab, cb, NULL), b);
+
+    // C's elimination still holds; B's lead grows.
+    cbox_push(cb, (cand_t[]) {b}, 1);
+    CHECK_SIZE(tab_append(tab, cb), 1);
+    CHECK(! tab_done(tab));
+    CHECK_SIZE(tab_count(tab, b), 4);
+    CHECK_SIZE(tab_total(tab), 6);
+    CHECK(! tab_round(tab));
+    CHECK_INT(tab_winner(tab), b);
+
+    // Now B goes out first instead of C, and a new candidate D appears.
+    cand_t d = cbox_intern(cb, "D");
+    cbox_push(cb, (cand_t[]) {c, a}, 2);
+    cbox_push(cb, (cand_t[]) {c}, 1);
+    cbox_push(cb, (cand_t[]) {c}, 1);
+    cbox_push(cb, (cand_t[]) {d, a}, 2);
+    CHECK_SIZE(tab_append(tab, cb), 0);
+    CHECK_SIZE(tab_count(tab, c), 4);
+    CHECK_SIZE(tab_count(tab, d), 1);
+    while (tab_round(tab)) {
+        continue;
+    }
+    CHECK_INT(tab_eliminated(tab, 0), d);
+    CHECK_INT(tab_winner(tab), a);
+
+    tab_destroy(tab);
+    cbox_destroy(cb);
+}
+
+// Appends random batches to random elections and checks each count
+// against a fresh one, round by round.
+static void test_tab_append_random(void)
+{
+    int ncand = MAX_CANDIDATES < 6 ? MAX_CANDIDATES : 6;
+    struct rng rng;
+    rng_seed(&rng, 29, 0);
+
+    tabulator_t tab   = tab_create();
+    tabulator_t fresh = tab_create();
+
+    for (int trial = 0; trial < 200; ++trial) {
+        cbox_t cb = cbox_create();
+        char name[16];
+        for (int c = 0; c < ncand; ++c) {
+            sprintf(name, "C%d", c);
+            cbox_intern(cb, name);
+        }
+
+        tab_start(tab, cb, NULL);
+        for (int batch = 0; batch < 4; ++batch) {
+            int nballots = 1 + (int) rng_below(&rng, 12);
+            for (int i = 0; i < nballots; ++i) {
+                cand_t ranks[MAX_CANDIDATES];
+                size_t len = rng_below(&rng, ncand + 1);
+                for (size_t j = 0; j < len; ++j) {
+                    ranks[j] = (cand_t) rng_below(&rng, ncand);
+                }
+                cbox_push(cb, ranks, len);
+            }
+
+            tab_append(tab, cb);
+            // Sometimes stop partway, sometimes finish.
+            size_t stop = rng_below(&rng, ncand + 1);
+            while (tab_eliminations(tab) < stop && tab_round(tab)) {
+                continue;
+            }
+
+            tab_start(fresh, cb, NULL);
+            while (tab_eliminations(fresh) < tab_eliminations(tab) &&
+                    tab_round(fresh)) {
+                continue;
+            }
+            CHECK_SIZE(tab_eliminations(tab), tab_eliminations(fresh));
+            CHECK_SIZE(tab_total(tab), tab_total(fresh));
+            for (int c = 0; c < ncand; ++c) {
+                CHECK_SIZE(tab_count(tab, (cand_t) c),
+                           tab_count(fresh, (cand_t) c));
+            }
+        }
+
+        while (tab_round(tab)) {
+            continue;
+        }
+        CHECK_INT(tab_winner(tab), tab_run(fresh, cb, NULL));
+        for (size_t k = 0; k < tab_eliminations(tab); ++k) {
+            CHECK_INT(tab_eliminated(tab, k), tab_eliminated(fresh, k));
+        }
+        cbox_destroy(cb);
+    }
+
+    tab_destroy(fresh);
+    tab_destroy(tab);
+}
@@ -0,0 +1,104 @@
+///
+/// Tests for functions in ../src/tally.c.
+///
+
+#include "helpers.h"
+#include "tabulate.h"
+#include "tally.h"
+
+#include <ipd.h>
+
+#include <stdlib.h>
+
+
+///
+/// FORWARD DECLARATIONS
+///
+
+static void test_empty(void);
+static void test_ties(void);
+static void test_matches_pick(void);
+
+
+///
+/// MAIN FUNCTION
+///
+
+int main(void)
+{
+    test_empty();
+    test_ties();
+    test_matches_pick();
+}
+
+
+///
+/// TEST CASE FUNCTIONS
+///
+
+static void test_empty(void)
+{
+    tally_t t = tally_create();
+    tally_reset(t, 3);
+    CHECK_INT(tally_max(t), CAND_NONE);
+    CHECK_INT(tally_min(t), CAND_NONE);
+    CHECK_SIZE(tally_total(t), 0);
+
+    tally_set(t, 1, 4, 2);
+    tally_set(t, 1, 0, 0);
+    CHECK_INT(tally_max(t), CAND_NONE);
+    CHECK_SIZE(tally_total(t), 0);
+    tally_destroy(t);
+}
+
+static void test_ties(void)
+{
+    tally_t t = tally_create();
+    tally_reset(t, 4);
+
+    // Counts 3, 5, 3, 5: B and D tie for most, A and C for fewest.
+    tally_set(t, 0, 3, 7);
+    tally_set(t, 1, 5, 2);
+    tally_set(t, 2, 3, 4);
+    tally_set(t, 3, 5, 9);
+    CHECK_SIZE(tally_total(t), 16);
+    CHECK_INT(tally_max(t), 3);
+    CHECK_INT(tally_min(t), 2);
+
+    tally_set(t, 3, 1, 9);
+    CHECK_INT(tally_max(t), 1);
+    CHECK_INT(tally_min(t), 3);
+    CHECK_SIZE(tally_count(t, 3), 1);
+    CHECK_SIZE(tally_total(t), 12);
+
+    // Reset empties it.
+    tally_reset(t, 2);
+    CHECK_INT(tally_max(t), CAND_NONE);
+    tally_destroy(t);
+}
+
+// Random updates over a large field, checked against the linear scans
+// in tabulate.c after each one.
+static void test_matches_pick(void)
+{
+    enum { N = 300 };
+    size_t counts[N] = { 0 };
+    size_t last[N]   = { 0 };
+    struct rng rng;
+    rng_seed(&rng, 31, 0);
+
+    tally_t t = tally_create();
+    tally_reset(t, N);
+    for (size_t step = 1; step <= 20000; ++step) {
+        cand_t c = (cand_t) rng_below(&rng, N);
+        // Small counts, so there are plenty of ties and zeros; `last`
+        // values are distinct among nonzero counts, as in a count.
+        counts[c] = rng_below(&rng, 6);
+        last[c]   = counts[c] ? step : 0;
+        tally_set(t, c, counts[c], last[c]);
+
+        CHECK_INT(tally_max(t), tab_pick_max(N, counts, last));
+        CHECK_INT(tally_min(t), tab_pick_min(N, counts, last));
+    }
+    tally_destroy(t);
+}